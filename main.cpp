@@ -1,8 +1,20 @@
 ﻿//std
+#include <charconv>
+#include <chrono>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
 #include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
 
 //library
 #include "library/format.hpp"
+#include "library/trace.hpp"
+
+//calculator
+#include "calc/distribution.hpp"
 
 //backend
 #include "backend/backend.hpp"
@@ -11,13 +23,84 @@ namespace global {
     std::string PATH;
 }
 
+namespace main_details {
+    // crow takes concurrency as uint16_t, running and queued requests have to fit into it
+    constexpr size_t max_queued = 10'000;
+    constexpr size_t max_session_timeout = 7 * 24 * 3600;
+    constexpr size_t max_session_memory = 1 << 20;
+
+    // whole value has to be decimal number in [min, max]
+    size_t parse_number(std::string_view value, size_t min, size_t max) {
+        size_t result;
+        auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), result);
+
+        if (ec != std::errc() || ptr != value.data() + value.size())
+            throw std::invalid_argument("it isn't a number");
+        if (result < min || result > max)
+            throw std::out_of_range(lib::format("it has to be in [{}, {}]", min, max));
+
+        return result;
+    }
+}
+
+// usage: 3ZCalculator [path] [--capture file.jsonl] [--trace-every N] [--allow-trace 0|1]
+//                     [--session-timeout seconds] [--session-memory MiB] [--max-queued N]
+//                     [--max-samples N]
+// options may go before or after path
 int main(int argc, char** argv) {
-    global::PATH = argc > 1
-        ? argv[1]
-        : ".";
+    global::PATH = ".";
+
+    bool has_path = false;
+    std::vector<std::pair<std::string_view, std::string_view>> options;
+    for (int i = 1; i < argc; i++) {
+        std::string_view arg = argv[i];
+
+        if (!arg.starts_with("--")) {
+            if (has_path) {
+                std::cerr << lib::format("unexpected argument \"{}\", path is already \"{}\"\n", arg, global::PATH);
+                return 1;
+            }
+            global::PATH = arg;
+            has_path = true;
+        } else if (i + 1 < argc)
+            options.emplace_back(arg, argv[++i]);
+        else {
+            std::cerr << lib::format("{} requires value\n", arg);
+            return 1;
+        }
+    }
 
     backend::Backend server;
     server.init();
+
+    for (auto [key, value] : options) {
+        using main_details::parse_number;
+
+        try {
+            if (key == "--capture")
+                server.enable_capture(std::string(value));
+            else if (key == "--trace-every")
+                lib::TraceSession::set_sample_rate(parse_number(value, 0, std::numeric_limits<size_t>::max()));
+            else if (key == "--allow-trace")
+                lib::TraceSession::allow_requested(parse_number(value, 0, 1) != 0);
+            else if (key == "--session-timeout")
+                server.sessions().set_idle_timeout(std::chrono::seconds(parse_number(value, 1, main_details::max_session_timeout)));
+            else if (key == "--session-memory")
+                server.sessions().set_memory_limit(parse_number(value, 1, main_details::max_session_memory) << 20);
+            else if (key == "--max-queued")
+                server.admission().set_max_queued(parse_number(value, 0, main_details::max_queued));
+            else if (key == "--max-samples")
+                calc::Distribution::set_request_samples_limit(parse_number(value, 1, calc::Distribution::max_samples));
+            else {
+                std::cerr << lib::format("unknown option \"{}\"\n", key);
+                return 1;
+            }
+        } catch (const std::exception& e) {
+            std::cerr << lib::format("bad value \"{}\" of {}: {}\n", value, key, e.what());
+            return 1;
+        }
+    }
+
     server.run();
 
     return 0;
@@ -0,0 +1,115 @@
+#include "backend/admission.hpp"
+
+namespace backend {
+    // Ticket
+
+    AdmissionControl::Ticket::Ticket(AdmissionControl& owner, std::optional<clock::time_point> deadline) :
+        _owner(owner),
+        _verdict(owner._enter(deadline)) {
+    }
+    AdmissionControl::Ticket::~Ticket() {
+        if (_verdict == Verdict::Admitted)
+            _owner._leave();
+    }
+
+    AdmissionControl::Verdict AdmissionControl::Ticket::verdict() const { return _verdict; }
+
+    // QueuePlace
+
+    AdmissionControl::QueuePlace::QueuePlace(AdmissionControl& owner) :
+        _owner(owner),
+        _is_taken(owner._take_place()) {
+    }
+    AdmissionControl::QueuePlace::~QueuePlace() {
+        if (_is_taken)
+            _owner._release_place();
+    }
+
+    bool AdmissionControl::QueuePlace::is_taken() const { return _is_taken; }
+
+    // AdmissionControl
+
+    AdmissionControl::AdmissionControl(size_t max_running, size_t max_queued) :
+        m_max_running(max_running),
+        m_max_queued(max_queued),
+        _running_gauge(lib::metrics().gauge("zzz_admission_running", "", "Requests which are computing")),
+        _queued_gauge(lib::metrics().gauge("zzz_admission_queued", "", "Requests which wait for compute slot")),
+        _rejected(lib::metrics().counter("zzz_admission_dropped_total", "reason=\"queue_full\"",
+            "Requests dropped before computing")),
+        _expired(lib::metrics().counter("zzz_admission_dropped_total", "reason=\"deadline\"",
+            "Requests dropped before computing")) {
+    }
+
+    void AdmissionControl::set_max_queued(size_t max_queued) {
+        std::lock_guard lock(_mutex);
+        m_max_queued = max_queued;
+    }
+
+    size_t AdmissionControl::max_running() const {
+        std::lock_guard lock(_mutex);
+        return m_max_running;
+    }
+    size_t AdmissionControl::max_queued() const {
+        std::lock_guard lock(_mutex);
+        return m_max_queued;
+    }
+
+    AdmissionControl::Verdict AdmissionControl::_enter(std::optional<clock::time_point> deadline) {
+        std::unique_lock lock(_mutex);
+
+        if (m_running >= m_max_running) {
+            if (m_queued >= m_max_queued) {
+                _rejected.inc();
+                return Verdict::Rejected;
+            }
+
+            m_queued++;
+            _update_metrics();
+
+            auto is_free = [this] { return m_running < m_max_running; };
+            bool is_admitted = true;
+            if (deadline.has_value())
+                is_admitted = _is_free.wait_until(lock, *deadline, is_free);
+            else
+                _is_free.wait(lock, is_free);
+
+            m_queued--;
+            if (!is_admitted) {
+                _update_metrics();
+                _expired.inc();
+                return Verdict::Expired;
+            }
+        }
+
+        m_running++;
+        _update_metrics();
+        return Verdict::Admitted;
+    }
+    void AdmissionControl::_leave() {
+        {
+            std::lock_guard lock(_mutex);
+            m_running--;
+            _update_metrics();
+        }
+        _is_free.notify_one();
+    }
+    bool AdmissionControl::_take_place() {
+        std::lock_guard lock(_mutex);
+
+        if (m_queued >= m_max_queued)
+            return false;
+
+        m_queued++;
+        _update_metrics();
+        return true;
+    }
+    void AdmissionControl::_release_place() {
+        std::lock_guard lock(_mutex);
+        m_queued--;
+        _update_metrics();
+    }
+    void AdmissionControl::_update_metrics() {
+        _running_gauge.set((int64_t) m_running);
+        _queued_gauge.set((int64_t) m_queued);
+    }
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+//std
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+
+//library
+#include "library/metrics.hpp"
+
+namespace backend {
+    // bounds amount of requests which compute at once and of those which wait for their turn.
+    // requests above both limits are rejected right away, so overload doesn't pile up latency,
+    // and waiting requests give up when their deadline passes
+    class AdmissionControl {
+    public:
+        using clock = std::chrono::steady_clock;
+
+        static constexpr size_t default_max_queued = 16;
+
+        enum class Verdict : uint8_t {
+            Admitted,
+            // queue is full
+            Rejected,
+            // deadline passed while waiting
+            Expired
+        };
+
+        // holds slot from admission till destruction
+        class Ticket {
+        public:
+            Ticket(AdmissionControl& owner, std::optional<clock::time_point> deadline);
+            ~Ticket();
+
+            Verdict verdict() const;
+
+            Ticket(const Ticket&) = delete;
+            Ticket& operator=(const Ticket&) = delete;
+
+        private:
+            AdmissionControl& _owner;
+            Verdict _verdict;
+        };
+
+        // holds place in queue without waiting for slot, for requests which wait for something else,
+        // so they are bounded together with queued ones. place isn't taken when queue is full
+        class QueuePlace {
+        public:
+            explicit QueuePlace(AdmissionControl& owner);
+            ~QueuePlace();
+
+            bool is_taken() const;
+
+            QueuePlace(const QueuePlace&) = delete;
+            QueuePlace& operator=(const QueuePlace&) = delete;
+
+        private:
+            AdmissionControl& _owner;
+            bool _is_taken;
+        };
+
+        explicit AdmissionControl(size_t max_running, size_t max_queued = default_max_queued);
+
+        void set_max_queued(size_t max_queued);
+
+        size_t max_running() const;
+        size_t max_queued() const;
+
+        // deleted members
+
+        AdmissionControl(const AdmissionControl&) = delete;
+        AdmissionControl& operator=(const AdmissionControl&) = delete;
+
+    protected:
+        size_t m_max_running;
+        size_t m_max_queued;
+        size_t m_running = 0;
+        size_t m_queued = 0;
+
+    private:
+        // guards everything above
+        mutable std::mutex _mutex;
+        std::condition_variable _is_free;
+
+        lib::Gauge& _running_gauge;
+        lib::Gauge& _queued_gauge;
+        lib::Counter& _rejected;
+        lib::Counter& _expired;
+
+        Verdict _enter(std::optional<clock::time_point> deadline);
+        void _leave();
+        bool _take_place();
+        void _release_place();
+        void _update_metrics();
+    };
+}
@@ -1,11 +1,14 @@
 #include "backend/backend.hpp"
 
 //std
+#include <algorithm>
+#include <charconv>
 #include <chrono>
 #include <functional>
 #include <string>
 
 //library
+#include "library/deadline.hpp"
 #include "library/format.hpp"
 
 //backend
@@ -20,20 +23,29 @@ namespace backend {
     template<typename TResult, typename... TArgs>
     TResult wrap_to_check_execution_time(
         std::string_view name,
+        lib::Histogram& histogram,
         std::function<TResult()> func) {
-        auto start = std::chrono::high_resolution_clock::now();
+        auto start = std::chrono::steady_clock::now();
         auto result = func();
-        std::chrono::duration<double, std::milli> time =
-            std::chrono::high_resolution_clock::now() - start;
+        auto elapsed = std::chrono::steady_clock::now() - start;
 
-        CROW_LOG_INFO << lib::format("{} was dispatched in {} ms", name, time.count());
+        histogram.record(elapsed);
+        CROW_LOG_INFO << lib::format("{} was dispatched in {} ms",
+            name, std::chrono::duration<double, std::milli>(elapsed).count());
 
         return result;
     }
 }
 
 namespace backend {
+	Backend::Backend() :
+		m_admission(std::clamp<size_t>(std::thread::hardware_concurrency(), 1, max_thread_load)),
+		m_coalescer(m_admission) {
+	}
 	Backend::~Backend() {
+		// log file has to outlive logger thread
+		m_logger.stop();
+
 		if (m_log_file.has_value())
 			m_log_file->close();
 	}
@@ -43,18 +55,39 @@ namespace backend {
 	lib::ObjectManager& Backend::manager() {
 		return m_manager;
 	}
+	SessionManager& Backend::sessions() {
+		return m_sessions;
+	}
+	AdmissionControl& Backend::admission() {
+		return m_admission;
+	}
 
 	// runners
 
 	void Backend::run() {
 		m_manager.launch();
 
-		uint16_t max_threads = std::thread::hardware_concurrency();
+		// computing is bounded by admission control, so there is a thread for every admitted request
+		// and one more, which rejects overflow instead of leaving it in sockets
 		m_app.port(port)
-		     .concurrency(max_threads < max_thread_load ? max_threads : max_thread_load)
+		     .concurrency(m_admission.max_running() + m_admission.max_queued() + 1)
 		     .run();
 	}
 
+	void Backend::enable_capture(const std::string& filename) {
+		m_capture.emplace(filename);
+		CROW_LOG_INFO << lib::format("capturing requests to {}", filename);
+	}
+
+	crow::response Backend::handle(crow::request& req) {
+		crow::response res;
+
+		m_app.validate();
+		m_app.handle_full(req, res);
+
+		return res;
+	}
+
 	// initializers
 
 	void Backend::init() {
@@ -77,24 +110,131 @@ namespace backend {
 		}
 	}
 	void Backend::_init_crow_app() {
+		_init_metrics("PUT /rotation");
+		_init_metrics("POST /damage");
+		_init_metrics("POST /team");
+		_init_metrics("POST /refresh");
+		_init_metrics("POST /session");
+		_init_metrics("PATCH /session");
+		_init_metrics("DELETE /session");
+
 		CROW_ROUTE(m_app, "/rotation").methods("PUT"_method)([this](const crow::request& req) {
-            return wrap_to_check_execution_time<crow::response>("POST /damage",
+            return _dispatch("PUT /rotation", req,
 				[req = std::cref(req), this] {
                     return methods::put_rotation(req);
 				});
 		});
 
 		CROW_ROUTE(m_app, "/damage").methods("POST"_method)([this](const crow::request& req) {
-            return wrap_to_check_execution_time<crow::response>("POST /damage",
+            return _dispatch_computing("POST /damage", req,
 				[req = std::cref(req), this] {
                     return methods::post_damage(req, m_manager);
+				}, methods::damage_request_key(req));
+		});
+		CROW_ROUTE(m_app, "/team").methods("POST"_method)([this](const crow::request& req) {
+            return _dispatch_computing("POST /team", req,
+				[req = std::cref(req), this] {
+                    return methods::post_team(req, m_manager);
 				});
 		});
-		CROW_ROUTE(m_app, "/refresh").methods("POST"_method)([this] {
-            return wrap_to_check_execution_time<crow::response>("POST /refresh",
+		CROW_ROUTE(m_app, "/refresh").methods("POST"_method)([this](const crow::request& req) {
+            return _dispatch_computing("POST /refresh", req,
 				[this] {
                     return methods::post_refresh(m_manager);
 				});
 		});
+
+		CROW_ROUTE(m_app, "/session").methods("POST"_method)([this](const crow::request& req) {
+            return _dispatch_computing("POST /session", req,
+				[req = std::cref(req), this] {
+                    return methods::post_session(req, m_manager, m_sessions);
+				});
+		});
+		CROW_ROUTE(m_app, "/session").methods("PATCH"_method)([this](const crow::request& req) {
+            return _dispatch_computing("PATCH /session", req,
+				[req = std::cref(req), this] {
+                    return methods::patch_session(req, m_manager, m_sessions);
+				});
+		});
+		CROW_ROUTE(m_app, "/session").methods("DELETE"_method)([this](const crow::request& req) {
+            return _dispatch("DELETE /session", req,
+				[req = std::cref(req), this] {
+                    return methods::delete_session(req, m_sessions);
+				});
+		});
+
+		CROW_ROUTE(m_app, "/metrics").methods("GET"_method)([this] {
+			return methods::get_metrics(m_manager);
+		});
+	}
+	void Backend::_init_metrics(std::string_view name) {
+		auto labels = lib::format("route=\"{}\"", name);
+		auto& metrics = lib::metrics();
+
+		m_routes[name] = {
+			.latency = &metrics.histogram("zzz_request_duration_seconds", labels,
+				"Time between dispatching request and getting response"),
+			.requests = &metrics.counter("zzz_requests_total", labels, "Dispatched requests"),
+			.errors = &metrics.counter("zzz_request_errors_total", labels, "Requests with non 2xx response")
+		};
+	}
+
+	crow::response Backend::_dispatch(
+		std::string_view name,
+		const crow::request& req,
+		const std::function<crow::response()>& func) {
+		auto& route = m_routes.at(name);
+		auto arrival = RequestCapture::clock::now();
+		auto response = wrap_to_check_execution_time<crow::response>(name, *route.latency, func);
+
+		route.requests->inc();
+		if (response.code < 200 || response.code >= 300)
+			route.errors->inc();
+
+		if (m_capture.has_value())
+			m_capture->append(req, arrival, response);
+
+		return response;
+	}
+	crow::response Backend::_dispatch_computing(
+		std::string_view name,
+		const crow::request& req,
+		const std::function<crow::response()>& func,
+		const std::optional<std::string>& coalescing_key) {
+		return _dispatch(name, req, [&]() -> crow::response {
+			std::optional<AdmissionControl::clock::time_point> deadline;
+
+			const auto& header = req.get_header_value(std::string(deadline_header));
+			if (!header.empty()) {
+				uint64_t ms;
+				auto [ptr, ec] = std::from_chars(header.data(), header.data() + header.size(), ms);
+				if (ec != std::errc() || ptr != header.data() + header.size())
+					return { 400, lib::format("{} has to be amount of milliseconds", deadline_header) };
+
+				deadline = AdmissionControl::clock::now() + std::chrono::milliseconds(std::min(ms, max_deadline_ms));
+			}
+
+			// followers only wait for leader, so they don't take slots of admission control
+			auto compute = [&]() -> crow::response {
+				AdmissionControl::Ticket ticket(m_admission, deadline);
+				if (ticket.verdict() == AdmissionControl::Verdict::Rejected) {
+					crow::response response(503, "server is overloaded");
+					response.set_header("Retry-After", std::string(retry_after));
+					return response;
+				}
+				if (ticket.verdict() == AdmissionControl::Verdict::Expired)
+					return { 504, lib::DeadlineExceeded().what() };
+
+				if (!deadline.has_value())
+					return func();
+
+				lib::Deadline bound(*deadline);
+				return func();
+			};
+
+			if (coalescing_key.has_value())
+				return m_coalescer.run(*coalescing_key, deadline, compute);
+			return compute();
+		});
 	}
 }
@@ -3,38 +3,86 @@
 //std
 #include <fstream>
 #include <optional>
+#include <string_view>
+#include <unordered_map>
 
 //crow
 #include "crow/app.h"
 
 //library
 #include "library/cached_memory.hpp"
+#include "library/metrics.hpp"
 
 //backend
+#include "backend/admission.hpp"
+#include "backend/capture.hpp"
+#include "backend/coalescing.hpp"
+#include "backend/sessions.hpp"
 #include "library/logger.hpp"
 
 namespace backend {
+    struct route_metrics_t {
+        lib::Histogram* latency = nullptr;
+        lib::Counter* requests = nullptr;
+        // non 2xx responses
+        lib::Counter* errors = nullptr;
+    };
+
     class Backend {
     public:
         static constexpr auto max_thread_load = 2ul;
         static constexpr auto port = 5102;
+        // remaining milliseconds of client, request is dropped with 504 after them
+        static constexpr std::string_view deadline_header = "X-Deadline-Ms";
+        // larger deadlines are clamped, so time point can't overflow
+        static constexpr uint64_t max_deadline_ms = 10 * 60 * 1000;
+        // seconds which client is asked to wait after 503
+        static constexpr std::string_view retry_after = "1";
 
-        Backend() = default;
+        Backend();
         ~Backend();
 
         lib::ObjectManager& manager();
+        SessionManager& sessions();
+        AdmissionControl& admission();
 
         void init();
         void run();
 
+        // appends every request to jsonl file, see RequestCapture
+        void enable_capture(const std::string& filename);
+
+        // dispatches request without network, used by tools/replay
+        crow::response handle(crow::request& req);
+
     protected:
         lib::ObjectManager m_manager;
+        SessionManager m_sessions;
+        AdmissionControl m_admission;
+        RequestCoalescer m_coalescer;
         crow::SimpleApp m_app;
         Logger m_logger;
         std::optional<std::fstream> m_log_file;
+        std::optional<RequestCapture> m_capture;
+        // filled before server starts, read only afterwards
+        std::unordered_map<std::string_view, route_metrics_t> m_routes;
 
     private:
         void _init_logger(bool use_file);
         void _init_crow_app();
+        void _init_metrics(std::string_view name);
+
+        crow::response _dispatch(
+            std::string_view name,
+            const crow::request& req,
+            const std::function<crow::response()>& func);
+        // _dispatch of computing routes: func waits for its turn in admission control
+        // and runs with deadline of request bound to thread.
+        // requests with the same coalescing key which are in flight at once share one computation
+        crow::response _dispatch_computing(
+            std::string_view name,
+            const crow::request& req,
+            const std::function<crow::response()>& func,
+            const std::optional<std::string>& coalescing_key = std::nullopt);
     };
 }
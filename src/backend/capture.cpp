@@ -0,0 +1,68 @@
+#include "backend/capture.hpp"
+
+//std
+#include <array>
+#include <string_view>
+
+//utl
+#include "utl/json.hpp"
+
+//library
+#include "library/cbor.hpp"
+#include "library/format.hpp"
+#include "library/string_funcs.hpp"
+
+namespace backend {
+    RequestCapture::RequestCapture(const std::string& filename) :
+        m_filename(filename),
+        m_file(filename, std::ios::out | std::ios::app) {
+        if (!m_file.is_open())
+            throw FMT_RUNTIME_ERROR("can't open capture file \"{}\"", filename);
+    }
+    RequestCapture::~RequestCapture() {
+        m_file.close();
+    }
+
+    const std::string& RequestCapture::filename() const { return m_filename; }
+
+    // headers which change handling of request, others aren't recorded
+    constexpr std::array<std::string_view, 3> captured_headers = { "Content-Type", "Accept", "X-Deadline-Ms" };
+
+    // {"request_id": "...", "route": "POST /damage", "query": "type=detailed", "headers": { "Accept": "..." },
+    //  "body": "...", "timestamp": <us since epoch>, "response": { "code": 200, "body": "..." }}
+    // binary (cbor) bodies are written as "body_base64" instead of "body"
+    void RequestCapture::append(const crow::request& req, clock::time_point arrival, const crow::response& res) {
+        utl::Json line;
+
+        auto query_pos = req.raw_url.find('?');
+        auto timestamp = std::chrono::duration_cast<std::chrono::microseconds>(arrival.time_since_epoch());
+
+        line["request_id"] = lib::format("capture-{}", _counter++);
+        line["route"] = lib::format("{} {}", crow::method_name(req.method), req.url);
+        line["query"] = query_pos != std::string::npos ? req.raw_url.substr(query_pos + 1) : std::string();
+        line["timestamp"] = (int64_t) timestamp.count();
+        line["response"]["code"] = (int64_t) res.code;
+
+        for (auto name : captured_headers) {
+            const auto& value = req.get_header_value(std::string(name));
+            if (!value.empty())
+                line["headers"][std::string(name)] = value;
+        }
+
+        if (req.get_header_value("Content-Type").starts_with(lib::cbor_mime))
+            line["body_base64"] = lib::to_base64(req.body);
+        else
+            line["body"] = req.body;
+
+        if (res.get_header_value("Content-Type").starts_with(lib::cbor_mime))
+            line["response"]["body_base64"] = lib::to_base64(res.body);
+        else
+            line["response"]["body"] = res.body;
+
+        auto serialized = line.to_string(utl::json::Format::MINIMIZED);
+
+        std::lock_guard lock(_mutex);
+        // every line is flushed, otherwise crash would take last requests with it
+        m_file << serialized << '\n' << std::flush;
+    }
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+//std
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <mutex>
+#include <string>
+
+//crow
+#include "crow/http_request.h"
+#include "crow/http_response.h"
+
+namespace backend {
+    // appends every incoming request with its response to jsonl file,
+    // one json object per line, ready to be replayed by tools/replay
+    class RequestCapture {
+    public:
+        using clock = std::chrono::system_clock;
+
+        explicit RequestCapture(const std::string& filename);
+        ~RequestCapture();
+
+        const std::string& filename() const;
+
+        void append(const crow::request& req, clock::time_point arrival, const crow::response& res);
+
+        // deleted members
+
+        RequestCapture(const RequestCapture&) = delete;
+        RequestCapture& operator=(const RequestCapture&) = delete;
+
+    protected:
+        std::string m_filename;
+        std::ofstream m_file;
+
+    private:
+        std::mutex _mutex;
+        std::atomic_size_t _counter = 0;
+    };
+}
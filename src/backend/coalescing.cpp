@@ -0,0 +1,109 @@
+#include "backend/coalescing.hpp"
+
+//library
+#include "library/deadline.hpp"
+
+namespace backend {
+    RequestCoalescer::RequestCoalescer(AdmissionControl& admission) :
+        m_admission(admission),
+        _leaders(lib::metrics().counter("zzz_coalescing_requests_total", "role=\"leader\"",
+            "Coalesced requests by whether they computed response or waited for it")),
+        _followers(lib::metrics().counter("zzz_coalescing_requests_total", "role=\"follower\"",
+            "Coalesced requests by whether they computed response or waited for it")),
+        _overflows(lib::metrics().counter("zzz_coalescing_requests_total", "role=\"overflow\"",
+            "Coalesced requests by whether they computed response or waited for it")),
+        _expired(lib::metrics().counter("zzz_coalescing_expired_total", "",
+            "Followers whose deadline passed before response of leader")),
+        _in_flight(lib::metrics().gauge("zzz_coalescing_in_flight", "", "Distinct coalesced requests in flight")) {
+    }
+
+    crow::response RequestCoalescer::run(
+        const std::string& key,
+        std::optional<clock::time_point> deadline,
+        const std::function<crow::response()>& func) {
+        std::unique_lock lock(_mutex);
+
+        auto [it, is_leader] = m_flights.try_emplace(key);
+        if (!is_leader) {
+            auto flight = it->second;
+            std::optional<crow::response> response;
+
+            {
+                // every waiting follower holds thread, so they are bounded as queued requests
+                AdmissionControl::QueuePlace place(m_admission);
+                if (place.is_taken()) {
+                    _followers.inc();
+                    response = _follow(lock, flight, deadline);
+                } else
+                    _overflows.inc();
+                lock.unlock();
+            }
+
+            // queue is full or leader didn't get response in time, so follower is computed on its own
+            if (!response.has_value())
+                return func();
+            return std::move(*response);
+        }
+
+        auto flight = std::make_shared<flight_t>();
+        it->second = flight;
+        _leaders.inc();
+        _in_flight.set((int64_t) m_flights.size());
+        lock.unlock();
+
+        return _lead(key, flight, func);
+    }
+
+    size_t RequestCoalescer::in_flight() const {
+        std::lock_guard lock(_mutex);
+        return m_flights.size();
+    }
+
+    crow::response RequestCoalescer::_lead(const std::string& key, const std::shared_ptr<flight_t>& flight,
+        const std::function<crow::response()>& func) {
+        crow::response response;
+        // followers mustn't wait forever, so exception becomes response as well
+        try {
+            response = func();
+        } catch (const std::exception& e) {
+            response = { 500, e.what() };
+        }
+
+        {
+            std::lock_guard lock(_mutex);
+            // next identical request starts new flight
+            m_flights.erase(key);
+            _in_flight.set((int64_t) m_flights.size());
+
+            flight->code = response.code;
+            flight->body = response.body;
+            for (const auto& [name, value] : response.headers)
+                flight->headers.emplace_back(name, value);
+        }
+        flight->is_done.notify_all();
+
+        return response;
+    }
+    std::optional<crow::response> RequestCoalescer::_follow(std::unique_lock<std::mutex>& lock,
+        const std::shared_ptr<flight_t>& flight, std::optional<clock::time_point> deadline) {
+        auto is_done = [&flight] { return flight->code.has_value(); };
+
+        if (deadline.has_value()) {
+            if (!flight->is_done.wait_until(lock, *deadline, is_done)) {
+                _expired.inc();
+                return crow::response(504, lib::DeadlineExceeded().what());
+            }
+        } else
+            flight->is_done.wait(lock, is_done);
+
+        // deadline of leader isn't the one of follower
+        if (*flight->code == 504)
+            return std::nullopt;
+
+        crow::response response(*flight->code, flight->body);
+        for (const auto& [name, value] : flight->headers)
+            response.set_header(name, value);
+
+        return response;
+    }
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+//std
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+//crow
+#include "crow/http_response.h"
+
+//library
+#include "library/metrics.hpp"
+
+//backend
+#include "backend/admission.hpp"
+
+namespace backend {
+    // identical requests which are in flight at once are computed once:
+    // the first one computes, the rest wait for it and get copy of its serialized response.
+    // finished responses aren't kept, next identical request computes again.
+    // waiting followers take places of admission queue, when it's full follower computes on its own
+    class RequestCoalescer {
+    public:
+        using clock = std::chrono::steady_clock;
+
+        explicit RequestCoalescer(AdmissionControl& admission);
+
+        // key is canonical form of request, every request with the same key gets the same response.
+        // follower gives up with 504 when its deadline passes before response of leader,
+        // and runs func itself when leader got 504 because of its own deadline
+        crow::response run(
+            const std::string& key,
+            std::optional<clock::time_point> deadline,
+            const std::function<crow::response()>& func);
+
+        size_t in_flight() const;
+
+        // deleted members
+
+        RequestCoalescer(const RequestCoalescer&) = delete;
+        RequestCoalescer& operator=(const RequestCoalescer&) = delete;
+
+    protected:
+        struct flight_t {
+            std::condition_variable is_done;
+            // set once by leader
+            std::optional<int> code;
+            std::string body;
+            std::vector<std::pair<std::string, std::string>> headers;
+        };
+
+        AdmissionControl& m_admission;
+        std::unordered_map<std::string, std::shared_ptr<flight_t>> m_flights;
+
+    private:
+        // guards everything above, including flights
+        mutable std::mutex _mutex;
+
+        lib::Counter& _leaders;
+        lib::Counter& _followers;
+        lib::Counter& _overflows;
+        lib::Counter& _expired;
+        lib::Gauge& _in_flight;
+
+        crow::response _lead(const std::string& key, const std::shared_ptr<flight_t>& flight,
+            const std::function<crow::response()>& func);
+        // nullopt when leader got 504, since its deadline isn't the one of follower
+        std::optional<crow::response> _follow(std::unique_lock<std::mutex>& lock,
+            const std::shared_ptr<flight_t>& flight, std::optional<clock::time_point> deadline);
+    };
+}
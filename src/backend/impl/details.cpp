@@ -1,11 +1,14 @@
 #include "backend/impl/details.hpp"
 
 //std
+#include <algorithm>
+#include <future>
 #include <iostream>
 #include <ranges>
 
 //library
 #include "library/string_funcs.hpp"
+#include "library/trace.hpp"
 
 //zzz
 #include "zzz/details.hpp"
@@ -35,6 +38,10 @@ namespace backend::details {
 			"dds",
 			{ .func = [](const std::string& name) { return std::make_shared<Dds>(name); } }
 		},
+		{
+			"enemies",
+			{ .func = [](const std::string& name) { return std::make_shared<Enemy>(name); } }
+		},
 		{
 			"rotations",
 			{
@@ -81,7 +88,33 @@ namespace backend::details {
 
 	// preparers
 
+	Ddp prepare_ddp(const utl::Json& source, size_t slot) {
+		const auto& v = source.as_object();
+		combat::DdpBuilder builder;
+
+		const auto& stats = v.at("stats").as_array();
+		const auto& levels = v.at("levels").as_array();
+
+		builder.set_disc_id(v.at("id").as_integral());
+		builder.set_slot(slot);
+		builder.set_rarity(v.at("rarity").as_integral());
+
+		builder.set_main_stat(
+			stats[0].is_integral() ? (StatId) stats[0].as_integral() : (StatId) stats[0].as_string(),
+			levels[0].as_integral()
+		);
+		for (size_t i = 1; i < 5; i++)
+			builder.add_sub_stat(
+				stats[i].is_integral() ? (StatId) stats[i].as_integral() : (StatId) stats[i].as_string(),
+				levels[i].as_integral()
+			);
+
+		return builder.get_product();
+	}
+
 	void prepare_request_details(calc::request_t& what, const utl::Json& source) {
+		lib::TraceScope scope("prepare_request_details");
+
 		const auto& table = source.as_object();
 
 		// agent
@@ -100,12 +133,11 @@ namespace backend::details {
 			const auto& array = table.at("rotation").as_array();
 			zzz::details::RotationBuilder builder;
 
-			for (const auto& it : array) {
-				auto splitted = lib::split_as_copy(it.as_string(), ' ');
-				auto index = splitted.size() > 1 ? std::stoul(splitted[1]) : 0;
-				builder.add_cell({ splitted[0], index });
-			}
+			for (const auto& it : array)
+				builder.add_cell(to_rotation_cell(it.as_string()));
 
+			// inline rotation isn't stored in object manager, so it's made here
+			what.rotation.ptr = std::make_shared<Rotation>(lib::format("{}/inline", what.agent.id));
 			what.rotation->set(builder.get_product());
 		}
 
@@ -115,29 +147,10 @@ namespace backend::details {
 		size_t current_disk = 0;
 
 		for (const auto& it : table.at("discs").as_array()) {
-			const auto& v = it.as_object();
-			combat::DdpBuilder builder;
-
-			uint64_t disc_id = v.at("id").as_integral();
-
-			const auto& stats = v.at("stats").as_array();
-			const auto& levels = v.at("levels").as_array();
-
-			builder.set_disc_id(disc_id);
-			builder.set_slot(current_disk + 1);
-			builder.set_rarity(v.at("rarity").as_integral());
+			uint64_t disc_id = it.as_object().at("id").as_integral();
 
-			builder.set_main_stat(
-				stats[0].is_integral() ? (StatId) stats[0].as_integral() : (StatId) stats[0].as_string(),
-				levels[0].as_integral()
-			);
-			for (size_t i = 1; i < 5; i++)
-				builder.add_sub_stat(
-					stats[i].is_integral() ? (StatId) stats[i].as_integral() : (StatId) stats[i].as_string(),
-					levels[i].as_integral()
-				);
-
-			what.ddps[current_disk++] = builder.get_product();
+			what.ddps[current_disk] = prepare_ddp(it, current_disk + 1);
+			current_disk++;
 
 			// prepare dds_count
 
@@ -161,30 +174,135 @@ namespace backend::details {
 
 			what.dds_by_count.emplace(4, val.ptr);
 		}
+
+		// teammates, in addition to ones of rotation
+
+		if (auto it = table.find("teammates"); it != table.end()) {
+			for (const auto& id : it->second.as_array())
+				what.teammates.emplace_back(id.as_integral());
+		}
+
+		// enemies
+
+		if (auto it = table.find("enemies"); it != table.end()) {
+			for (const auto& id : it->second.as_array())
+				what.enemies.emplace_back(id.as_integral());
+		}
+
+		// "anomaly_buildup": true or threshold
+
+		if (auto it = table.find("anomaly_buildup"); it != table.end()) {
+			const auto& value = it->second;
+
+			if (value.is_bool()) {
+				if (value.as_bool())
+					what.buildup_threshold = AnomalyBuildup::default_threshold;
+			} else
+				what.buildup_threshold = value.as_number();
+		}
+	}
+	calc::timeline_config_t prepare_timeline_config(const utl::Json& source) {
+		const auto& table = source.as_object();
+		calc::timeline_config_t result;
+
+		if (auto it = table.find("default_duration"); it != table.end())
+			result.default_duration = it->second.as_number();
+		if (auto it = table.find("daze_threshold"); it != table.end())
+			result.daze_threshold = it->second.as_number();
+		if (auto it = table.find("stun_duration"); it != table.end())
+			result.stun_duration = it->second.as_number();
+
+		if (auto it = table.find("buffs"); it != table.end()) {
+			for (const auto& buff : it->second.as_array()) {
+				const auto& v = buff.as_object();
+				auto& added = result.buffs.emplace_back();
+
+				const auto& stat = v.at("stat");
+				added.trigger = v.at("trigger").as_string();
+				added.id = stat.is_integral() ? (StatId) stat.as_integral() : (StatId) stat.as_string();
+				added.value = v.at("value").as_number();
+				added.duration = v.at("duration").as_number();
+
+				if (auto jt = v.find("tag"); jt != v.end())
+					added.tag = jt->second.is_integral() ? Tag(jt->second.as_integral()) : Tag(jt->second.as_string());
+				if (auto jt = v.find("max_stacks"); jt != v.end())
+					added.max_stacks = jt->second.as_integral();
+			}
+		}
+
+		return result;
 	}
 	void prepare_request_composed(calc::request_t& what, lib::ObjectManager& source) {
-		auto agent_future = source.get_async(lib::format("agents/{}", what.agent.id));
-		auto wengine_future = source.get_async(lib::format("wengines/{}", what.wengine.id));
+		lib::TraceScope scope("prepare_request_composed");
+
+		auto agent_future = source.get_async(lib::ObjectKey("agents", what.agent.id));
+		auto wengine_future = source.get_async(lib::ObjectKey("wengines", what.wengine.id));
 
 		std::future<lib::MObjectPtr> rotation_future;
 		if (what.rotation.ptr == nullptr)
-			rotation_future = source.get_async(lib::format("rotations/{}/{}", what.agent.id, what.rotation.id));
+			rotation_future = source.get_async(lib::ObjectKey("rotations", what.agent.id, what.rotation.id));
 
 		std::list<std::tuple<DdsPtr&, std::future<lib::MObjectPtr>>> dds_futures;
 		for (auto& [id, ptr] : what.dds_list)
-			dds_futures.emplace_back(ptr, source.get_async(lib::format("dds/{}", id)));
+			dds_futures.emplace_back(ptr, source.get_async(lib::ObjectKey("dds", id)));
 
-		try {
-			what.agent.ptr = std::static_pointer_cast<Agent>(agent_future.get());
-			what.wengine.ptr = std::static_pointer_cast<Wengine>(wengine_future.get());
+		std::list<std::tuple<EnemyPtr&, std::future<lib::MObjectPtr>>> enemy_futures;
+		for (auto& [id, ptr] : what.enemies)
+			enemy_futures.emplace_back(ptr, source.get_async(lib::ObjectKey("enemies", id)));
 
-			if (what.rotation.ptr == nullptr)
-				what.rotation.ptr = std::static_pointer_cast<Rotation>(rotation_future.get());
+		// teammates can be added below, so they are referred by index
+		std::list<std::tuple<size_t, std::future<lib::MObjectPtr>>> teammate_futures;
+		for (size_t i = 0; i < what.teammates.size(); i++) {
+			if (what.teammates[i].ptr == nullptr)
+				teammate_futures.emplace_back(i, source.get_async(lib::ObjectKey("agents", what.teammates[i].id)));
+		}
 
-			for (auto& [ptr, future] : dds_futures)
-				ptr = std::static_pointer_cast<Dds>(future.get());
-		} catch (const std::runtime_error& e) {
-			CROW_LOG_ERROR << lib::format("error: {}", e.what());
+		// missing object fails whole request, everything below expects loaded objects
+		what.agent.ptr = std::static_pointer_cast<Agent>(agent_future.get());
+		what.wengine.ptr = std::static_pointer_cast<Wengine>(wengine_future.get());
+
+		if (what.rotation.ptr == nullptr)
+			what.rotation.ptr = std::static_pointer_cast<Rotation>(rotation_future.get());
+
+		for (auto& [ptr, future] : dds_futures)
+			ptr = std::static_pointer_cast<Dds>(future.get());
+
+		for (auto& [ptr, future] : enemy_futures)
+			ptr = std::static_pointer_cast<Enemy>(future.get());
+
+		// teammates of rotation are known only after it's loaded
+		for (uint64_t id : what.rotation->details().teammates()) {
+			bool is_known = id == what.agent.id
+				|| std::ranges::find(what.teammates, id, &calc::cell_t<Agent>::id) != what.teammates.end();
+			if (is_known)
+				continue;
+
+			teammate_futures.emplace_back(what.teammates.size(), source.get_async(lib::ObjectKey("agents", id)));
+			what.teammates.emplace_back(id);
+		}
+
+		for (auto& [index, future] : teammate_futures)
+			what.teammates[index].ptr = std::static_pointer_cast<Agent>(future.get());
+	}
+
+	void prepare_team_composed(std::span<calc::request_t> members, lib::ObjectManager& source) {
+		lib::TraceScope scope("prepare_team_composed");
+
+		std::vector<std::future<void>> futures;
+		futures.reserve(members.size());
+		for (auto& it : members)
+			futures.emplace_back(std::async(std::launch::async, [&it, &source] { prepare_request_composed(it, source); }));
+		for (auto& it : futures)
+			it.get();
+
+		// agents of members are already loaded, so they aren't requested again
+		for (auto& member : members) {
+			for (const auto& other : members) {
+				bool is_known = other.agent.id == member.agent.id
+					|| std::ranges::find(member.teammates, other.agent.id, &calc::cell_t<Agent>::id) != member.teammates.end();
+				if (!is_known)
+					member.teammates.emplace_back(other.agent);
+			}
 		}
 	}
 
@@ -3,6 +3,7 @@
 //std
 #include <filesystem>
 #include <memory>
+#include <span>
 #include <string>
 
 //utl
@@ -13,6 +14,7 @@
 
 //calc
 #include "calc/calculator.hpp"
+#include "calc/timeline.hpp"
 
 namespace fs = std::filesystem;
 
@@ -40,10 +42,17 @@ namespace backend::details {
 
     // preparers
 
+    // slot starts from 1
+    zzz::Ddp prepare_ddp(const utl::Json& source, size_t slot);
+
     void prepare_request_details(calc::request_t& what, const utl::Json& source);
+    // "timeline" field of request, every field is optional
+    calc::timeline_config_t prepare_timeline_config(const utl::Json& source);
 
     // TODO: remake with unordered_map or list
     void prepare_request_composed(calc::request_t& what, lib::ObjectManager& source);
+    // members are composed concurrently, then every member becomes teammate of others
+    void prepare_team_composed(std::span<calc::request_t> members, lib::ObjectManager& source);
 
     size_t prepare_object_manager(lib::ObjectManager& manager);
 }
@@ -1,20 +1,123 @@
 #include "backend/impl/requests.hpp"
 
 //std
+#include <array>
+#include <charconv>
+#include <cmath>
 #include <filesystem>
+#include <future>
+#include <optional>
 #include <string>
+#include <vector>
 
 //utl
 #include "utl/json.hpp"
 
 //lib
+#include "library/cbor.hpp"
+#include "library/deadline.hpp"
 #include "library/format.hpp"
+#include "library/json_writer.hpp"
+#include "library/metrics.hpp"
+#include "library/trace.hpp"
 
 //backend
 #include "backend/impl/details.hpp"
 
+//crow
+#include "crow/logging.h"
+
 namespace fs = std::filesystem;
 
+namespace global {
+    extern std::string PATH;
+}
+
+namespace backend::requests_details {
+    constexpr size_t max_team_size = 3;
+
+    constexpr std::array<std::pair<std::string_view, double>, 6> reported_percentiles = {{
+        { "p5", 0.05 }, { "p25", 0.25 }, { "p50", 0.5 }, { "p75", 0.75 }, { "p95", 0.95 }, { "p99", 0.99 }
+    }};
+
+    // Content-Type: application/cbor, json otherwise
+    utl::Json parse_body(const crow::request& req) {
+        if (req.get_header_value("Content-Type").starts_with(lib::cbor_mime))
+            return lib::cbor_to_json(req.body);
+
+        return utl::json::from_string(req.body);
+    }
+    // Accept: application/cbor, json otherwise
+    bool accepts_cbor(const crow::request& req) {
+        return req.get_header_value("Accept").find(lib::cbor_mime) != std::string::npos;
+    }
+
+    // write(writer) is called with JsonWriter or CborWriter, cbor ignores format since doubles go as is
+    template<typename F>
+    std::string serialize(bool is_cbor, size_t reserve, const lib::json_number_format_t& format, F&& write) {
+        if (is_cbor) {
+            lib::CborWriter writer(reserve);
+            write(writer);
+            return writer.take();
+        }
+
+        lib::JsonWriter writer(reserve, format);
+        write(writer);
+        return writer.take();
+    }
+    // "procs": [{ "cell": index of triggering cell, "dmg": damage, "name": anomaly }, ...]
+    template<typename Writer>
+    void write_procs(Writer& writer, std::span<const calc::Calculator::proc_t> procs, const zzz::AgentDetails& agent) {
+        writer.key("procs").begin_array();
+        for (const auto& [cell, ability, dmg] : procs) {
+            writer.begin_object()
+                .field("cell", cell)
+                .field("dmg", dmg)
+                .field("name", agent.ability_name(ability))
+                .end_object();
+        }
+        writer.end_array();
+    }
+    // { "per_ability": [...], "recomputed": distinct cells, "session": id, "total": damage }
+    template<typename Writer>
+    void write_session(Writer& writer, std::string_view id, const calc::Calculator::result_t& result, size_t recomputed) {
+        const auto& [total_dmg, per_ability] = result;
+
+        writer.begin_object()
+            .field("per_ability", per_ability)
+            .field("recomputed", recomputed)
+            .field("session", id)
+            .field("total", total_dmg)
+            .end_object();
+    }
+    // the same output as utl::Json::to_string(MINIMIZED) for JsonWriter
+    template<typename Writer>
+    void write_dom(Writer& writer, const utl::Json& what) {
+        if (what.is_object()) {
+            writer.begin_object();
+            for (const auto& [k, v] : what.as_object()) {
+                writer.key(k);
+                write_dom(writer, v);
+            }
+            writer.end_object();
+        } else if (what.is_array()) {
+            writer.begin_array();
+            for (const auto& it : what.as_array())
+                write_dom(writer, it);
+            writer.end_array();
+        } else if (what.is_string())
+            writer.value(std::string_view(what.as_string()));
+        else if (what.is_integral())
+            writer.value(what.as_integral());
+        else if (what.is_floating())
+            writer.value(what.as_floating());
+        else if (what.is_bool())
+            writer.value(what.as_bool());
+        else
+            writer.value(nullptr);
+    }
+}
+
 namespace backend::methods {
     std::string get_default() {
         return "3Z Calculator Backend";
@@ -60,48 +163,435 @@ namespace backend::methods {
     crow::response post_damage(const crow::request& req, lib::ObjectManager& manager) {
         crow::response response;
 
+        static auto& parse_time = lib::stage_histogram("parse");
+        static auto& compose_time = lib::stage_histogram("compose");
+        static auto& serialize_time = lib::stage_histogram("serialize");
+
+        // ?trace=1 if server allows it or every n-th request if sampling is on
+        const char* trace_param = req.url_params.get("trace");
+        std::optional<lib::TraceSession> trace;
+        if (lib::TraceSession::is_sampled(trace_param != nullptr && std::string_view(trace_param) != "0"))
+            trace.emplace("post_damage");
+
         try {
-            std::string type = req.url_params.get("type");
+            const char* type_param = req.url_params.get("type");
+            std::string type = type_param != nullptr ? type_param : "";
+
+            // ?samples=N is checked before anything is computed
+            const char* samples_param = req.url_params.get("samples");
+            size_t samples_count = 0;
+            if (samples_param != nullptr) {
+                std::string_view value = samples_param;
+                size_t limit = calc::Distribution::request_samples_limit();
+                auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), samples_count);
+
+                if (ec != std::errc() || ptr != value.data() + value.size() || samples_count < 1 || samples_count > limit)
+                    return { 400, lib::format("samples has to be number in [1, {}], got \"{}\"", limit, value) };
+            }
+
             calc::request_t unpacked_request;
-            utl::Json for_assign;
+            std::string body;
+            bool is_cbor = requests_details::accepts_cbor(req);
+
+            // ?rounding=decimals&precision=2 shrinks numbers of response, exact by default
+            lib::json_number_format_t format;
+            if (const char* rounding_param = req.url_params.get("rounding")) {
+                const char* precision_param = req.url_params.get("precision");
+                format = lib::json_number_format_t::make(rounding_param, precision_param != nullptr ? std::stoi(precision_param) : 0);
+            }
+            std::optional<lib::ScopedTimer> serialize_timer;
+            std::optional<lib::TraceScope> serialize_scope;
+
+            lib::ScopedTimer parse_timer(parse_time);
+            auto source = requests_details::parse_body(req);
+            details::prepare_request_details(unpacked_request, source);
+            parse_timer.stop();
 
-            details::prepare_request_details(unpacked_request, utl::json::from_string(req.body));
+            lib::ScopedTimer compose_timer(compose_time);
             details::prepare_request_composed(unpacked_request, manager);
+            compose_timer.stop();
+
+            if (!unpacked_request.enemies.empty() && !type.empty())
+                throw RUNTIME_ERROR("enemies are supported only by plain /damage");
+
+            if (type.empty() && !unpacked_request.enemies.empty()) {
+                std::vector<calc::enemy_t> enemies;
+                enemies.reserve(unpacked_request.enemies.size());
+                for (const auto& it : unpacked_request.enemies) {
+                    if (it.ptr == nullptr)
+                        throw FMT_RUNTIME_ERROR("enemy {} isn't found", it.id);
+                    enemies.emplace_back(calc::details::make_enemy(it->details()));
+                }
 
-            if (type.empty()) {
-                auto [total_dmg, per_ability] = calc::Calculator::eval(unpacked_request);
+                auto result = calc::Calculator::eval_enemies(unpacked_request, enemies);
+                serialize_timer.emplace(serialize_time);
+                serialize_scope.emplace("serialize");
 
-                for_assign["total"] = total_dmg;
-                for_assign["per_ability"] = per_ability;
+                size_t reserve = 64 + result.size() * (64 + std::get<1>(result.front()).size() * 24);
+                body = requests_details::serialize(is_cbor, reserve, format, [&](auto& writer) {
+                    writer.begin_object().key("enemies").begin_array();
+                    for (size_t i = 0; i < result.size(); i++) {
+                        const auto& [total_dmg, per_ability] = result[i];
+
+                        writer.begin_object()
+                            .field("id", unpacked_request.enemies[i].id)
+                            .field("name", unpacked_request.enemies[i]->details().name())
+                            .field("per_ability", per_ability)
+                            .field("total", total_dmg)
+                            .end_object();
+                    }
+                    writer.end_array().end_object();
+                });
+            } else if (type.empty()) {
+                std::vector<calc::Calculator::proc_t> procs;
+                auto [total_dmg, per_ability] = calc::Calculator::eval(unpacked_request, &procs);
+                serialize_timer.emplace(serialize_time);
+                serialize_scope.emplace("serialize");
+
+                size_t reserve = 64 + per_ability.size() * 24 + procs.size() * 64;
+                body = requests_details::serialize(is_cbor, reserve, format, [&](auto& writer) {
+                    writer.begin_object().field("per_ability", per_ability);
+                    if (unpacked_request.buildup_threshold.has_value())
+                        requests_details::write_procs(writer, procs, unpacked_request.agent->details());
+                    writer.field("total", total_dmg).end_object();
+                });
             } else if (type == "detailed") {
-                auto [total_dmg, per_ability] = calc::Calculator::eval_detailed(unpacked_request);
+                std::vector<calc::Calculator::proc_t> procs;
+                auto [total_dmg, per_ability] = calc::Calculator::eval_detailed(unpacked_request, &procs);
+                serialize_timer.emplace(serialize_time);
+                serialize_scope.emplace("serialize");
 
-                utl::json::Array temp;
-                for (auto& [dmg, tags, name] : per_ability) {
-                    utl::json::Array line(3);
-                    line[0] = dmg;
-
-                    if (tags.size() == 1)
-                        line[1] = (size_t) tags.front();
-                    else {
-                        for (size_t i = 0; i < tags.size(); i++)
-                            line[1][i] = (size_t) tags[i];
+                const auto& agent = unpacked_request.agent->details();
+                // "name index", reused between hits
+                std::string name;
+
+                size_t reserve = 64 + (per_ability.size() + procs.size()) * 64;
+                body = requests_details::serialize(is_cbor, reserve, format, [&](auto& writer) {
+                    writer.begin_object().key("per_ability").begin_array();
+                    for (const auto& [dmg, tags, ability, index] : per_ability) {
+                        writer.begin_array().value(dmg);
+
+                        // single tag is written as number
+                        if (tags.size() == 1)
+                            writer.value((size_t) *tags.begin());
+                        else if (tags.size() == 0)
+                            writer.value(nullptr);
+                        else {
+                            writer.begin_array();
+                            for (const auto& tag : tags)
+                                writer.value((size_t) tag);
+                            writer.end_array();
+                        }
+
+                        if (index == 0)
+                            writer.value(agent.ability_name(ability));
+                        else {
+                            std::array<char, 20> digits;
+                            auto [ptr, ec] = std::to_chars(digits.data(), digits.data() + digits.size(), index);
+
+                            name = agent.ability_name(ability);
+                            name += ' ';
+                            name.append(digits.data(), ptr);
+                            writer.value(name);
+                        }
+                        writer.end_array();
                     }
+                    writer.end_array();
+                    if (unpacked_request.buildup_threshold.has_value())
+                        requests_details::write_procs(writer, procs, agent);
+                    writer.end_object();
+                });
+            } else if (type == "distribution") {
+                auto distribution = calc::Calculator::eval_distribution(unpacked_request);
+                const auto& total = distribution.total();
+
+                // ?samples=N&seed=S adds monte carlo estimates
+                const char* seed_param = req.url_params.get("seed");
+                std::vector<double> samples;
+                if (samples_param != nullptr)
+                    samples = distribution.sample(samples_count,
+                        seed_param != nullptr ? std::stoull(seed_param) : 0);
+
+                serialize_timer.emplace(serialize_time);
+                serialize_scope.emplace("serialize");
+
+                // nested objects with sorted keys, so it's still built as DOM
+                utl::Json for_assign;
+                for_assign["total"] = total.mean;
+                for_assign["std_dev"] = std::sqrt(total.variance);
+                for_assign["min"] = total.min;
+                for_assign["max"] = total.max;
+                for_assign["is_exact"] = distribution.is_exact();
+
+                for (const auto& [name, q] : requests_details::reported_percentiles) {
+                    for_assign["percentiles"][name] = distribution.percentile(q);
+                    if (!samples.empty())
+                        for_assign["monte_carlo"]["percentiles"][name] = calc::Distribution::percentile(samples, q);
+                }
+                if (!samples.empty())
+                    for_assign["monte_carlo"]["samples"] = samples.size();
+
+                utl::json::Array temp;
+                for (const auto& hit : distribution.hits()) {
+                    auto moments = calc::Distribution::moments(hit);
 
-                    line[2] = std::move(name);
+                    utl::json::Array line(2);
+                    line[0] = moments.mean;
+                    line[1] = std::sqrt(moments.variance);
                     temp.emplace_back(std::move(line));
                 }
                 for_assign["per_ability"] = std::move(temp);
+                body = requests_details::serialize(is_cbor, 256 + distribution.hits().size() * 48, format, [&](auto& writer) {
+                    requests_details::write_dom(writer, for_assign);
+                });
+            } else if (type == "timeline") {
+                calc::timeline_config_t config;
+                if (source.contains("timeline"))
+                    config = details::prepare_timeline_config(source["timeline"]);
+
+                auto result = calc::Timeline(unpacked_request, std::move(config)).run();
+                serialize_timer.emplace(serialize_time);
+                serialize_scope.emplace("serialize");
+
+                size_t reserve = 128 + (result.dmg_per_ability.size() + result.start_times.size()) * 24;
+                body = requests_details::serialize(is_cbor, reserve, format, [&](auto& writer) {
+                    writer.begin_object()
+                        .field("duration", result.duration)
+                        .field("per_ability", result.dmg_per_ability)
+                        .field("start_times", result.start_times)
+                        .field("stunned_time", result.stunned_time)
+                        .field("stuns", result.stuns)
+                        .field("total", result.total_dmg)
+                        .end_object();
+                });
             } else
                 throw FMT_RUNTIME_ERROR("invalid request \"/damage?type={}\"", type);
 
-            response.body = for_assign.to_string(utl::json::Format::MINIMIZED);
+            response.body = std::move(body);
+            if (is_cbor)
+                response.set_header("Content-Type", std::string(lib::cbor_mime));
+            serialize_timer.reset();
+            serialize_scope.reset();
+
+            response.code = 200;
+        } catch (const lib::DeadlineExceeded& e) {
+            response = { 504, e.what() };
+        } catch (const std::exception& e) {
+            response = { 500, e.what() };
+        }
+
+        if (trace.has_value()) {
+            try {
+                auto filename = trace->dump(lib::format("{}/logs", global::PATH));
+                CROW_LOG_INFO << lib::format("trace is written to {}", filename);
+            } catch (const std::exception& e) {
+                CROW_LOG_ERROR << e.what();
+            }
+        }
+
+        return response;
+    }
+
+    std::optional<std::string> damage_request_key(const crow::request& req) {
+        // traced request has to dump its own trace
+        if (req.url_params.get("trace") != nullptr && lib::TraceSession::is_requested_allowed())
+            return std::nullopt;
+
+        // body isn't parsed here, it's done once by post_damage after admission,
+        // so only byte-identical bodies of the same content type are coalesced
+        lib::CborWriter writer(req.body.size() + 64);
+        writer.begin_array();
+        for (const char* name : { "type", "rounding", "precision", "samples", "seed" }) {
+            const char* param = req.url_params.get(name);
+            writer.value(param != nullptr ? param : "");
+        }
+        writer.value(requests_details::accepts_cbor(req))
+            .value(req.get_header_value("Content-Type").starts_with(lib::cbor_mime))
+            .value(std::string_view(req.body))
+            .end_array();
+
+        return writer.take();
+    }
+
+    crow::response post_team(const crow::request& req, lib::ObjectManager& manager) {
+        crow::response response;
+
+        try {
+            auto source = requests_details::parse_body(req);
+            const auto& array = source.as_object().at("members").as_array();
+            if (array.empty())
+                throw RUNTIME_ERROR("team has to have at least one member");
+            // every member is prepared and evaluated on its own threads
+            if (array.size() > requests_details::max_team_size)
+                return { 400, lib::format("team has at most {} members, got {}", requests_details::max_team_size, array.size()) };
+
+            std::vector<calc::request_t> members(array.size());
+            for (size_t i = 0; i < array.size(); i++)
+                details::prepare_request_details(members[i], array[i]);
+            details::prepare_team_composed(members, manager);
+
+            std::vector<std::future<calc::Calculator::result_t>> futures;
+            futures.reserve(members.size());
+            // deadline of request is shared by its members
+            auto* deadline = lib::Deadline::current();
+            for (const auto& it : members) {
+                futures.emplace_back(std::async(std::launch::async, [&it, deadline] {
+                    lib::Deadline::Binder binder(deadline);
+                    return calc::Calculator::eval(it);
+                }));
+            }
+
+            bool is_cbor = requests_details::accepts_cbor(req);
+            double team_dmg = 0.0;
+
+            // members go before total in sorted order, so total is summed while they are written
+            response.body = requests_details::serialize(is_cbor, 64 + members.size() * 256, {}, [&](auto& writer) {
+                writer.begin_object().key("members").begin_array();
+                for (size_t i = 0; i < members.size(); i++) {
+                    auto [total_dmg, per_ability] = futures[i].get();
+                    team_dmg += total_dmg;
+
+                    writer.begin_object()
+                        .field("aid", members[i].agent.id)
+                        .field("per_ability", per_ability)
+                        .field("total", total_dmg)
+                        .end_object();
+                }
+                writer.end_array()
+                    .field("total", team_dmg)
+                    .end_object();
+            });
+            if (is_cbor)
+                response.set_header("Content-Type", std::string(lib::cbor_mime));
 
             response.code = 200;
+        } catch (const lib::DeadlineExceeded& e) {
+            response = { 504, e.what() };
+        } catch (const std::exception& e) {
+            response = { 500, e.what() };
+        }
+
+        return response;
+    }
+
+    crow::response post_session(const crow::request& req, lib::ObjectManager& manager, SessionManager& sessions) {
+        crow::response response;
+
+        try {
+            calc::request_t unpacked_request;
+            details::prepare_request_details(unpacked_request, requests_details::parse_body(req));
+            details::prepare_request_composed(unpacked_request, manager);
+
+            auto session = std::make_unique<calc::Session>(std::move(unpacked_request));
+            // session may be evicted right after it's created, so result is taken beforehand
+            auto result = session->result();
+            size_t recomputed = session->recomputed();
+            auto id = sessions.create(std::move(session));
+
+            bool is_cbor = requests_details::accepts_cbor(req);
+            response.body = requests_details::serialize(is_cbor, 128 + std::get<1>(result).size() * 24, {}, [&](auto& writer) {
+                requests_details::write_session(writer, id, result, recomputed);
+            });
+            if (is_cbor)
+                response.set_header("Content-Type", std::string(lib::cbor_mime));
+
+            response.code = 201;
+        } catch (const lib::DeadlineExceeded& e) {
+            response = { 504, e.what() };
+        } catch (const std::exception& e) {
+            response = { 500, e.what() };
+        }
+
+        return response;
+    }
+
+    crow::response patch_session(const crow::request& req, lib::ObjectManager& manager, SessionManager& sessions) {
+        crow::response response;
+
+        try {
+            const char* id_param = req.url_params.get("id");
+            if (id_param == nullptr)
+                throw RUNTIME_ERROR("session id isn't specified");
+
+            std::string id = id_param;
+            bool is_cbor = requests_details::accepts_cbor(req);
+            auto json = requests_details::parse_body(req);
+            const auto& table = json.as_object();
+
+            // everything is loaded before session is locked, failed update leaves session as it was
+            std::optional<calc::cell_t<zzz::Wengine>> wengine;
+            if (auto it = table.find("wid"); it != table.end()) {
+                uint64_t wid = it->second.as_integral();
+                auto ptr = manager.get(lib::ObjectKey("wengines", wid));
+
+                wengine = { wid, std::static_pointer_cast<zzz::Wengine>(ptr) };
+            }
+
+            std::vector<calc::Session::disc_change_t> discs;
+            if (auto it = table.find("discs"); it != table.end()) {
+                for (const auto& disc : it->second.as_array()) {
+                    size_t slot = disc.as_object().at("slot").as_integral();
+                    uint64_t disc_id = disc.as_object().at("id").as_integral();
+
+                    if (slot < 1 || slot > 6)
+                        throw FMT_RUNTIME_ERROR("disc slot {} is out of range", slot);
+
+                    auto ptr = manager.get(lib::ObjectKey("dds", disc_id));
+                    discs.push_back({
+                        .slot = slot - 1,
+                        .dds = { disc_id, std::static_pointer_cast<zzz::Dds>(ptr) },
+                        .ddp = details::prepare_ddp(disc, slot)
+                    });
+                }
+            }
+
+            bool is_found = sessions.update(id, [&](calc::Session& session) {
+                session.update(std::move(wengine), std::move(discs));
+
+                const auto& result = session.result();
+                response.body = requests_details::serialize(is_cbor, 128 + std::get<1>(result).size() * 24, {}, [&](auto& writer) {
+                    requests_details::write_session(writer, id, result, session.recomputed());
+                });
+            });
+
+            if (is_found && is_cbor)
+                response.set_header("Content-Type", std::string(lib::cbor_mime));
+            if (is_found)
+                response.code = 200;
+            else
+                response = { 404, lib::format("session {} doesn't exist", id) };
+        } catch (const lib::DeadlineExceeded& e) {
+            response = { 504, e.what() };
         } catch (const std::exception& e) {
             response = { 500, e.what() };
         }
 
         return response;
     }
+
+    crow::response delete_session(const crow::request& req, SessionManager& sessions) {
+        const char* id_param = req.url_params.get("id");
+
+        if (id_param == nullptr || !sessions.erase(id_param))
+            return { 404, "session doesn't exist" };
+
+        return crow::response(204);
+    }
+
+    crow::response get_metrics(const lib::ObjectManager& manager) {
+        static auto& objects = lib::metrics().gauge("zzz_objects", "", "Objects known by object manager");
+        static auto& resident = lib::metrics().gauge("zzz_objects_resident", "", "Objects loaded in memory");
+        static auto& resident_bytes = lib::metrics().gauge("zzz_objects_resident_bytes", "",
+            "Source file size of objects loaded in memory");
+
+        auto stats = manager.stats();
+        objects.set((int64_t) stats.objects);
+        resident.set((int64_t) stats.resident);
+        resident_bytes.set((int64_t) stats.resident_bytes);
+
+        crow::response response(200, lib::metrics().to_prometheus());
+        response.set_header("Content-Type", "text/plain; version=0.0.4");
+
+        return response;
+    }
 }
@@ -1,5 +1,9 @@
 #pragma once
 
+//std
+#include <optional>
+#include <string>
+
 //lib
 #include "library/cached_memory.hpp"
 
@@ -7,6 +11,9 @@
 #include "crow/http_request.h"
 #include "crow/http_response.h"
 
+//backend
+#include "backend/sessions.hpp"
+
 namespace backend::methods {
     std::string get_default();
 
@@ -15,5 +22,24 @@ namespace backend::methods {
 
     crow::response put_rotation(const crow::request& req);
 
+    // /damage and /team read cbor with Content-Type: application/cbor
+    // and respond with it to Accept: application/cbor, json is default for both
     crow::response post_damage(const crow::request& req, lib::ObjectManager& manager);
+    // key of /damage request for coalescing: parameters which change response,
+    // encodings of request and response and raw body.
+    // nullopt when request mustn't share response, which is when it's traced
+    std::optional<std::string> damage_request_key(const crow::request& req);
+    // body: { "members": [ <body as for /damage> ] } of up to 3 members, every member gets team_buffs of others.
+    // members are evaluated concurrently, responds with combined total and damage per member
+    crow::response post_team(const crow::request& req, lib::ObjectManager& manager);
+
+    // body is the same as for /damage, responds with session id and damage
+    crow::response post_session(const crow::request& req, lib::ObjectManager& manager, SessionManager& sessions);
+    // ?id=..., body: { "wid": 14109, "discs": [ { "slot": 1, <disc as for /damage> } ] }, both are optional
+    crow::response patch_session(const crow::request& req, lib::ObjectManager& manager, SessionManager& sessions);
+    // ?id=...
+    crow::response delete_session(const crow::request& req, SessionManager& sessions);
+
+    // prometheus text format
+    crow::response get_metrics(const lib::ObjectManager& manager);
 }
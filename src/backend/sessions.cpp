@@ -0,0 +1,167 @@
+#include "backend/sessions.hpp"
+
+//std
+#include <algorithm>
+#include <vector>
+
+//library
+#include "library/format.hpp"
+
+//crow
+#include "crow/logging.h"
+
+namespace backend {
+    SessionManager::SessionManager(std::chrono::seconds idle_timeout, size_t memory_limit) :
+        m_idle_timeout(idle_timeout),
+        m_memory_limit(memory_limit),
+        _random(std::random_device()()),
+        _size(lib::metrics().gauge("zzz_sessions", "", "Open evaluation sessions")),
+        _bytes(lib::metrics().gauge("zzz_sessions_bytes", "", "Approximate memory used by evaluation sessions")),
+        _expired(lib::metrics().counter("zzz_sessions_dropped_total", "reason=\"idle\"",
+            "Sessions dropped by manager")),
+        _evicted(lib::metrics().counter("zzz_sessions_dropped_total", "reason=\"memory\"",
+            "Sessions dropped by manager")) {
+    }
+
+    void SessionManager::set_idle_timeout(std::chrono::seconds idle_timeout) {
+        std::lock_guard lock(_mutex);
+        m_idle_timeout = idle_timeout;
+    }
+    void SessionManager::set_memory_limit(size_t memory_limit) {
+        std::lock_guard lock(_mutex);
+        m_memory_limit = memory_limit;
+    }
+
+    std::string SessionManager::create(std::unique_ptr<calc::Session> session) {
+        auto entry = std::make_shared<entry_t>();
+        entry->bytes = session->memory_usage();
+        entry->session = std::move(session);
+
+        std::lock_guard lock(_mutex);
+        auto now = clock::now();
+
+        if (entry->bytes > m_memory_limit)
+            throw FMT_RUNTIME_ERROR("session needs {} bytes while limit is {}", entry->bytes, m_memory_limit);
+
+        _collect_garbage_logic(now);
+
+        std::string id;
+        do {
+            id = lib::format("{:016x}", _random());
+        } while (m_sessions.contains(id));
+
+        entry->last_access = now;
+        m_bytes += entry->bytes;
+        m_sessions.emplace(id, std::move(entry));
+
+        _evict_logic(id);
+        _update_metrics();
+
+        return id;
+    }
+    bool SessionManager::update(const std::string& id, const std::function<void(calc::Session&)>& func) {
+        entry_ptr entry;
+
+        {
+            std::lock_guard lock(_mutex);
+            _collect_garbage_logic(clock::now());
+
+            auto it = m_sessions.find(id);
+            if (it == m_sessions.end())
+                return false;
+
+            entry = it->second;
+        }
+
+        size_t bytes;
+        {
+            std::lock_guard lock(entry->mutex);
+            func(*entry->session);
+            bytes = entry->session->memory_usage();
+        }
+
+        std::lock_guard lock(_mutex);
+
+        // session could be dropped while it was used
+        auto it = m_sessions.find(id);
+        if (it != m_sessions.end() && it->second == entry) {
+            m_bytes = m_bytes - entry->bytes + bytes;
+            entry->bytes = bytes;
+            entry->last_access = clock::now();
+
+            _evict_logic(id);
+            _update_metrics();
+        }
+
+        return true;
+    }
+    bool SessionManager::erase(const std::string& id) {
+        std::lock_guard lock(_mutex);
+
+        auto it = m_sessions.find(id);
+        if (it == m_sessions.end())
+            return false;
+
+        _erase_logic(it);
+        _update_metrics();
+
+        return true;
+    }
+
+    size_t SessionManager::size() const {
+        std::lock_guard lock(_mutex);
+        return m_sessions.size();
+    }
+    size_t SessionManager::memory_usage() const {
+        std::lock_guard lock(_mutex);
+        return m_bytes;
+    }
+
+    void SessionManager::collect_garbage() {
+        std::lock_guard lock(_mutex);
+        _collect_garbage_logic(clock::now());
+        _update_metrics();
+    }
+
+    void SessionManager::_collect_garbage_logic(clock::time_point now) {
+        for (auto it = m_sessions.begin(); it != m_sessions.end();) {
+            if (now - it->second->last_access < m_idle_timeout) {
+                ++it;
+                continue;
+            }
+
+            CROW_LOG_INFO << lib::format("session {} is dropped after being idle", it->first);
+            _expired.inc();
+            _erase_logic(it++);
+        }
+    }
+    void SessionManager::_evict_logic(const std::string& kept) {
+        if (m_bytes <= m_memory_limit)
+            return;
+
+        std::vector<std::pair<clock::time_point, std::string>> by_access;
+        by_access.reserve(m_sessions.size());
+        for (const auto& [id, entry] : m_sessions) {
+            if (id != kept)
+                by_access.emplace_back(entry->last_access, id);
+        }
+        std::ranges::sort(by_access);
+
+        for (const auto& [time, id] : by_access) {
+            if (m_bytes <= m_memory_limit)
+                break;
+
+            CROW_LOG_INFO << lib::format("session {} is dropped to fit into memory limit", id);
+            _evicted.inc();
+            _erase_logic(m_sessions.find(id));
+        }
+    }
+    void SessionManager::_erase_logic(std::unordered_map<std::string, entry_ptr>::iterator it) {
+        m_bytes -= it->second->bytes;
+        m_sessions.erase(it);
+    }
+    void SessionManager::_update_metrics() {
+        _size.set((int64_t) m_sessions.size());
+        _bytes.set((int64_t) m_bytes);
+    }
+}
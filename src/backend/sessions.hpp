@@ -0,0 +1,83 @@
+#pragma once
+
+//std
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <unordered_map>
+
+//library
+#include "library/metrics.hpp"
+
+//calculator
+#include "calc/session.hpp"
+
+namespace backend {
+    // owns sessions of interactive clients.
+    // session is dropped after it wasn't used for idle_timeout,
+    // and least recently used ones are dropped when sum of their sizes exceeds memory_limit
+    class SessionManager {
+    public:
+        using clock = std::chrono::steady_clock;
+
+        static constexpr auto default_idle_timeout = std::chrono::seconds(600);
+        static constexpr size_t default_memory_limit = 64ull << 20;
+
+        explicit SessionManager(
+            std::chrono::seconds idle_timeout = default_idle_timeout,
+            size_t memory_limit = default_memory_limit);
+
+        void set_idle_timeout(std::chrono::seconds idle_timeout);
+        void set_memory_limit(size_t memory_limit);
+
+        // returns id of new session
+        std::string create(std::unique_ptr<calc::Session> session);
+        // calls func while session is locked, returns false if session doesn't exist
+        bool update(const std::string& id, const std::function<void(calc::Session&)>& func);
+        bool erase(const std::string& id);
+
+        size_t size() const;
+        size_t memory_usage() const;
+
+        // drops sessions which are idle for too long
+        void collect_garbage();
+
+        // deleted members
+
+        SessionManager(const SessionManager&) = delete;
+        SessionManager& operator=(const SessionManager&) = delete;
+
+    protected:
+        struct entry_t {
+            std::mutex mutex;
+            std::unique_ptr<calc::Session> session;
+            clock::time_point last_access;
+            size_t bytes = 0;
+        };
+        using entry_ptr = std::shared_ptr<entry_t>;
+
+        std::unordered_map<std::string, entry_ptr> m_sessions;
+        std::chrono::seconds m_idle_timeout;
+        size_t m_memory_limit;
+        size_t m_bytes = 0;
+
+    private:
+        // guards everything above, never taken while session is locked
+        mutable std::mutex _mutex;
+        std::mt19937_64 _random;
+
+        lib::Gauge& _size;
+        lib::Gauge& _bytes;
+        lib::Counter& _expired;
+        lib::Counter& _evicted;
+
+        void _collect_garbage_logic(clock::time_point now);
+        // evicts least recently used sessions except kept one until memory fits into limit
+        void _evict_logic(const std::string& kept);
+        void _erase_logic(std::unordered_map<std::string, entry_ptr>::iterator it);
+        void _update_metrics();
+    };
+}
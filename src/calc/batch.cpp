@@ -0,0 +1,444 @@
+#include "calc/batch.hpp"
+
+//std
+#include <algorithm>
+#include <array>
+
+//lib
+#include "library/format.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define ZZZ_BATCH_X86
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define ZZZ_TARGET(isa)
+#else
+#define ZZZ_TARGET(isa) __attribute__((target(isa)))
+#endif
+#endif
+
+// this file has to be compiled without contraction of a * b + c into fma,
+// otherwise results would differ from Calculator::eval (see CMakeLists.txt)
+
+using namespace zzz;
+
+namespace calc::batch_details {
+    void eval_scalar_range(
+        const batch::cell_consts_t& cell,
+        const batch::Columns& c,
+        double* result,
+        size_t from,
+        size_t to) {
+        for (size_t i = from; i < to; i++)
+            result[i] = batch::eval_row(cell, c.row(i));
+    }
+
+    // base, crit and dmg ratio multipliers of row, the same product as the first four factors of eval_row
+    double shared_mult(double scale, const batch::row_t& row) {
+        using namespace batch;
+
+        double base_dmg = scale * row[AtkTotal];
+        double crit_mult = 1.0 + std::min(row[CritRate], 100.0) * row[CritDmg];
+        double dmg_ratio_mult = 1.0 + row[DmgRatio] + row[DmgRatioElement];
+        double anomaly_ratio_mult = 1.0 + row[AnomalyRatio] + row[AnomalyRatioElement];
+
+        return base_dmg
+            * crit_mult
+            * dmg_ratio_mult
+            * anomaly_ratio_mult;
+    }
+
+    void eval_enemies_range(
+        double shared,
+        const double* res_base,
+        const batch::row_t& row,
+        const batch::Enemies& e,
+        double* result,
+        size_t from,
+        size_t to) {
+        using namespace batch;
+
+        for (size_t i = from; i < to; i++) {
+            double dmg_taken_mult = e.dmg_taken_base[i] + row[Vulnerability];
+            double effective_def = e.defense[i] * (1 - row[DefPenRatio]) - row[DefPenFlat];
+            double def_mult = details::level_coefficient / (std::max(effective_def, 0.0) + details::level_coefficient);
+            double res_mult = res_base[i] + row[ResPen] + row[ResPenElement];
+
+            result[i] = shared
+                * dmg_taken_mult
+                * def_mult
+                * res_mult
+                * e.stun_mult[i];
+        }
+    }
+
+#ifdef ZZZ_BATCH_X86
+    // every intrinsic is separate rounding, same as batch::eval_row.
+    // min(hundred, x) and max(zero, x) keep operand order of std::min(x, 100.0) and std::max(x, 0.0)
+
+    ZZZ_TARGET("avx2")
+    void eval_avx2(const batch::cell_consts_t& cell, const batch::Columns& c, double* result, size_t size) {
+        const __m256d one = _mm256_set1_pd(1.0), zero = _mm256_setzero_pd(), hundred = _mm256_set1_pd(100.0);
+        const __m256d lc = _mm256_set1_pd(details::level_coefficient);
+        const __m256d scale = _mm256_set1_pd(cell.scale), defense = _mm256_set1_pd(cell.defense);
+        const __m256d dmg_taken_base = _mm256_set1_pd(cell.dmg_taken_base), res_base = _mm256_set1_pd(cell.res_base);
+        const __m256d stun_mult = _mm256_set1_pd(cell.stun_mult);
+
+        size_t i = 0;
+        for (; i + 4 <= size; i += 4) {
+            __m256d atk_total = _mm256_loadu_pd(c.atk_total.data() + i);
+            __m256d crit_rate = _mm256_loadu_pd(c.crit_rate.data() + i);
+            __m256d crit_dmg = _mm256_loadu_pd(c.crit_dmg.data() + i);
+            __m256d dmg_ratio = _mm256_loadu_pd(c.dmg_ratio.data() + i);
+            __m256d dmg_ratio_element = _mm256_loadu_pd(c.dmg_ratio_element.data() + i);
+            __m256d anomaly_ratio = _mm256_loadu_pd(c.anomaly_ratio.data() + i);
+            __m256d anomaly_ratio_element = _mm256_loadu_pd(c.anomaly_ratio_element.data() + i);
+            __m256d vulnerability = _mm256_loadu_pd(c.vulnerability.data() + i);
+            __m256d def_pen_ratio = _mm256_loadu_pd(c.def_pen_ratio.data() + i);
+            __m256d def_pen_flat = _mm256_loadu_pd(c.def_pen_flat.data() + i);
+            __m256d res_pen = _mm256_loadu_pd(c.res_pen.data() + i);
+            __m256d res_pen_element = _mm256_loadu_pd(c.res_pen_element.data() + i);
+
+            __m256d base_dmg = _mm256_mul_pd(scale, atk_total);
+            __m256d crit_mult = _mm256_add_pd(one, _mm256_mul_pd(_mm256_min_pd(hundred, crit_rate), crit_dmg));
+            __m256d dmg_ratio_mult = _mm256_add_pd(_mm256_add_pd(one, dmg_ratio), dmg_ratio_element);
+            __m256d anomaly_ratio_mult = _mm256_add_pd(_mm256_add_pd(one, anomaly_ratio), anomaly_ratio_element);
+
+            __m256d dmg_taken_mult = _mm256_add_pd(dmg_taken_base, vulnerability);
+            __m256d effective_def = _mm256_sub_pd(_mm256_mul_pd(defense, _mm256_sub_pd(one, def_pen_ratio)), def_pen_flat);
+            __m256d def_mult = _mm256_div_pd(lc, _mm256_add_pd(_mm256_max_pd(zero, effective_def), lc));
+            __m256d res_mult = _mm256_add_pd(_mm256_add_pd(res_base, res_pen), res_pen_element);
+
+            __m256d dmg = _mm256_mul_pd(base_dmg, crit_mult);
+            dmg = _mm256_mul_pd(dmg, dmg_ratio_mult);
+            dmg = _mm256_mul_pd(dmg, anomaly_ratio_mult);
+            dmg = _mm256_mul_pd(dmg, dmg_taken_mult);
+            dmg = _mm256_mul_pd(dmg, def_mult);
+            dmg = _mm256_mul_pd(dmg, res_mult);
+            dmg = _mm256_mul_pd(dmg, stun_mult);
+
+            _mm256_storeu_pd(result + i, dmg);
+        }
+
+        eval_scalar_range(cell, c, result, i, size);
+    }
+
+    ZZZ_TARGET("avx512f")
+    void eval_avx512(const batch::cell_consts_t& cell, const batch::Columns& c, double* result, size_t size) {
+        const __m512d one = _mm512_set1_pd(1.0), zero = _mm512_setzero_pd(), hundred = _mm512_set1_pd(100.0);
+        const __m512d lc = _mm512_set1_pd(details::level_coefficient);
+        const __m512d scale = _mm512_set1_pd(cell.scale), defense = _mm512_set1_pd(cell.defense);
+        const __m512d dmg_taken_base = _mm512_set1_pd(cell.dmg_taken_base), res_base = _mm512_set1_pd(cell.res_base);
+        const __m512d stun_mult = _mm512_set1_pd(cell.stun_mult);
+
+        size_t i = 0;
+        for (; i + 8 <= size; i += 8) {
+            __m512d atk_total = _mm512_loadu_pd(c.atk_total.data() + i);
+            __m512d crit_rate = _mm512_loadu_pd(c.crit_rate.data() + i);
+            __m512d crit_dmg = _mm512_loadu_pd(c.crit_dmg.data() + i);
+            __m512d dmg_ratio = _mm512_loadu_pd(c.dmg_ratio.data() + i);
+            __m512d dmg_ratio_element = _mm512_loadu_pd(c.dmg_ratio_element.data() + i);
+            __m512d anomaly_ratio = _mm512_loadu_pd(c.anomaly_ratio.data() + i);
+            __m512d anomaly_ratio_element = _mm512_loadu_pd(c.anomaly_ratio_element.data() + i);
+            __m512d vulnerability = _mm512_loadu_pd(c.vulnerability.data() + i);
+            __m512d def_pen_ratio = _mm512_loadu_pd(c.def_pen_ratio.data() + i);
+            __m512d def_pen_flat = _mm512_loadu_pd(c.def_pen_flat.data() + i);
+            __m512d res_pen = _mm512_loadu_pd(c.res_pen.data() + i);
+            __m512d res_pen_element = _mm512_loadu_pd(c.res_pen_element.data() + i);
+
+            __m512d base_dmg = _mm512_mul_pd(scale, atk_total);
+            __m512d crit_mult = _mm512_add_pd(one, _mm512_mul_pd(_mm512_min_pd(hundred, crit_rate), crit_dmg));
+            __m512d dmg_ratio_mult = _mm512_add_pd(_mm512_add_pd(one, dmg_ratio), dmg_ratio_element);
+            __m512d anomaly_ratio_mult = _mm512_add_pd(_mm512_add_pd(one, anomaly_ratio), anomaly_ratio_element);
+
+            __m512d dmg_taken_mult = _mm512_add_pd(dmg_taken_base, vulnerability);
+            __m512d effective_def = _mm512_sub_pd(_mm512_mul_pd(defense, _mm512_sub_pd(one, def_pen_ratio)), def_pen_flat);
+            __m512d def_mult = _mm512_div_pd(lc, _mm512_add_pd(_mm512_max_pd(zero, effective_def), lc));
+            __m512d res_mult = _mm512_add_pd(_mm512_add_pd(res_base, res_pen), res_pen_element);
+
+            __m512d dmg = _mm512_mul_pd(base_dmg, crit_mult);
+            dmg = _mm512_mul_pd(dmg, dmg_ratio_mult);
+            dmg = _mm512_mul_pd(dmg, anomaly_ratio_mult);
+            dmg = _mm512_mul_pd(dmg, dmg_taken_mult);
+            dmg = _mm512_mul_pd(dmg, def_mult);
+            dmg = _mm512_mul_pd(dmg, res_mult);
+            dmg = _mm512_mul_pd(dmg, stun_mult);
+
+            _mm512_storeu_pd(result + i, dmg);
+        }
+
+        eval_scalar_range(cell, c, result, i, size);
+    }
+
+    ZZZ_TARGET("avx2")
+    void eval_enemies_avx2(
+        double shared,
+        const double* res_base,
+        const batch::row_t& row,
+        const batch::Enemies& e,
+        double* result,
+        size_t size) {
+        using namespace batch;
+
+        const __m256d one = _mm256_set1_pd(1.0), zero = _mm256_setzero_pd();
+        const __m256d lc = _mm256_set1_pd(details::level_coefficient);
+        const __m256d shared_mult = _mm256_set1_pd(shared);
+        const __m256d vulnerability = _mm256_set1_pd(row[Vulnerability]);
+        const __m256d def_pen_ratio = _mm256_set1_pd(row[DefPenRatio]), def_pen_flat = _mm256_set1_pd(row[DefPenFlat]);
+        const __m256d res_pen = _mm256_set1_pd(row[ResPen]), res_pen_element = _mm256_set1_pd(row[ResPenElement]);
+
+        size_t i = 0;
+        for (; i + 4 <= size; i += 4) {
+            __m256d defense = _mm256_loadu_pd(e.defense.data() + i);
+            __m256d dmg_taken_base = _mm256_loadu_pd(e.dmg_taken_base.data() + i);
+            __m256d res = _mm256_loadu_pd(res_base + i);
+            __m256d stun_mult = _mm256_loadu_pd(e.stun_mult.data() + i);
+
+            __m256d dmg_taken_mult = _mm256_add_pd(dmg_taken_base, vulnerability);
+            __m256d effective_def = _mm256_sub_pd(_mm256_mul_pd(defense, _mm256_sub_pd(one, def_pen_ratio)), def_pen_flat);
+            __m256d def_mult = _mm256_div_pd(lc, _mm256_add_pd(_mm256_max_pd(zero, effective_def), lc));
+            __m256d res_mult = _mm256_add_pd(_mm256_add_pd(res, res_pen), res_pen_element);
+
+            __m256d dmg = _mm256_mul_pd(shared_mult, dmg_taken_mult);
+            dmg = _mm256_mul_pd(dmg, def_mult);
+            dmg = _mm256_mul_pd(dmg, res_mult);
+            dmg = _mm256_mul_pd(dmg, stun_mult);
+
+            _mm256_storeu_pd(result + i, dmg);
+        }
+
+        eval_enemies_range(shared, res_base, row, e, result, i, size);
+    }
+
+    bool has_avx2() {
+#if defined(_MSC_VER) && !defined(__clang__)
+        std::array<int, 4> info;
+        __cpuid(info.data(), 1);
+        bool has_os_support = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 0x6) == 0x6;
+        __cpuidex(info.data(), 7, 0);
+        return has_os_support && (info[1] & (1 << 5)) != 0;
+#else
+        return __builtin_cpu_supports("avx2");
+#endif
+    }
+    bool has_avx512() {
+#if defined(_MSC_VER) && !defined(__clang__)
+        std::array<int, 4> info;
+        __cpuid(info.data(), 1);
+        // xmm, ymm, opmask and both halves of zmm registers are saved by os
+        bool has_os_support = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 0xe6) == 0xe6;
+        __cpuidex(info.data(), 7, 0);
+        return has_os_support && (info[1] & (1 << 16)) != 0;
+#else
+        return __builtin_cpu_supports("avx512f");
+#endif
+    }
+#endif
+
+    struct dispatch_t {
+        std::string_view isa = "scalar";
+        void(*kernel)(const batch::cell_consts_t&, const batch::Columns&, double*, size_t) = nullptr;
+        // there are only few enemies per request, so avx2 is enough for them
+        void(*enemies_kernel)(double, const double*, const batch::row_t&, const batch::Enemies&, double*, size_t) = nullptr;
+    };
+
+    const dispatch_t& dispatch() {
+        static const dispatch_t result = [] {
+#ifdef ZZZ_BATCH_X86
+            if (has_avx512())
+                return dispatch_t { .isa = "avx512", .kernel = &eval_avx512, .enemies_kernel = &eval_enemies_avx2 };
+            if (has_avx2())
+                return dispatch_t { .isa = "avx2", .kernel = &eval_avx2, .enemies_kernel = &eval_enemies_avx2 };
+#endif
+            return dispatch_t {};
+        }();
+
+        return result;
+    }
+}
+
+namespace calc::batch {
+    // Columns
+
+    Columns::Columns(size_t size) {
+        resize(size);
+    }
+
+    size_t Columns::size() const { return atk_total.size(); }
+    void Columns::resize(size_t size) {
+        for (auto* column : {
+            &atk_total, &crit_rate, &crit_dmg,
+            &dmg_ratio, &dmg_ratio_element,
+            &anomaly_ratio, &anomaly_ratio_element,
+            &vulnerability, &def_pen_ratio, &def_pen_flat,
+            &res_pen, &res_pen_element
+        })
+            column->resize(size);
+    }
+
+    row_t Columns::row(size_t index) const {
+        return {
+            atk_total[index], crit_rate[index], crit_dmg[index],
+            dmg_ratio[index], dmg_ratio_element[index],
+            anomaly_ratio[index], anomaly_ratio_element[index],
+            vulnerability[index], def_pen_ratio[index], def_pen_flat[index],
+            res_pen[index], res_pen_element[index]
+        };
+    }
+    void Columns::set_row(size_t index, const row_t& row) {
+        atk_total[index] = row[AtkTotal];
+        crit_rate[index] = row[CritRate];
+        crit_dmg[index] = row[CritDmg];
+        dmg_ratio[index] = row[DmgRatio];
+        dmg_ratio_element[index] = row[DmgRatioElement];
+        anomaly_ratio[index] = row[AnomalyRatio];
+        anomaly_ratio_element[index] = row[AnomalyRatioElement];
+        vulnerability[index] = row[Vulnerability];
+        def_pen_ratio[index] = row[DefPenRatio];
+        def_pen_flat[index] = row[DefPenFlat];
+        res_pen[index] = row[ResPen];
+        res_pen_element[index] = row[ResPenElement];
+    }
+
+    void Columns::set_regular(size_t row, StatsGrid stats, const SkillDetails& skill, size_t index) {
+        stats.add(skill.buffs());
+        set_regular(row, stats.fold(skill.tags()), skill, index);
+    }
+    void Columns::set_anomaly(size_t row, StatsGrid stats, const AnomalyDetails& anomaly) {
+        stats.add(anomaly.buffs());
+        set_anomaly(row, stats.fold(Tag::Anomaly), anomaly);
+    }
+    void Columns::set_regular(size_t row, const FoldedStats& stats, const SkillDetails& skill, size_t index) {
+        const auto& scale = skill.scales()[index];
+
+        atk_total[row] = stats.universal[StatId::AtkTotal];
+        crit_rate[row] = stats.total[StatId::CritRate];
+        crit_dmg[row] = stats.total[StatId::CritDmg];
+        dmg_ratio[row] = stats.total[StatId::DmgRatio];
+        dmg_ratio_element[row] = stats.total[StatId::DmgRatio + scale.element];
+        anomaly_ratio[row] = 0.0;
+        anomaly_ratio_element[row] = 0.0;
+        vulnerability[row] = stats.total[StatId::Vulnerability];
+        def_pen_ratio[row] = stats.total[StatId::DefPenRatio];
+        def_pen_flat[row] = stats.total[StatId::DefPenFlat];
+        res_pen[row] = stats.total[StatId::ResPen];
+        res_pen_element[row] = stats.total[StatId::ResPen + scale.element];
+    }
+    void Columns::set_anomaly(size_t row, const FoldedStats& stats, const AnomalyDetails& anomaly) {
+        atk_total[row] = stats.universal[StatId::AtkTotal];
+        // 1.0 + min(0, 100) * 0 is exactly 1.0
+        crit_rate[row] = anomaly.can_crit() ? stats.tagged[StatId::CritRate] : 0.0;
+        crit_dmg[row] = anomaly.can_crit() ? stats.tagged[StatId::CritDmg] : 0.0;
+        dmg_ratio[row] = stats.universal[StatId::DmgRatio];
+        dmg_ratio_element[row] = stats.universal[StatId::DmgRatio + anomaly.element()];
+        anomaly_ratio[row] = stats.tagged[StatId::DmgRatio];
+        anomaly_ratio_element[row] = stats.universal[StatId::DmgRatio + anomaly.element()];
+        vulnerability[row] = stats.total[StatId::Vulnerability];
+        def_pen_ratio[row] = stats.total[StatId::DefPenRatio];
+        def_pen_flat[row] = stats.total[StatId::DefPenFlat];
+        res_pen[row] = stats.total[StatId::ResPen];
+        res_pen_element[row] = stats.total[StatId::ResPen + anomaly.element()];
+    }
+
+    // Enemies
+
+    Enemies::Enemies(std::span<const enemy_t> enemies) {
+        defense.reserve(enemies.size());
+        dmg_taken_base.reserve(enemies.size());
+        stun_mult.reserve(enemies.size());
+        for (auto& it : res_base)
+            it.reserve(enemies.size());
+
+        for (const auto& it : enemies) {
+            defense.emplace_back(it.defense);
+            dmg_taken_base.emplace_back(1.0 - it.dmg_reduction);
+            stun_mult.emplace_back(details::calc_stun_mult(it));
+            for (size_t i = 0; i < res_base.size(); i++)
+                res_base[i].emplace_back(1.0 - it.res[i]);
+        }
+    }
+
+    size_t Enemies::size() const { return defense.size(); }
+
+    // consts
+
+    cell_consts_t make_regular_consts(const SkillDetails& skill, size_t index, const enemy_t& enemy) {
+        const auto& scale = skill.scales()[index];
+
+        return {
+            .scale = scale.motion_value / 100,
+            .defense = enemy.defense,
+            .dmg_taken_base = 1.0 - enemy.dmg_reduction,
+            .res_base = 1.0 - enemy.res[scale.element],
+            .stun_mult = details::calc_stun_mult(enemy)
+        };
+    }
+    cell_consts_t make_anomaly_consts(const AnomalyDetails& anomaly, const enemy_t& enemy) {
+        return {
+            .scale = anomaly.scale() / 100,
+            .defense = enemy.defense,
+            .dmg_taken_base = 1.0 - enemy.dmg_reduction,
+            .res_base = 1.0 - enemy.res[anomaly.element()],
+            .stun_mult = details::calc_stun_mult(enemy)
+        };
+    }
+
+    // evaluation
+
+    void eval(const cell_consts_t& cell, const Columns& columns, std::span<double> result) {
+        if (result.size() < columns.size())
+            throw FMT_RUNTIME_ERROR("batch result has {} rows while columns have {}", result.size(), columns.size());
+
+        const auto& dispatch = batch_details::dispatch();
+        if (dispatch.kernel != nullptr)
+            dispatch.kernel(cell, columns, result.data(), columns.size());
+        else
+            batch_details::eval_scalar_range(cell, columns, result.data(), 0, columns.size());
+    }
+    void eval_scalar(const cell_consts_t& cell, const Columns& columns, std::span<double> result) {
+        if (result.size() < columns.size())
+            throw FMT_RUNTIME_ERROR("batch result has {} rows while columns have {}", result.size(), columns.size());
+
+        batch_details::eval_scalar_range(cell, columns, result.data(), 0, columns.size());
+    }
+
+    double eval_row(const cell_consts_t& cell, const row_t& row) {
+        double base_dmg = cell.scale * row[AtkTotal];
+        double crit_mult = 1.0 + std::min(row[CritRate], 100.0) * row[CritDmg];
+        double dmg_ratio_mult = 1.0 + row[DmgRatio] + row[DmgRatioElement];
+        double anomaly_ratio_mult = 1.0 + row[AnomalyRatio] + row[AnomalyRatioElement];
+
+        double dmg_taken_mult = cell.dmg_taken_base + row[Vulnerability];
+        double effective_def = cell.defense * (1 - row[DefPenRatio]) - row[DefPenFlat];
+        double def_mult = details::level_coefficient / (std::max(effective_def, 0.0) + details::level_coefficient);
+        double res_mult = cell.res_base + row[ResPen] + row[ResPenElement];
+
+        return base_dmg
+            * crit_mult
+            * dmg_ratio_mult
+            * anomaly_ratio_mult
+            * dmg_taken_mult
+            * def_mult
+            * res_mult
+            * cell.stun_mult;
+    }
+
+    void eval_enemies(double scale, Element element, const row_t& row, const Enemies& enemies, std::span<double> result) {
+        if (result.size() < enemies.size())
+            throw FMT_RUNTIME_ERROR("result has {} rows while there are {} enemies", result.size(), enemies.size());
+
+        double shared = batch_details::shared_mult(scale, row);
+        const double* res_base = enemies.res_base[(size_t) element].data();
+
+        const auto& dispatch = batch_details::dispatch();
+        if (dispatch.enemies_kernel != nullptr)
+            dispatch.enemies_kernel(shared, res_base, row, enemies, result.data(), enemies.size());
+        else
+            batch_details::eval_enemies_range(shared, res_base, row, enemies, result.data(), 0, enemies.size());
+    }
+
+    std::string_view selected_isa() {
+        return batch_details::dispatch().isa;
+    }
+}
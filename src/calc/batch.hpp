@@ -0,0 +1,97 @@
+#pragma once
+
+//std
+#include <array>
+#include <span>
+#include <string_view>
+#include <vector>
+
+//calculator
+#include "calc/details.hpp"
+
+namespace calc::batch {
+    // per cell values which are the same for every build
+    struct cell_consts_t {
+        // motion_value / 100 or anomaly scale / 100
+        double scale;
+        double defense;
+        // 1.0 - enemy.dmg_reduction
+        double dmg_taken_base;
+        // 1.0 - enemy.res[element]
+        double res_base;
+        // stun_mult of stunned enemy, 1.0 otherwise
+        double stun_mult;
+    };
+
+    // order of columns in row_t
+    enum column_id : size_t {
+        AtkTotal, CritRate, CritDmg, DmgRatio, DmgRatioElement,
+        AnomalyRatio, AnomalyRatioElement, Vulnerability,
+        DefPenRatio, DefPenFlat, ResPen, ResPenElement,
+        ColumnCount
+    };
+    using row_t = std::array<double, ColumnCount>;
+
+    // structure of arrays, one row per build.
+    // every column keeps exactly what Calculator::eval sums up for one cell,
+    // so kernel does the same operations in the same order
+    class Columns {
+    public:
+        explicit Columns(size_t size = 0);
+
+        size_t size() const;
+        void resize(size_t size);
+
+        // mirrors details::calc_regular_dmg
+        void set_regular(size_t row, zzz::StatsGrid stats, const zzz::SkillDetails& skill, size_t index);
+        // mirrors details::calc_anomaly_dmg
+        void set_anomaly(size_t row, zzz::StatsGrid stats, const zzz::AnomalyDetails& anomaly);
+        // stats already folded with buffs and tags of ability, see details::FoldCache
+        void set_regular(size_t row, const zzz::FoldedStats& stats, const zzz::SkillDetails& skill, size_t index);
+        void set_anomaly(size_t row, const zzz::FoldedStats& stats, const zzz::AnomalyDetails& anomaly);
+
+        row_t row(size_t index) const;
+        void set_row(size_t index, const row_t& row);
+
+        std::vector<double> atk_total;
+        std::vector<double> crit_rate, crit_dmg;
+        std::vector<double> dmg_ratio, dmg_ratio_element;
+        // zeros for regular skills, so anomaly multiplier becomes exactly 1.0
+        std::vector<double> anomaly_ratio, anomaly_ratio_element;
+        std::vector<double> vulnerability;
+        std::vector<double> def_pen_ratio, def_pen_flat;
+        std::vector<double> res_pen, res_pen_element;
+    };
+
+    // structure of arrays, one row per enemy.
+    // values are the same as enemy parts of cell_consts_t
+    class Enemies {
+    public:
+        explicit Enemies(std::span<const enemy_t> enemies);
+
+        size_t size() const;
+
+        std::vector<double> defense;
+        std::vector<double> dmg_taken_base;
+        // indexed by element
+        std::array<std::vector<double>, (size_t) zzz::Element::Count> res_base;
+        std::vector<double> stun_mult;
+    };
+
+    cell_consts_t make_regular_consts(const zzz::SkillDetails& skill, size_t index, const enemy_t& enemy);
+    cell_consts_t make_anomaly_consts(const zzz::AnomalyDetails& anomaly, const enemy_t& enemy);
+
+    // computes damage of one cell for every build, result has to be at least columns.size() long.
+    // picks widest instruction set supported by cpu, results are bit identical for every one of them
+    void eval(const cell_consts_t& cell, const Columns& columns, std::span<double> result);
+    // forced scalar version, reference for vectorized ones
+    void eval_scalar(const cell_consts_t& cell, const Columns& columns, std::span<double> result);
+    // damage of one cell for one build, same operations as eval_scalar
+    double eval_row(const cell_consts_t& cell, const row_t& row);
+    // damage of one cell for one build against every enemy, result has to be at least enemies.size() long.
+    // multipliers which don't depend on enemy are computed once, results are bit identical to eval_row
+    void eval_enemies(double scale, zzz::Element element, const row_t& row, const Enemies& enemies, std::span<double> result);
+
+    // "avx512", "avx2" or "scalar"
+    std::string_view selected_isa();
+}
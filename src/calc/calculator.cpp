@@ -1,12 +1,20 @@
 #include "calc/calculator.hpp"
 
 //std
+#include <algorithm>
 #include <array>
 #include <map>
+#include <optional>
 #include <ranges>
 
 //lib
+#include "library/deadline.hpp"
 #include "library/format.hpp"
+#include "library/metrics.hpp"
+#include "library/trace.hpp"
+
+//calculator
+#include "calc/batch.hpp"
 
 //zzz
 #include "zzz/stats/grid.hpp"
@@ -17,9 +25,8 @@ using namespace zzz;
 namespace calc::details {
     constexpr size_t level = 60;
     constexpr double buff_level_mult = 1.0 + (level - 1.0) / 59.0;
-    constexpr double level_coefficient = 794.0;
 
-    double get_value(const StatsGrid& table, StatId id, std::span<const Tag> tags) {
+    double get_value(const StatsGrid& table, StatId id, TagMask tags) {
         double result = table.get_value({ .id = id, .tag = Tag::Universal });
 
         for (const auto& tag : tags)
@@ -28,48 +35,46 @@ namespace calc::details {
         return result;
     }
 
-    double calc_def_mult(const enemy_t& enemy, const StatsGrid& stats, std::span<const Tag> tags) {
+    double calc_def_mult(const enemy_t& enemy, const FoldedStats& stats) {
         double effective_def = enemy.defense
-            * (1 - get_value(stats, StatId::DefPenRatio, tags))
-            - get_value(stats, StatId::DefPenFlat, tags);
+            * (1 - stats.total[StatId::DefPenRatio])
+            - stats.total[StatId::DefPenFlat];
         return level_coefficient / (std::max(effective_def, 0.0) + level_coefficient);
     }
-    double calc_dmg_taken_mult(const enemy_t& enemy, const StatsGrid& stats, std::span<const Tag> tags) {
+    double calc_dmg_taken_mult(const enemy_t& enemy, const FoldedStats& stats) {
         return 1.0
             - enemy.dmg_reduction
-            + get_value(stats, StatId::Vulnerability, tags);
+            + stats.total[StatId::Vulnerability];
     }
-    double calc_res_mult(const enemy_t& enemy, const StatsGrid& stats, Element element, std::span<const Tag> tags) {
+    double calc_res_mult(const enemy_t& enemy, const FoldedStats& stats, Element element) {
         return 1.0 - enemy.res[element]
-            + get_value(stats, StatId::ResPen, tags)
-            + get_value(stats, StatId::ResPen + element, tags);
+            + stats.total[StatId::ResPen]
+            + stats.total[StatId::ResPen + element];
     }
-    // TODO
-    double calc_stun_mult(const enemy_t& enemy, const StatsGrid& stats) {
+    double calc_stun_mult(const enemy_t& enemy) {
         return enemy.is_stunned ? enemy.stun_mult : 1.0;
     }
 
+    // stats have to be folded with buffs and tags of skill
     double calc_regular_dmg(
         const SkillDetails& skill,
         size_t index,
-        StatsGrid stats,
+        const FoldedStats& stats,
         const enemy_t& enemy) {
         const auto& scale = skill.scales()[index];
 
-        stats.add(skill.buffs());
-
-        double base_dmg = scale.motion_value / 100 * stats.get_value({ .id = StatId::AtkTotal, .tag = Tag::Universal });
+        double base_dmg = scale.motion_value / 100 * stats.universal[StatId::AtkTotal];
         double crit_mult = 1.0
-            + std::min(get_value(stats, StatId::CritRate, skill.tags()), 100.0)
-            * get_value(stats, StatId::CritDmg, skill.tags());
+            + std::min(stats.total[StatId::CritRate], 100.0)
+            * stats.total[StatId::CritDmg];
         double dmg_ratio_mult = 1.0
-            + get_value(stats, StatId::DmgRatio, skill.tags())
-            + get_value(stats, StatId::DmgRatio + scale.element, skill.tags());
+            + stats.total[StatId::DmgRatio]
+            + stats.total[StatId::DmgRatio + scale.element];
 
-        double dmg_taken_mult = calc_dmg_taken_mult(enemy, stats, skill.tags());
-        double def_mult = calc_def_mult(enemy, stats, skill.tags());
-        double res_mult = calc_res_mult(enemy, stats, scale.element, skill.tags());
-        double stun_mult = 1.0 + calc_stun_mult(enemy, stats);
+        double dmg_taken_mult = calc_dmg_taken_mult(enemy, stats);
+        double def_mult = calc_def_mult(enemy, stats);
+        double res_mult = calc_res_mult(enemy, stats, scale.element);
+        double stun_mult = calc_stun_mult(enemy);
 
         return base_dmg
             * crit_mult
@@ -79,31 +84,28 @@ namespace calc::details {
             * res_mult
             * stun_mult;
     }
+    // stats have to be folded with buffs of anomaly and Tag::Anomaly
     double calc_anomaly_dmg(
         const AnomalyDetails& anomaly,
         Element element,
-        StatsGrid stats,
+        const FoldedStats& stats,
         const enemy_t& enemy) {
-        stats.add(anomaly.buffs());
-
-        static constexpr std::array<Tag, 1> default_anomaly_tag = { Tag::Anomaly };
-
-        double base_dmg = anomaly.scale() / 100 * stats.get_value({ .id = StatId::AtkTotal, .tag = Tag::Universal });
+        double base_dmg = anomaly.scale() / 100 * stats.universal[StatId::AtkTotal];
         double crit_mult = 1.0 + (anomaly.can_crit()
-            ? std::min(stats.get_value({ .id = StatId::CritRate, .tag = Tag::Anomaly }), 100.0)
-            * stats.get_value({ .id = StatId::CritDmg, .tag = Tag::Anomaly })
+            ? std::min(stats.tagged[StatId::CritRate], 100.0)
+            * stats.tagged[StatId::CritDmg]
             : 0.0);
         double dmg_ratio_mult = 1.0
-            + stats.get_value({ .id = StatId::DmgRatio, .tag = Tag::Universal })
-            + stats.get_value({ .id = StatId::DmgRatio + anomaly.element(), .tag = Tag::Universal });
+            + stats.universal[StatId::DmgRatio]
+            + stats.universal[StatId::DmgRatio + anomaly.element()];
         double anomaly_ratio_mult = 1.0
-            + stats.get_value({ .id = StatId::DmgRatio, .tag = Tag::Anomaly })
-            + stats.get_value({ .id = StatId::DmgRatio + anomaly.element(), .tag = Tag::Universal });
+            + stats.tagged[StatId::DmgRatio]
+            + stats.universal[StatId::DmgRatio + anomaly.element()];
 
-        double dmg_taken_mult = calc_dmg_taken_mult(enemy, stats, default_anomaly_tag);
-        double def_mult = calc_def_mult(enemy, stats, default_anomaly_tag);
-        double res_mult = calc_res_mult(enemy, stats, anomaly.element(), default_anomaly_tag);
-        double stun_mult = 1.0 + calc_stun_mult(enemy, stats);
+        double dmg_taken_mult = calc_dmg_taken_mult(enemy, stats);
+        double def_mult = calc_def_mult(enemy, stats);
+        double res_mult = calc_res_mult(enemy, stats, anomaly.element());
+        double stun_mult = calc_stun_mult(enemy);
 
         return base_dmg
             * crit_mult
@@ -115,7 +117,57 @@ namespace calc::details {
             * stun_mult;
     }
 
+    // FoldCache
+
+    FoldCache::FoldCache(const StatsGrid& stats) :
+        _stats(stats) {
+    }
+
+    const FoldedStats& FoldCache::of(const SkillDetails& skill) {
+        return _fold(skill.buffs(), skill.tags());
+    }
+    const FoldedStats& FoldCache::of(const AnomalyDetails& anomaly) {
+        return _fold(anomaly.buffs(), Tag::Anomaly);
+    }
+
+    const FoldedStats& FoldCache::_fold(const StatsGrid& buffs, TagMask tags) {
+        // abilities without buffs share folded stats of their tag set
+        key_t key = { buffs.empty() ? nullptr : &buffs, tags };
+
+        auto it = _folds.find(key);
+        if (it != _folds.end())
+            return *it->second;
+
+        std::unique_ptr<FoldedStats> folded;
+        if (buffs.empty())
+            folded = std::make_unique<FoldedStats>(_stats.fold(tags));
+        else {
+            StatsGrid stats = _stats;
+            stats.add(buffs);
+            folded = std::make_unique<FoldedStats>(stats.fold(tags));
+        }
+
+        return *_folds.emplace(std::move(key), std::move(folded)).first->second;
+    }
+
+    enemy_t make_enemy(const EnemyDetails& details, bool is_stunned) {
+        enemy_t result = {
+            .dmg_reduction = details.dmg_reduction(),
+            .defense = details.defense(),
+            .stun_mult = details.stun_mult(),
+            .res = {},
+            .is_stunned = is_stunned
+        };
+
+        for (size_t i = 0; i < result.res.size(); i++)
+            result.res[i] = details.res(i);
+
+        return result;
+    }
+
     StatsGrid calc_stats(const request_t& request) {
+        lib::TraceScope scope("calc_stats");
+
         StatsGrid result;
 
         result.add(request.agent->details().stats());
@@ -133,8 +185,32 @@ namespace calc::details {
                 result.add(dds.pc4());
         }
 
+        for (const auto& it : request.teammates)
+            result.add(it->details().team_buffs());
+
         return result;
     }
+
+    const AnomalyDetails* add_buildup(
+        AnomalyBuildup& buildup,
+        const AgentDetails& agent,
+        const SkillDetails& skill,
+        size_t index,
+        const FoldedStats& stats) {
+        const auto& scale = skill.scales()[index];
+
+        double rate = stats.total[StatId::AbRate];
+        double pen = stats.total[StatId::AbPen];
+        double mastery = stats.universal[StatId::AmTotal];
+
+        Element procced = buildup.add(scale.element, AnomalyBuildup::calc_buildup(scale.buildup, mastery, rate, pen));
+        if (procced == Element::None)
+            return nullptr;
+
+        // agent has every anomaly, either its own definition or standard one
+        auto anomaly_index = agent.ability_index(AnomalyDetails::get_anomaly_by_element(procced));
+        return &std::get<AnomalyDetails>(agent.ability_at(anomaly_index));
+    }
 }
 
 #ifdef DEBUG_STATUS
@@ -215,75 +291,291 @@ namespace calc {
         .dmg_reduction = 0.2,
         .defense = 953,
         .stun_mult = 1.5,
-        .res = { 0.2, 0.2, 0.2, 0.2, 0.2 },
+        .res = { 0.0, 0.2, 0.2, 0.2, 0.2, 0.2 },
         .is_stunned = false
     };
 
-    Calculator::result_t Calculator::eval(const request_t& request) {
+    Calculator::result_t Calculator::eval(const request_t& request, std::vector<proc_t>* procs) {
         const auto& agent = request.agent->details();
         const auto& rotation = request.rotation->details();
 
         double total_dmg = 0.0;
         std::vector<double> dmg_per_ability;
 
+        static auto& stats_time = lib::stage_histogram("stats");
+        static auto& eval_time = lib::stage_histogram("eval");
+
+        lib::ScopedTimer stats_timer(stats_time);
         StatsGrid stats = details::calc_stats(request);
         stats.add(StatsGrid::make_defined_relative_stat(StatId::AtkTotal, Tag::Universal));
+        std::optional<AnomalyBuildup> buildup;
+        if (request.buildup_threshold.has_value()) {
+            stats.add(StatsGrid::make_defined_relative_stat(StatId::AmTotal, Tag::Universal));
+            buildup.emplace(*request.buildup_threshold);
+        }
+        details::FoldCache folds(stats);
+        stats_timer.stop();
+
+        lib::ScopedTimer eval_timer(eval_time);
 
         dmg_per_ability.reserve(rotation.size());
         for (size_t i = 0; i < rotation.size(); i++) {
+            lib::Deadline::check();
             const auto& cell = rotation[i];
+            lib::TraceScope scope("cell", cell.command);
             const auto& ability = agent.ability(cell.command);
+            const AnomalyDetails* procced = nullptr;
             double dmg;
 
             if (std::holds_alternative<SkillDetails>(ability)) {
                 const auto& skill = std::get<SkillDetails>(ability);
-                dmg = details::calc_regular_dmg(skill, cell.index - 1, stats, enemy);
+                dmg = details::calc_regular_dmg(skill, cell.index - 1, folds.of(skill), enemy);
+                if (buildup.has_value())
+                    procced = details::add_buildup(*buildup, agent, skill, cell.index - 1, folds.of(skill));
             } else if (std::holds_alternative<AnomalyDetails>(ability)) {
                 const auto& anomaly = std::get<AnomalyDetails>(ability);
-                dmg = details::calc_anomaly_dmg(anomaly, agent.element(), stats, enemy);
+                // buildup procs anomalies by itself, listed ones would be counted twice
+                dmg = buildup.has_value() ? 0.0 : details::calc_anomaly_dmg(anomaly, agent.element(), folds.of(anomaly), enemy);
             } else
                 throw RUNTIME_ERROR("ability is neither skill nor anomaly");
 
             total_dmg += dmg;
             dmg_per_ability.emplace_back(dmg);
+
+            if (procced != nullptr) {
+                dmg = details::calc_anomaly_dmg(*procced, agent.element(), folds.of(*procced), enemy);
+                total_dmg += dmg;
+                if (procs != nullptr)
+                    procs->emplace_back(i, (uint16_t) agent.ability_index(procced->name()), dmg);
+            }
         }
 
         return { total_dmg, dmg_per_ability };
     }
-    Calculator::detailed_result_t Calculator::eval_detailed(const request_t& request) {
+    Calculator::detailed_result_t Calculator::eval_detailed(const request_t& request, std::vector<proc_t>* procs) {
         const auto& agent = request.agent->details();
         const auto& rotation = request.rotation->details();
 
         double total_dmg = 0.0;
-        std::vector<std::tuple<double, std::vector<Tag>, std::string>> info_per_ability;
+        std::vector<detailed_hit_t> info_per_ability;
+
+        static auto& stats_time = lib::stage_histogram("stats");
+        static auto& eval_time = lib::stage_histogram("eval");
 
+        lib::ScopedTimer stats_timer(stats_time);
         StatsGrid stats = details::calc_stats(request);
         stats.add(StatsGrid::make_defined_relative_stat(StatId::AtkTotal, Tag::Universal));
+        std::optional<AnomalyBuildup> buildup;
+        if (request.buildup_threshold.has_value()) {
+            stats.add(StatsGrid::make_defined_relative_stat(StatId::AmTotal, Tag::Universal));
+            buildup.emplace(*request.buildup_threshold);
+        }
+        details::FoldCache folds(stats);
+        stats_timer.stop();
+
+        lib::ScopedTimer eval_timer(eval_time);
 
         info_per_ability.reserve(rotation.size());
         for (size_t i = 0; i < rotation.size(); i++) {
-            auto cell = rotation[i];
-            const auto& ability = agent.ability(cell.command);
-            double dmg;
-            std::vector<Tag> tags;
+            lib::Deadline::check();
+            const auto& cell = rotation[i];
+            lib::TraceScope scope("cell", cell.command);
+            auto ability_index = (uint16_t) agent.ability_index(cell.command);
+            const auto& ability = agent.ability_at(ability_index);
+            const AnomalyDetails* procced = nullptr;
+            detailed_hit_t hit = { .ability = ability_index, .index = 0 };
 
             if (std::holds_alternative<SkillDetails>(ability)) {
                 const auto& skill = std::get<SkillDetails>(ability);
-                dmg = details::calc_regular_dmg(skill, cell.index - 1, stats, enemy);
-                tags = { skill.tags().begin(), skill.tags().end() };
+                hit.dmg = details::calc_regular_dmg(skill, cell.index - 1, folds.of(skill), enemy);
+                if (buildup.has_value())
+                    procced = details::add_buildup(*buildup, agent, skill, cell.index - 1, folds.of(skill));
+                hit.tags = skill.tags();
                 if (skill.max_index() > 1)
-                    cell.command += ' ' + std::to_string(cell.index);
+                    hit.index = (uint16_t) cell.index;
             } else if (std::holds_alternative<AnomalyDetails>(ability)) {
                 const auto& anomaly = std::get<AnomalyDetails>(ability);
-                dmg = details::calc_anomaly_dmg(anomaly, agent.element(), stats, enemy);
-                tags.emplace_back(Tag::Anomaly);
+                // buildup procs anomalies by itself, listed ones would be counted twice
+                hit.dmg = buildup.has_value() ? 0.0 : details::calc_anomaly_dmg(anomaly, agent.element(), folds.of(anomaly), enemy);
+                hit.tags = Tag::Anomaly;
             } else
                 throw RUNTIME_ERROR("ability is neither skill nor anomaly");
 
-            total_dmg += dmg;
-            info_per_ability.emplace_back(dmg, tags, std::move(cell.command));
+            total_dmg += hit.dmg;
+            info_per_ability.emplace_back(hit);
+
+            if (procced != nullptr) {
+                double dmg = details::calc_anomaly_dmg(*procced, agent.element(), folds.of(*procced), enemy);
+                total_dmg += dmg;
+                if (procs != nullptr)
+                    procs->emplace_back(i, (uint16_t) agent.ability_index(procced->name()), dmg);
+            }
         }
 
         return { total_dmg, info_per_ability };
     }
+
+    std::vector<Calculator::result_t> Calculator::eval_batch(std::span<const request_t> requests) {
+        if (requests.empty())
+            return {};
+
+        const auto& agent = requests.front().agent->details();
+        const auto& rotation = requests.front().rotation->details();
+        size_t size = requests.size();
+
+        for (const auto& it : requests) {
+            if (it.agent.ptr != requests.front().agent.ptr || it.rotation.ptr != requests.front().rotation.ptr)
+                throw RUNTIME_ERROR("every request of batch has to share agent and rotation");
+            if (it.buildup_threshold.has_value())
+                throw RUNTIME_ERROR("anomaly buildup is supported only by eval and eval_detailed");
+        }
+
+        std::vector<StatsGrid> stats;
+        stats.reserve(size);
+        for (const auto& it : requests) {
+            auto& grid = stats.emplace_back(details::calc_stats(it));
+            grid.add(StatsGrid::make_defined_relative_stat(StatId::AtkTotal, Tag::Universal));
+        }
+
+        std::vector<result_t> result(size);
+        for (auto& [total_dmg, dmg_per_ability] : result) {
+            total_dmg = 0.0;
+            dmg_per_ability.reserve(rotation.size());
+        }
+
+        batch::Columns columns(size);
+        std::vector<double> dmg(size);
+
+        for (size_t i = 0; i < rotation.size(); i++) {
+            lib::Deadline::check();
+            const auto& cell = rotation[i];
+            const auto& ability = agent.ability(cell.command);
+            batch::cell_consts_t consts;
+
+            if (std::holds_alternative<SkillDetails>(ability)) {
+                const auto& skill = std::get<SkillDetails>(ability);
+                consts = batch::make_regular_consts(skill, cell.index - 1, enemy);
+                for (size_t j = 0; j < size; j++)
+                    columns.set_regular(j, stats[j], skill, cell.index - 1);
+            } else if (std::holds_alternative<AnomalyDetails>(ability)) {
+                const auto& anomaly = std::get<AnomalyDetails>(ability);
+                consts = batch::make_anomaly_consts(anomaly, enemy);
+                for (size_t j = 0; j < size; j++)
+                    columns.set_anomaly(j, stats[j], anomaly);
+            } else
+                throw RUNTIME_ERROR("ability is neither skill nor anomaly");
+
+            batch::eval(consts, columns, dmg);
+
+            for (size_t j = 0; j < size; j++) {
+                auto& [total_dmg, dmg_per_ability] = result[j];
+                total_dmg += dmg[j];
+                dmg_per_ability.emplace_back(dmg[j]);
+            }
+        }
+
+        return result;
+    }
+
+    std::vector<Calculator::result_t> Calculator::eval_enemies(const request_t& request, std::span<const enemy_t> enemies) {
+        if (request.buildup_threshold.has_value())
+            throw RUNTIME_ERROR("anomaly buildup is supported only by eval and eval_detailed");
+
+        const auto& agent = request.agent->details();
+        const auto& rotation = request.rotation->details();
+        size_t size = enemies.size();
+
+        StatsGrid stats = details::calc_stats(request);
+        stats.add(StatsGrid::make_defined_relative_stat(StatId::AtkTotal, Tag::Universal));
+
+        std::vector<result_t> result(size);
+        for (auto& [total_dmg, dmg_per_ability] : result) {
+            total_dmg = 0.0;
+            dmg_per_ability.reserve(rotation.size());
+        }
+
+        details::FoldCache folds(stats);
+        batch::Columns columns(1);
+        batch::Enemies enemy_columns(enemies);
+        std::vector<double> dmg(size);
+
+        for (size_t i = 0; i < rotation.size(); i++) {
+            lib::Deadline::check();
+            const auto& cell = rotation[i];
+            const auto& ability = agent.ability(cell.command);
+            double scale;
+            Element element;
+
+            if (std::holds_alternative<SkillDetails>(ability)) {
+                const auto& skill = std::get<SkillDetails>(ability);
+                const auto& skill_scale = skill.scales()[cell.index - 1];
+                scale = skill_scale.motion_value / 100;
+                element = skill_scale.element;
+                columns.set_regular(0, folds.of(skill), skill, cell.index - 1);
+            } else if (std::holds_alternative<AnomalyDetails>(ability)) {
+                const auto& anomaly = std::get<AnomalyDetails>(ability);
+                scale = anomaly.scale() / 100;
+                element = anomaly.element();
+                columns.set_anomaly(0, folds.of(anomaly), anomaly);
+            } else
+                throw RUNTIME_ERROR("ability is neither skill nor anomaly");
+
+            batch::eval_enemies(scale, element, columns.row(0), enemy_columns, dmg);
+
+            for (size_t j = 0; j < size; j++) {
+                auto& [total_dmg, dmg_per_ability] = result[j];
+                total_dmg += dmg[j];
+                dmg_per_ability.emplace_back(dmg[j]);
+            }
+        }
+
+        return result;
+    }
+
+    Distribution Calculator::eval_distribution(const request_t& request) {
+        if (request.buildup_threshold.has_value())
+            throw RUNTIME_ERROR("anomaly buildup is supported only by eval and eval_detailed");
+
+        const auto& agent = request.agent->details();
+        const auto& rotation = request.rotation->details();
+
+        StatsGrid stats = details::calc_stats(request);
+        stats.add(StatsGrid::make_defined_relative_stat(StatId::AtkTotal, Tag::Universal));
+
+        details::FoldCache folds(stats);
+        batch::Columns columns(1);
+        std::vector<hit_t> hits;
+        hits.reserve(rotation.size());
+
+        for (size_t i = 0; i < rotation.size(); i++) {
+            lib::Deadline::check();
+            const auto& cell = rotation[i];
+            const auto& ability = agent.ability(cell.command);
+            batch::cell_consts_t consts;
+
+            if (std::holds_alternative<SkillDetails>(ability)) {
+                const auto& skill = std::get<SkillDetails>(ability);
+                consts = batch::make_regular_consts(skill, cell.index - 1, enemy);
+                columns.set_regular(0, folds.of(skill), skill, cell.index - 1);
+            } else if (std::holds_alternative<AnomalyDetails>(ability)) {
+                const auto& anomaly = std::get<AnomalyDetails>(ability);
+                consts = batch::make_anomaly_consts(anomaly, enemy);
+                columns.set_anomaly(0, folds.of(anomaly), anomaly);
+            } else
+                throw RUNTIME_ERROR("ability is neither skill nor anomaly");
+
+            // the same formula with crit rate 0 and 1 gives both outcomes of hit
+            auto row = columns.row(0);
+            double crit_rate = std::clamp(row[batch::CritRate], 0.0, 1.0);
+
+            row[batch::CritRate] = 0.0;
+            double normal = batch::eval_row(consts, row);
+            row[batch::CritRate] = 1.0;
+            double crit = batch::eval_row(consts, row);
+
+            hits.emplace_back(hit_t { .normal = normal, .crit = crit, .crit_rate = crit_rate });
+        }
+
+        return Distribution(std::move(hits));
+    }
 }
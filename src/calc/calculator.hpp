@@ -1,10 +1,12 @@
 #pragma once
 
 //std
+#include <span>
 #include <vector>
 
 //calculator
 #include "calc/details.hpp"
+#include "calc/distribution.hpp"
 
 #ifdef DEBUG_STATUS
 #include "tabulate/table.hpp"
@@ -13,16 +15,40 @@
 namespace calc {
     class Calculator {
     public:
+        // hit of eval_detailed, its name is agent.ability_name(ability)
+        struct detailed_hit_t {
+            double dmg;
+            zzz::TagMask tags;
+            uint16_t ability;
+            // index of scale as in rotation, 0 if skill has only one scale or ability is anomaly
+            uint16_t index;
+        };
+
+        // anomaly procced by buildup right after hit of rotation cell
+        struct proc_t {
+            size_t cell;
+            uint16_t ability;
+            double dmg;
+        };
+
         using result_t = std::tuple<double, std::vector<double>>;
-        using detailed_result_t = std::tuple<
-            double,
-            std::vector<std::tuple<double, std::vector<zzz::Tag>, std::string>>
-        >;
+        using detailed_result_t = std::tuple<double, std::vector<detailed_hit_t>>;
 
         static const enemy_t enemy;
 
-        static result_t eval(const request_t& request);
-        static detailed_result_t eval_detailed(const request_t& request);
+        // per_ability has one value per rotation cell. with anomaly buildup, anomaly cells of rotation
+        // are skipped with 0 damage since buildup procs anomalies itself, procs are added to total
+        // and written to procs when it's given
+        static result_t eval(const request_t& request, std::vector<proc_t>* procs = nullptr);
+        static detailed_result_t eval_detailed(const request_t& request, std::vector<proc_t>* procs = nullptr);
+        // same as eval for every request, requests have to share agent and rotation.
+        // damage formula is computed for all builds at once with simd, results are bit identical to eval
+        static std::vector<result_t> eval_batch(std::span<const request_t> requests);
+        // damage of every hit without and with crit, crit rate is clamped into [0, 1]
+        static Distribution eval_distribution(const request_t& request);
+        // same as eval against every enemy in one rotation pass, stats of every cell are looked up once
+        // and only enemy multipliers are computed per enemy with simd, results are bit identical to eval
+        static std::vector<result_t> eval_enemies(const request_t& request, std::span<const enemy_t> enemies);
 
 #ifdef DEBUG_STATUS
         // TODO
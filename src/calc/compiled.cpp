@@ -0,0 +1,329 @@
+#include "calc/compiled.hpp"
+
+//std
+#include <algorithm>
+#include <map>
+#include <string>
+#include <utility>
+
+//lib
+#include "library/format.hpp"
+
+using namespace zzz;
+using enum lib::rpn_parser::TokenType;
+
+namespace calc {
+    CompiledRotation::CompiledRotation(const request_t& request, const enemy_t& enemy) {
+        const auto& agent = request.agent->details();
+        const auto& rotation = request.rotation->details();
+
+        // same as details::calc_stats, but without discs
+        StatsGrid stats;
+        stats.add(agent.stats());
+        stats.add(request.wengine->details().stats());
+        for (const auto& [count, value] : request.dds_by_count) {
+            const auto& dds = value->details();
+
+            if (count == 2)
+                stats.add(dds.pc2());
+            else if (count == 4)
+                stats.add(dds.pc4());
+        }
+        for (const auto& it : request.teammates)
+            stats.add(it->details().team_buffs());
+        stats.add(StatsGrid::make_defined_relative_stat(StatId::AtkTotal, Tag::Universal));
+
+        // damage of cell depends only on command and index, so repeated cells are counted once
+        std::map<std::pair<std::string, uint64_t>, size_t> positions;
+
+        for (const auto& it : rotation.cells()) {
+            auto [pos, is_new] = positions.emplace(std::pair(it.command, it.index), m_cells.size());
+            m_positions.emplace_back(pos->second);
+            if (!is_new) {
+                m_cells[pos->second].count += 1.0;
+                continue;
+            }
+
+            auto& cell = m_cells.emplace_back();
+            cell.count = 1.0;
+
+            const auto& ability = agent.ability(it.command);
+            if (std::holds_alternative<SkillDetails>(ability)) {
+                const auto& skill = std::get<SkillDetails>(ability);
+                cell.consts = batch::make_regular_consts(skill, it.index - 1, enemy);
+                _compile_regular(cell, stats, skill, it.index - 1);
+            } else if (std::holds_alternative<AnomalyDetails>(ability)) {
+                const auto& anomaly = std::get<AnomalyDetails>(ability);
+                cell.consts = batch::make_anomaly_consts(anomaly, enemy);
+                _compile_anomaly(cell, stats, anomaly);
+            } else
+                throw RUNTIME_ERROR("ability is neither skill nor anomaly");
+
+            _collect_dependencies(cell);
+        }
+    }
+
+    // getters
+
+    std::span<const StatId> CompiledRotation::inputs() const { return m_inputs; }
+    size_t CompiledRotation::distinct_cells() const { return m_cells.size(); }
+    std::span<const size_t> CompiledRotation::positions() const { return m_positions; }
+    std::span<const int32_t> CompiledRotation::dependencies(size_t cell) const { return m_cells.at(cell).dependencies; }
+
+    size_t CompiledRotation::memory_usage() const {
+        size_t result = sizeof(CompiledRotation)
+            + m_inputs.capacity() * sizeof(StatId)
+            + m_positions.capacity() * sizeof(size_t);
+
+        for (const auto& cell : m_cells) {
+            result += sizeof(cell_t) + cell.dependencies.capacity() * sizeof(int32_t);
+            for (const auto& term : cell.terms) {
+                for (const auto& relative : term.relatives)
+                    result += _memory_usage(relative);
+            }
+        }
+
+        return result;
+    }
+
+    size_t CompiledRotation::_memory_usage(const relative_t& relative) {
+        size_t result = sizeof(relative_t)
+            + relative.program.capacity() * sizeof(lib::rpn_op_t)
+            + relative.variables.capacity() * sizeof(variable_t);
+
+        for (const auto& nested : relative.nested)
+            result += _memory_usage(nested);
+
+        return result;
+    }
+
+    std::vector<double> CompiledRotation::totals(std::span<const Ddp> ddps) const {
+        std::vector<double> result(m_inputs.size(), 0.0);
+
+        for (const auto& ddp : ddps) {
+            for (size_t i = 0; i < m_inputs.size(); i++)
+                result[i] += ddp.stats().get_value({ .id = m_inputs[i], .tag = Tag::Universal });
+        }
+
+        return result;
+    }
+
+    // evaluation
+
+    double CompiledRotation::eval(std::span<const double> totals) const {
+        return eval_batch(totals).front();
+    }
+    std::vector<double> CompiledRotation::eval_batch(std::span<const double> totals) const {
+        size_t width = m_inputs.size();
+        if (width == 0 || totals.empty() || totals.size() % width != 0)
+            throw FMT_RUNTIME_ERROR("totals size {} doesn't match {} inputs", totals.size(), width);
+
+        size_t size = totals.size() / width;
+        std::vector<double> result(size, 0.0), dmg(size), stack;
+        batch::Columns columns(size);
+
+        for (const auto& cell : m_cells) {
+            for (size_t j = 0; j < size; j++)
+                columns.set_row(j, _eval_row(cell, totals.subspan(j * width, width), stack));
+
+            batch::eval(cell.consts, columns, dmg);
+
+            for (size_t j = 0; j < size; j++)
+                result[j] += cell.count * dmg[j];
+        }
+
+        return result;
+    }
+    double CompiledRotation::eval_cell(size_t cell, std::span<const double> totals) const {
+        if (totals.size() != m_inputs.size())
+            throw FMT_RUNTIME_ERROR("totals size {} doesn't match {} inputs", totals.size(), m_inputs.size());
+
+        std::vector<double> stack;
+        const auto& it = m_cells.at(cell);
+
+        return batch::eval_row(it.consts, _eval_row(it, totals, stack));
+    }
+
+    // compilation
+
+    int32_t CompiledRotation::_input(StatId id) {
+        auto it = std::ranges::find(m_inputs, id);
+        if (it != m_inputs.end())
+            return (int32_t) (it - m_inputs.begin());
+
+        m_inputs.emplace_back(id);
+        return (int32_t) m_inputs.size() - 1;
+    }
+
+    void CompiledRotation::_compile_regular(cell_t& cell, StatsGrid stats, const SkillDetails& skill, size_t index) {
+        const auto& scale = skill.scales()[index];
+        auto tags = skill.tags();
+        auto& t = cell.terms;
+
+        stats.add(skill.buffs());
+
+        _add_to_term(t[batch::AtkTotal], stats, { .id = StatId::AtkTotal, .tag = Tag::Universal });
+        _add_to_term(t[batch::CritRate], stats, StatId::CritRate, tags);
+        _add_to_term(t[batch::CritDmg], stats, StatId::CritDmg, tags);
+        _add_to_term(t[batch::DmgRatio], stats, StatId::DmgRatio, tags);
+        _add_to_term(t[batch::DmgRatioElement], stats, StatId::DmgRatio + scale.element, tags);
+        _add_to_term(t[batch::Vulnerability], stats, StatId::Vulnerability, tags);
+        _add_to_term(t[batch::DefPenRatio], stats, StatId::DefPenRatio, tags);
+        _add_to_term(t[batch::DefPenFlat], stats, StatId::DefPenFlat, tags);
+        _add_to_term(t[batch::ResPen], stats, StatId::ResPen, tags);
+        _add_to_term(t[batch::ResPenElement], stats, StatId::ResPen + scale.element, tags);
+    }
+    void CompiledRotation::_compile_anomaly(cell_t& cell, StatsGrid stats, const AnomalyDetails& anomaly) {
+        static constexpr TagMask default_anomaly_tag = Tag::Anomaly;
+        auto& t = cell.terms;
+
+        stats.add(anomaly.buffs());
+
+        _add_to_term(t[batch::AtkTotal], stats, { .id = StatId::AtkTotal, .tag = Tag::Universal });
+        if (anomaly.can_crit()) {
+            _add_to_term(t[batch::CritRate], stats, { .id = StatId::CritRate, .tag = Tag::Anomaly });
+            _add_to_term(t[batch::CritDmg], stats, { .id = StatId::CritDmg, .tag = Tag::Anomaly });
+        }
+        _add_to_term(t[batch::DmgRatio], stats, { .id = StatId::DmgRatio, .tag = Tag::Universal });
+        _add_to_term(t[batch::DmgRatioElement], stats, { .id = StatId::DmgRatio + anomaly.element(), .tag = Tag::Universal });
+        _add_to_term(t[batch::AnomalyRatio], stats, { .id = StatId::DmgRatio, .tag = Tag::Anomaly });
+        _add_to_term(t[batch::AnomalyRatioElement], stats, { .id = StatId::DmgRatio + anomaly.element(), .tag = Tag::Universal });
+        _add_to_term(t[batch::Vulnerability], stats, StatId::Vulnerability, default_anomaly_tag);
+        _add_to_term(t[batch::DefPenRatio], stats, StatId::DefPenRatio, default_anomaly_tag);
+        _add_to_term(t[batch::DefPenFlat], stats, StatId::DefPenFlat, default_anomaly_tag);
+        _add_to_term(t[batch::ResPen], stats, StatId::ResPen, default_anomaly_tag);
+        _add_to_term(t[batch::ResPenElement], stats, StatId::ResPen + anomaly.element(), default_anomaly_tag);
+    }
+
+    void CompiledRotation::_collect_dependencies(cell_t& cell) {
+        auto& result = cell.dependencies;
+
+        for (const auto& term : cell.terms) {
+            if (term.input != -1)
+                result.emplace_back(term.input);
+
+            for (const auto& relative : term.relatives)
+                _collect_dependencies(result, relative);
+        }
+
+        std::ranges::sort(result);
+        auto [first, last] = std::ranges::unique(result);
+        result.erase(first, last);
+    }
+    void CompiledRotation::_collect_dependencies(std::vector<int32_t>& result, const relative_t& relative) {
+        for (const auto& variable : relative.variables)
+            result.emplace_back(variable.input);
+
+        for (const auto& nested : relative.nested)
+            _collect_dependencies(result, nested);
+    }
+
+    void CompiledRotation::_add_to_term(term_t& term, const StatsGrid& stats, qualifier_t key) {
+        // discs add to universal stats only, regular or relative alike
+        if (key.tag == Tag::Universal) {
+            if (term.input != -1)
+                throw RUNTIME_ERROR("term can't have two universal stats");
+            term.input = _input(key.id);
+        }
+
+        if (!stats.contains(key))
+            return;
+
+        const auto& stat = stats.at(key);
+        switch (stat.type()) {
+        case 1:
+            term.constant += stat.base();
+            break;
+
+        case 2: {
+            term.constant += stat.base();
+            term.relatives.emplace_back(_compile_program(stat.formulas()->program, stats));
+
+            break;
+        }
+
+        default:
+            throw RUNTIME_ERROR("wrong stat.type()");
+        }
+    }
+    void CompiledRotation::_add_to_term(term_t& term, const StatsGrid& stats, StatId id, TagMask tags) {
+        _add_to_term(term, stats, { .id = id, .tag = Tag::Universal });
+        for (const auto& tag : tags)
+            _add_to_term(term, stats, { .id = id, .tag = tag });
+    }
+
+    CompiledRotation::relative_t CompiledRotation::_compile_program(const lib::rpn_program_t& program, const StatsGrid& stats, size_t depth) {
+        // relative stats of game data nest once or twice, deeper chain is a cycle
+        static constexpr size_t max_depth = 8;
+
+        if (depth > max_depth)
+            throw RUNTIME_ERROR("relative stats reference each other in a cycle");
+
+        relative_t result = { .program = program };
+        size_t nested_registers = 0;
+
+        for (auto& op : result.program) {
+            if (op.type != Variable)
+                continue;
+
+            qualifier_t key = { .id = (StatId) (size_t) op.variable, .tag = Tag::Universal };
+            variable_t variable = { .number = 0.0, .input = _input(key.id) };
+
+            // value of nested relative stat mirrors Stat::value, base plus its own program
+            if (stats.contains(key) && stats.at(key).type() != 1) {
+                const auto& stat = stats.at(key);
+                auto& nested = result.nested.emplace_back(_compile_program(stat.formulas()->program, stats, depth + 1));
+
+                variable.number = stat.base();
+                variable.nested = (int32_t) result.nested.size() - 1;
+                nested_registers = std::max(nested_registers, nested.registers);
+            } else
+                variable.number = stats.get_value(key);
+
+            // CSE of formula compiler leaves one op per stat, so variables don't repeat
+            op.variable = (uint32_t) result.variables.size();
+            result.variables.emplace_back(variable);
+        }
+
+        result.registers = result.program.size() + nested_registers;
+        return result;
+    }
+
+    double CompiledRotation::_eval_program(const relative_t& relative, std::span<const double> totals, std::vector<double>& stack) {
+        if (stack.size() < relative.registers)
+            stack.resize(relative.registers);
+
+        return _eval_program(relative, totals, std::span(stack));
+    }
+    double CompiledRotation::_eval_program(const relative_t& relative, std::span<const double> totals, std::span<double> registers) {
+        auto nested_registers = registers.subspan(relative.program.size());
+
+        return lib::eval_program(relative.program, [&](uint32_t index) {
+            const auto& variable = relative.variables[index];
+            double result = variable.number + totals[variable.input];
+
+            if (variable.nested != -1)
+                result += _eval_program(relative.nested[variable.nested], totals, nested_registers);
+
+            return result;
+        }, registers);
+    }
+    double CompiledRotation::_eval_term(const term_t& term, std::span<const double> totals, std::vector<double>& stack) {
+        double result = term.constant;
+        if (term.input != -1)
+            result += totals[term.input];
+
+        // mirrors Stat::value of relative stat
+        for (const auto& relative : term.relatives)
+            result += _eval_program(relative, totals, stack);
+
+        return result;
+    }
+    batch::row_t CompiledRotation::_eval_row(const cell_t& cell, std::span<const double> totals, std::vector<double>& stack) {
+        batch::row_t result;
+        for (size_t i = 0; i < batch::ColumnCount; i++)
+            result[i] = _eval_term(cell.terms[i], totals, stack);
+
+        return result;
+    }
+}
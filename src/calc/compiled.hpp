@@ -0,0 +1,105 @@
+#pragma once
+
+//std
+#include <array>
+#include <span>
+#include <vector>
+
+//calculator
+#include "calc/batch.hpp"
+#include "calc/calculator.hpp"
+
+//zzz
+#include "zzz/stats/relative.hpp"
+
+namespace calc {
+    // damage of rotation reduced to function of summed disc stats.
+    // agent, wengine, dds and rotation are walked once: skill buffs, tags, motion values
+    // and enemy multipliers are folded into coefficient table, so build evaluation costs
+    // O(inputs + distinct cells) instead of grid copy per cell.
+    // discs only have universal regular stats, so they are plain additions to every term
+    class CompiledRotation {
+    public:
+        // ddps of request are ignored
+        explicit CompiledRotation(const request_t& request, const enemy_t& enemy = Calculator::enemy);
+
+        // stats which discs can affect, totals are laid out in this order
+        std::span<const zzz::StatId> inputs() const;
+        size_t distinct_cells() const;
+        // index of distinct cell for every cell of rotation
+        std::span<const size_t> positions() const;
+        // inputs which can change damage of distinct cell
+        std::span<const int32_t> dependencies(size_t cell) const;
+        // approximate size of coefficient table
+        size_t memory_usage() const;
+
+        // sums stats of discs into totals for eval
+        std::vector<double> totals(std::span<const zzz::Ddp> ddps) const;
+
+        double eval(std::span<const double> totals) const;
+        // totals of every build follow each other, result has one value per build
+        std::vector<double> eval_batch(std::span<const double> totals) const;
+        // damage of one hit of distinct cell
+        double eval_cell(size_t cell, std::span<const double> totals) const;
+
+    protected:
+        // variable of relative stat formula resolved to value of fixed grid plus optional input.
+        // variable which is relative stat itself adds its own program, indexed into nested
+        struct variable_t {
+            double number;
+            int32_t input = -1;
+            int32_t nested = -1;
+        };
+
+        // fused program of relative stat, its variables index into variables
+        struct relative_t {
+            lib::rpn_program_t program;
+            std::vector<variable_t> variables;
+            std::vector<relative_t> nested;
+            // registers of program and of every nested one evaluated after it
+            size_t registers = 0;
+        };
+
+        // constant + totals[input] + sum of relative formulas
+        struct term_t {
+            double constant = 0.0;
+            int32_t input = -1;
+            std::vector<relative_t> relatives;
+        };
+
+        struct cell_t {
+            // how many times cell appears in rotation
+            double count;
+            batch::cell_consts_t consts;
+            // indexed by batch::column_id
+            std::array<term_t, batch::ColumnCount> terms;
+            // sorted indices of inputs used by terms
+            std::vector<int32_t> dependencies;
+        };
+
+        std::vector<zzz::StatId> m_inputs;
+        std::vector<cell_t> m_cells;
+        // index of distinct cell for every cell of rotation
+        std::vector<size_t> m_positions;
+
+    private:
+        int32_t _input(zzz::StatId id);
+        static size_t _memory_usage(const relative_t& relative);
+
+        void _compile_regular(cell_t& cell, zzz::StatsGrid stats, const zzz::SkillDetails& skill, size_t index);
+        void _compile_anomaly(cell_t& cell, zzz::StatsGrid stats, const zzz::AnomalyDetails& anomaly);
+        static void _collect_dependencies(cell_t& cell);
+
+        // adds every stat of given qualifiers to term, mirrors StatsGrid::get_value
+        void _add_to_term(term_t& term, const zzz::StatsGrid& stats, zzz::qualifier_t key);
+        void _add_to_term(term_t& term, const zzz::StatsGrid& stats, zzz::StatId id, zzz::TagMask tags);
+        relative_t _compile_program(const lib::rpn_program_t& program, const zzz::StatsGrid& stats, size_t depth = 0);
+        static void _collect_dependencies(std::vector<int32_t>& result, const relative_t& relative);
+
+        // stack is used as registers of program, nested programs take registers after it
+        static double _eval_program(const relative_t& relative, std::span<const double> totals, std::vector<double>& stack);
+        static double _eval_program(const relative_t& relative, std::span<const double> totals, std::span<double> registers);
+        static double _eval_term(const term_t& term, std::span<const double> totals, std::vector<double>& stack);
+        static batch::row_t _eval_row(const cell_t& cell, std::span<const double> totals, std::vector<double>& stack);
+    };
+}
@@ -3,7 +3,11 @@
 //std
 #include <array>
 #include <map>
+#include <memory>
 #include <list>
+#include <optional>
+#include <span>
+#include <vector>
 
 //zzz
 #include "zzz/details.hpp"
@@ -11,7 +15,8 @@
 namespace calc {
     struct enemy_t {
         double dmg_reduction, defense, stun_mult;
-        std::array<double, 5> res;
+        // indexed by element, None isn't used
+        std::array<double, (size_t) zzz::Element::Count> res;
         bool is_stunned;
     };
 
@@ -36,5 +41,52 @@ namespace calc {
         std::list<cell_t<zzz::Dds>> dds_list;
 
         std::array<zzz::Ddp, 6> ddps = {};
+
+        // team_buffs of teammates are added to stats of agent
+        std::vector<cell_t<zzz::Agent>> teammates;
+        // damage is evaluated against each of them instead of default enemy
+        std::vector<cell_t<zzz::Enemy>> enemies;
+
+        // when set, skills build up anomalies and procs are added after triggering hits
+        std::optional<double> buildup_threshold;
     };
 }
+
+namespace calc::details {
+    constexpr double level_coefficient = 794.0;
+
+    // shared with batch and timeline evaluation, defined in calculator.cpp
+    double get_value(const zzz::StatsGrid& table, zzz::StatId id, zzz::TagMask tags);
+    double calc_stun_mult(const enemy_t& enemy);
+    enemy_t make_enemy(const zzz::EnemyDetails& details, bool is_stunned = false);
+
+    // agent, wengine, discs and dds bonuses summed
+    zzz::StatsGrid calc_stats(const request_t& request);
+
+    // folded stats of grid with buffs of every ability, each combination of buffs and tags is folded once.
+    // references stay valid while cache exists
+    class FoldCache {
+    public:
+        explicit FoldCache(const zzz::StatsGrid& stats);
+
+        const zzz::FoldedStats& of(const zzz::SkillDetails& skill);
+        const zzz::FoldedStats& of(const zzz::AnomalyDetails& anomaly);
+
+    private:
+        // buffs are nullptr when ability has none
+        using key_t = std::pair<const zzz::StatsGrid*, zzz::TagMask>;
+
+        const zzz::StatsGrid& _stats;
+        std::map<key_t, std::unique_ptr<zzz::FoldedStats>> _folds;
+
+        const zzz::FoldedStats& _fold(const zzz::StatsGrid& buffs, zzz::TagMask tags);
+    };
+
+    // anomaly procced by hit of skill or nullptr, stats have to be folded with buffs and tags of skill
+    const zzz::AnomalyDetails* add_buildup(
+        zzz::AnomalyBuildup& buildup,
+        const zzz::AgentDetails& agent,
+        const zzz::SkillDetails& skill,
+        size_t index,
+        const zzz::FoldedStats& stats);
+}
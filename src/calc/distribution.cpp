@@ -0,0 +1,243 @@
+#include "calc/distribution.hpp"
+
+//std
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <thread>
+
+//lib
+#include "library/deadline.hpp"
+#include "library/format.hpp"
+
+namespace calc::distribution_details {
+    constexpr size_t block_size = 256;
+
+    // counter based generator: splitmix64 finalizer of key and counter,
+    // any run can be computed without state of previous ones
+    inline uint64_t random_at(uint64_t key, uint64_t counter) {
+        uint64_t z = key + counter * 0x9e3779b97f4a7c15ull;
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        return z ^ (z >> 31);
+    }
+
+    // P. J. Acklam's rational approximation of inverse normal cdf, relative error is below 1.2e-9
+    double inverse_normal_cdf(double p) {
+        static constexpr std::array<double, 6> a = {
+            -3.969683028665376e+01, 2.209460984245205e+02, -2.759285104469687e+02,
+            1.383577518672690e+02, -3.066479806614716e+01, 2.506628277459239e+00
+        };
+        static constexpr std::array<double, 5> b = {
+            -5.447609879822406e+01, 1.615858368580409e+02, -1.556989798598866e+02,
+            6.680131188771972e+01, -1.328068155288572e+01
+        };
+        static constexpr std::array<double, 6> c = {
+            -7.784894002430293e-03, -3.223964580411365e-01, -2.400758277161838e+00,
+            -2.549732539343734e+00, 4.374664141464968e+00, 2.938163982698783e+00
+        };
+        static constexpr std::array<double, 4> d = {
+            7.784695709041462e-03, 3.224671290700398e-01, 2.445134137142996e+00, 3.754408661907416e+00
+        };
+        static constexpr double low = 0.02425;
+
+        if (p <= 0.0 || p >= 1.0)
+            throw FMT_RUNTIME_ERROR("quantile {} is out of (0, 1)", p);
+
+        if (p < low || p > 1.0 - low) {
+            double q = std::sqrt(-2 * std::log(p < low ? p : 1.0 - p));
+            double x = (((((c[0] * q + c[1]) * q + c[2]) * q + c[3]) * q + c[4]) * q + c[5])
+                / ((((d[0] * q + d[1]) * q + d[2]) * q + d[3]) * q + 1);
+            return p < low ? x : -x;
+        }
+
+        double q = p - 0.5, r = q * q;
+        return (((((a[0] * r + a[1]) * r + a[2]) * r + a[3]) * r + a[4]) * r + a[5]) * q
+            / (((((b[0] * r + b[1]) * r + b[2]) * r + b[3]) * r + b[4]) * r + 1);
+    }
+
+    // inner loop goes over runs of block, so it's vectorized by compiler.
+    // workers mustn't throw, so expired deadline only stops sampling
+    void sample_range(
+        std::span<const hit_t> hits,
+        std::span<const uint64_t> thresholds,
+        uint64_t key,
+        size_t from,
+        size_t to,
+        double* result,
+        const lib::Deadline* deadline) {
+        std::array<double, block_size> totals;
+
+        for (size_t start = from; start < to; start += block_size) {
+            if (deadline != nullptr && deadline->is_expired())
+                return;
+
+            size_t size = std::min(block_size, to - start);
+            std::fill_n(totals.begin(), size, 0.0);
+
+            for (size_t i = 0; i < hits.size(); i++) {
+                const auto& hit = hits[i];
+                uint64_t threshold = thresholds[i];
+
+                for (size_t j = 0; j < size; j++) {
+                    uint64_t counter = (uint64_t) (start + j) * hits.size() + i;
+                    bool is_crit = random_at(key, counter) >> 11 < threshold;
+                    totals[j] += is_crit ? hit.crit : hit.normal;
+                }
+            }
+
+            std::copy_n(totals.begin(), size, result + start);
+        }
+    }
+}
+
+namespace calc {
+    Distribution::Distribution(std::vector<hit_t> hits) :
+        m_hits(std::move(hits)) {
+        for (const auto& it : m_hits) {
+            auto hit = moments(it);
+
+            m_total.mean += hit.mean;
+            m_total.variance += hit.variance;
+            m_total.third += hit.third;
+            m_total.min += hit.min;
+            m_total.max += hit.max;
+        }
+
+        _enumerate_outcomes();
+    }
+
+    // getters
+
+    std::span<const hit_t> Distribution::hits() const { return m_hits; }
+    const moments_t& Distribution::total() const { return m_total; }
+    bool Distribution::is_exact() const { return !m_outcomes.empty(); }
+
+    // moments
+
+    moments_t Distribution::moments(const hit_t& hit) {
+        double p = hit.crit_rate, delta = hit.crit - hit.normal;
+        double bernoulli_variance = p * (1.0 - p);
+
+        return {
+            .mean = hit.normal + p * delta,
+            .variance = delta * delta * bernoulli_variance,
+            .third = delta * delta * delta * bernoulli_variance * (1.0 - 2.0 * p),
+            .min = std::min(hit.normal, hit.crit),
+            .max = std::max(hit.normal, hit.crit)
+        };
+    }
+
+    double Distribution::percentile(double q) const {
+        if (!m_outcomes.empty()) {
+            auto it = std::ranges::lower_bound(m_outcomes, q, {}, &std::pair<double, double>::second);
+            return it != m_outcomes.end() ? it->first : m_outcomes.back().first;
+        }
+
+        if (m_total.variance <= 0.0)
+            return m_total.mean;
+
+        double z = distribution_details::inverse_normal_cdf(q);
+        double sigma = std::sqrt(m_total.variance);
+        double skewness = m_total.third / (m_total.variance * sigma);
+        double w = z + (z * z - 1.0) * skewness / 6.0;
+
+        return std::clamp(m_total.mean + sigma * w, m_total.min, m_total.max);
+    }
+
+    void Distribution::_enumerate_outcomes() {
+        double fixed = 0.0;
+        std::vector<const hit_t*> random;
+
+        for (const auto& it : m_hits) {
+            if (it.crit_rate <= 0.0 || it.crit_rate >= 1.0 || it.crit == it.normal)
+                fixed += moments(it).mean;
+            else
+                random.emplace_back(&it);
+        }
+
+        if (random.size() > max_enumerated_hits)
+            return;
+
+        // bit i of mask tells whether random hit i crits
+        size_t count = 1ull << random.size();
+        m_outcomes.reserve(count);
+        for (size_t mask = 0; mask < count; mask++) {
+            if (mask % 4096 == 0)
+                lib::Deadline::check();
+
+            double total = fixed, probability = 1.0;
+
+            for (size_t i = 0; i < random.size(); i++) {
+                bool is_crit = (mask >> i) & 1;
+                total += is_crit ? random[i]->crit : random[i]->normal;
+                probability *= is_crit ? random[i]->crit_rate : 1.0 - random[i]->crit_rate;
+            }
+
+            m_outcomes.emplace_back(total, probability);
+        }
+
+        std::ranges::sort(m_outcomes);
+
+        double cumulative = 0.0;
+        for (auto& [total, probability] : m_outcomes) {
+            cumulative += probability;
+            probability = cumulative;
+        }
+    }
+
+    // sampling
+
+    std::vector<double> Distribution::sample(size_t count, uint64_t seed, size_t threads) const {
+        if (count == 0 || count > max_samples)
+            throw FMT_RUNTIME_ERROR("amount of samples has to be in [1, {}], got {}", max_samples, count);
+
+        std::vector<uint64_t> thresholds;
+        thresholds.reserve(m_hits.size());
+        for (const auto& it : m_hits)
+            thresholds.emplace_back((uint64_t) std::ldexp(std::clamp(it.crit_rate, 0.0, 1.0), 53));
+
+        size_t blocks = (count + distribution_details::block_size - 1) / distribution_details::block_size;
+        if (threads == 0)
+            threads = std::max(std::thread::hardware_concurrency(), 1u);
+        threads = std::min({ threads, max_threads, blocks });
+
+        std::vector<double> result(count);
+        std::vector<std::thread> workers;
+        workers.reserve(threads);
+
+        // whole blocks per thread
+        size_t per_thread = (blocks + threads - 1) / threads * distribution_details::block_size;
+        for (size_t from = 0; from < count; from += per_thread) {
+            workers.emplace_back(distribution_details::sample_range,
+                std::span<const hit_t>(m_hits), std::span<const uint64_t>(thresholds),
+                seed, from, std::min(from + per_thread, count), result.data(), lib::Deadline::current());
+        }
+        for (auto& it : workers)
+            it.join();
+        lib::Deadline::check();
+
+        std::ranges::sort(result);
+        return result;
+    }
+
+    std::atomic_size_t Distribution::_request_samples_limit = 100'000;
+
+    void Distribution::set_request_samples_limit(size_t limit) {
+        _request_samples_limit.store(std::min(limit, max_samples), std::memory_order_relaxed);
+    }
+    size_t Distribution::request_samples_limit() {
+        return _request_samples_limit.load(std::memory_order_relaxed);
+    }
+
+    double Distribution::percentile(std::span<const double> sorted, double q) {
+        if (sorted.empty())
+            throw RUNTIME_ERROR("there are no samples");
+
+        double position = std::clamp(q, 0.0, 1.0) * (double) (sorted.size() - 1);
+        size_t lower = (size_t) position;
+        size_t upper = std::min(lower + 1, sorted.size() - 1);
+
+        return sorted[lower] + (sorted[upper] - sorted[lower]) * (position - (double) lower);
+    }
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+//std
+#include <atomic>
+#include <cstdint>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace calc {
+    // one hit of rotation, crits with probability crit_rate independently of other hits
+    struct hit_t {
+        double normal, crit;
+        // already clamped into [0, 1]
+        double crit_rate;
+    };
+
+    struct moments_t {
+        double mean = 0.0;
+        double variance = 0.0;
+        // third central moment, cumulants of independent hits are summed as well
+        double third = 0.0;
+        // no hit crits / every hit crits
+        double min = 0.0, max = 0.0;
+    };
+
+    // exact moments of damage distribution and percentile estimates from them.
+    // when only few hits can crit, all their outcomes are enumerated and percentiles are exact.
+    // sampling is there for checking estimates and for cases which aren't independent
+    class Distribution {
+    public:
+        static constexpr size_t max_samples = 1'000'000;
+        // threads of one sample call, amount of sampling requests is already bounded by admission control
+        static constexpr size_t max_threads = 4;
+        // 2^n outcomes are enumerated up to this amount of random hits
+        static constexpr size_t max_enumerated_hits = 16;
+
+        explicit Distribution(std::vector<hit_t> hits);
+
+        std::span<const hit_t> hits() const;
+        const moments_t& total() const;
+
+        static moments_t moments(const hit_t& hit);
+
+        bool is_exact() const;
+        // exact for enumerated outcomes, otherwise Cornish-Fisher expansion
+        // of normal quantile with skewness correction, clamped into [min, max]
+        double percentile(double q) const;
+
+        // sorted totals of rotation for count simulated runs, deterministic for given seed.
+        // hit i of run j uses counter (j, i), so result doesn't depend on amount of threads
+        // threads are capped by max_threads, 0 means hardware concurrency
+        std::vector<double> sample(size_t count, uint64_t seed, size_t threads = 0) const;
+        // percentile of sorted samples with linear interpolation
+        static double percentile(std::span<const double> sorted, double q);
+
+        // samples which one request may ask for, at most max_samples
+        static void set_request_samples_limit(size_t limit);
+        static size_t request_samples_limit();
+
+    protected:
+        std::vector<hit_t> m_hits;
+        moments_t m_total;
+        // sorted totals with cumulative probability, empty if there are too many random hits
+        std::vector<std::pair<double, double>> m_outcomes;
+
+    private:
+        static std::atomic_size_t _request_samples_limit;
+
+        void _enumerate_outcomes();
+    };
+}
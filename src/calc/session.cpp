@@ -0,0 +1,238 @@
+#include "calc/session.hpp"
+
+//std
+#include <algorithm>
+#include <span>
+#include <utility>
+
+//lib
+#include "library/format.hpp"
+
+using namespace zzz;
+
+namespace calc {
+    Session::Session(request_t request) :
+        m_request(std::move(request)) {
+        if (m_request.buildup_threshold.has_value())
+            throw RUNTIME_ERROR("anomaly buildup is supported only by eval and eval_detailed");
+
+        for (const auto& it : m_request.dds_list) {
+            if (it.ptr != nullptr)
+                m_known_dds[it.id] = it.ptr;
+        }
+
+        m_bonuses = _count_bonuses(_ddps());
+        _compose_dds(m_bonuses, {});
+        _commit(_rebuild());
+    }
+
+    // getters
+
+    const Calculator::result_t& Session::result() const { return m_result; }
+    size_t Session::recomputed() const { return m_recomputed; }
+
+    size_t Session::memory_usage() const {
+        size_t result = sizeof(Session)
+            + m_known_dds.size() * sizeof(std::pair<uint64_t, DdsPtr>)
+            + m_totals.capacity() * sizeof(double)
+            + m_cell_dmg.capacity() * sizeof(double)
+            + std::get<1>(m_result).capacity() * sizeof(double);
+
+        for (const auto& it : m_disc_totals)
+            result += it.capacity() * sizeof(double);
+        if (m_compiled.has_value())
+            result += m_compiled->memory_usage();
+
+        return result;
+    }
+
+    // changes
+
+    void Session::update(std::optional<cell_t<Wengine>> wengine, std::vector<disc_change_t> discs) {
+        if (wengine.has_value() && wengine->ptr == nullptr)
+            throw FMT_RUNTIME_ERROR("wengine {} isn't loaded", wengine->id);
+
+        auto ddps = _ddps();
+        for (const auto& it : discs) {
+            if (it.slot >= ddps.size())
+                throw FMT_RUNTIME_ERROR("disc slot {} is out of range", it.slot);
+
+            ddps[it.slot] = &it.ddp;
+        }
+
+        auto bonuses = _count_bonuses(ddps);
+        std::map<uint64_t, DdsPtr> added;
+
+        for (const auto& [id, count] : bonuses) {
+            if (m_known_dds.contains(id))
+                continue;
+
+            auto it = std::ranges::find_if(discs, [id](const disc_change_t& disc) {
+                return disc.dds.id == id && disc.dds.ptr != nullptr;
+            });
+            if (it == discs.end())
+                throw FMT_RUNTIME_ERROR("dds {} isn't loaded", id);
+
+            added.emplace(id, it->dds.ptr);
+        }
+
+        derived_t derived;
+
+        // other wengine or set bonuses change stats of every cell
+        if (wengine.has_value() || bonuses != m_bonuses) {
+            auto previous_wengine = m_request.wengine;
+            auto previous_ddps = m_request.ddps;
+            // nodes are moved, so references of dds_by_count stay valid
+            auto previous_dds_list = std::move(m_request.dds_list);
+            auto previous_dds_by_count = std::move(m_request.dds_by_count);
+
+            try {
+                if (wengine.has_value())
+                    m_request.wengine = *wengine;
+                for (auto& it : discs)
+                    m_request.ddps[it.slot] = std::move(it.ddp);
+
+                _compose_dds(bonuses, added);
+                derived = _rebuild();
+            } catch (...) {
+                m_request.wengine = std::move(previous_wengine);
+                m_request.ddps = std::move(previous_ddps);
+                m_request.dds_list = std::move(previous_dds_list);
+                m_request.dds_by_count = std::move(previous_dds_by_count);
+                throw;
+            }
+        } else {
+            derived = _recompute(ddps);
+
+            for (auto& it : discs)
+                m_request.ddps[it.slot] = std::move(it.ddp);
+        }
+
+        m_known_dds.merge(added);
+        m_bonuses = std::move(bonuses);
+        _commit(std::move(derived));
+    }
+
+    // internal
+
+    std::map<uint64_t, size_t> Session::_count_bonuses(std::span<const Ddp* const> ddps) {
+        std::map<uint64_t, size_t> counts, result;
+
+        // same rules as details::prepare_request_details, empty slots have id 0
+        for (const auto* it : ddps) {
+            if (it->disc_id() != 0)
+                counts[it->disc_id()]++;
+        }
+
+        for (const auto& [id, count] : counts) {
+            if (count >= 4)
+                result[id] = 4;
+            else if (count >= 2)
+                result[id] = 2;
+        }
+
+        return result;
+    }
+    std::array<const Ddp*, 6> Session::_ddps() const {
+        std::array<const Ddp*, 6> result;
+
+        for (size_t i = 0; i < result.size(); i++)
+            result[i] = &m_request.ddps[i];
+
+        return result;
+    }
+    void Session::_compose_dds(const std::map<uint64_t, size_t>& bonuses, const std::map<uint64_t, DdsPtr>& added) {
+        m_request.dds_by_count.clear();
+        m_request.dds_list.clear();
+
+        for (const auto& [id, count] : bonuses) {
+            auto it = m_known_dds.find(id);
+            const auto& ptr = it != m_known_dds.end() ? it->second : added.at(id);
+
+            auto& val = m_request.dds_list.emplace_back(id, ptr);
+            m_request.dds_by_count.emplace(2, val.ptr);
+
+            if (count == 4)
+                m_request.dds_by_count.emplace(4, val.ptr);
+        }
+    }
+
+    Session::derived_t Session::_rebuild() const {
+        derived_t result;
+        const auto& compiled = result.compiled.emplace(m_request);
+
+        for (size_t i = 0; i < m_request.ddps.size(); i++)
+            result.disc_totals[i] = compiled.totals(std::span(&m_request.ddps[i], 1));
+        result.totals = _sum_totals(result.disc_totals, compiled.inputs().size());
+
+        result.cell_dmg.resize(compiled.distinct_cells());
+        for (size_t i = 0; i < result.cell_dmg.size(); i++)
+            result.cell_dmg[i] = compiled.eval_cell(i, result.totals);
+        result.recomputed = result.cell_dmg.size();
+
+        result.result = _collect_result(compiled, result.cell_dmg);
+        return result;
+    }
+    Session::derived_t Session::_recompute(std::span<const Ddp* const> ddps) const {
+        derived_t result;
+
+        result.disc_totals = m_disc_totals;
+        for (size_t i = 0; i < ddps.size(); i++) {
+            if (ddps[i] != &m_request.ddps[i])
+                result.disc_totals[i] = m_compiled->totals(std::span(ddps[i], 1));
+        }
+        result.totals = _sum_totals(result.disc_totals, m_compiled->inputs().size());
+
+        result.cell_dmg = m_cell_dmg;
+        for (size_t i = 0; i < result.cell_dmg.size(); i++) {
+            auto dependencies = m_compiled->dependencies(i);
+            bool is_affected = std::ranges::any_of(dependencies, [&](int32_t input) {
+                return result.totals[input] != m_totals[input];
+            });
+
+            if (is_affected) {
+                result.cell_dmg[i] = m_compiled->eval_cell(i, result.totals);
+                result.recomputed++;
+            }
+        }
+
+        result.result = _collect_result(*m_compiled, result.cell_dmg);
+        return result;
+    }
+    void Session::_commit(derived_t derived) {
+        if (derived.compiled.has_value())
+            m_compiled = std::move(derived.compiled);
+
+        m_disc_totals = std::move(derived.disc_totals);
+        m_totals = std::move(derived.totals);
+        m_cell_dmg = std::move(derived.cell_dmg);
+        m_result = std::move(derived.result);
+        m_recomputed = derived.recomputed;
+    }
+
+    std::vector<double> Session::_sum_totals(const std::array<std::vector<double>, 6>& disc_totals, size_t width) {
+        std::vector<double> result(width, 0.0);
+
+        // same order as CompiledRotation::totals for all discs at once
+        for (const auto& disc : disc_totals) {
+            for (size_t i = 0; i < result.size(); i++)
+                result[i] += disc[i];
+        }
+
+        return result;
+    }
+    Calculator::result_t Session::_collect_result(const CompiledRotation& compiled, std::span<const double> cell_dmg) {
+        Calculator::result_t result;
+        auto& [total_dmg, dmg_per_ability] = result;
+        auto positions = compiled.positions();
+
+        total_dmg = 0.0;
+        dmg_per_ability.resize(positions.size());
+        for (size_t i = 0; i < positions.size(); i++) {
+            dmg_per_ability[i] = cell_dmg[positions[i]];
+            total_dmg += dmg_per_ability[i];
+        }
+
+        return result;
+    }
+}
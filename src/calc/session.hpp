@@ -0,0 +1,85 @@
+#pragma once
+
+//std
+#include <array>
+#include <map>
+#include <optional>
+#include <span>
+#include <vector>
+
+//calculator
+#include "calc/calculator.hpp"
+#include "calc/compiled.hpp"
+
+namespace calc {
+    // evaluation state of one interactive client.
+    // keeps rotation compiled for current agent, wengine and dds set, stat totals of every disc
+    // and damage of every distinct cell. replacing discs recomputes only cells which depend on
+    // changed stats, while wengine or dds set change recompiles rotation.
+    // results agree with Calculator::eval up to summation order
+    class Session {
+    public:
+        // replacement of disc in slot, dds becomes known to session when its set bonus is used
+        struct disc_change_t {
+            size_t slot;
+            cell_t<zzz::Dds> dds;
+            zzz::Ddp ddp;
+        };
+
+        // request has to be composed, its dds become known to session
+        explicit Session(request_t request);
+
+        const Calculator::result_t& result() const;
+        // distinct cells recomputed by last change
+        size_t recomputed() const;
+        size_t memory_usage() const;
+
+        // applies all changes at once, session stays as it was if any of them fails.
+        // later change of the same slot wins
+        void update(std::optional<cell_t<zzz::Wengine>> wengine, std::vector<disc_change_t> discs);
+
+        // deleted members
+
+        Session(const Session&) = delete;
+        Session& operator=(const Session&) = delete;
+
+    protected:
+        request_t m_request;
+        std::map<uint64_t, zzz::DdsPtr> m_known_dds;
+        // set id to amount of discs which is used for bonus, either 2 or 4
+        std::map<uint64_t, size_t> m_bonuses;
+
+        std::optional<CompiledRotation> m_compiled;
+        std::array<std::vector<double>, 6> m_disc_totals;
+        std::vector<double> m_totals;
+        std::vector<double> m_cell_dmg;
+
+        Calculator::result_t m_result;
+        size_t m_recomputed = 0;
+
+    private:
+        // everything derived from request, built aside and moved into session when change succeeds
+        struct derived_t {
+            // empty when rotation isn't recompiled
+            std::optional<CompiledRotation> compiled;
+            std::array<std::vector<double>, 6> disc_totals;
+            std::vector<double> totals;
+            std::vector<double> cell_dmg;
+            Calculator::result_t result;
+            size_t recomputed = 0;
+        };
+
+        static std::map<uint64_t, size_t> _count_bonuses(std::span<const zzz::Ddp* const> ddps);
+        std::array<const zzz::Ddp*, 6> _ddps() const;
+        // dds of bonuses are taken from known ones or added
+        void _compose_dds(const std::map<uint64_t, size_t>& bonuses, const std::map<uint64_t, zzz::DdsPtr>& added);
+
+        derived_t _rebuild() const;
+        // recomputes cells which depend on stats of given discs with current compiled rotation
+        derived_t _recompute(std::span<const zzz::Ddp* const> ddps) const;
+        void _commit(derived_t derived);
+
+        static std::vector<double> _sum_totals(const std::array<std::vector<double>, 6>& disc_totals, size_t width);
+        static Calculator::result_t _collect_result(const CompiledRotation& compiled, std::span<const double> cell_dmg);
+    };
+}
@@ -0,0 +1,222 @@
+#include "calc/timeline.hpp"
+
+//std
+#include <algorithm>
+#include <map>
+#include <queue>
+
+//lib
+#include "library/deadline.hpp"
+#include "library/format.hpp"
+
+//zzz
+#include "zzz/stats/regular.hpp"
+
+using namespace zzz;
+
+namespace calc::timeline_details {
+    // at the same time stun ends and buffs expire before next action starts
+    enum class event_kind : uint8_t {
+        StunEnd, BuffExpiry, Action
+    };
+
+    struct event_t {
+        double time;
+        event_kind kind;
+        size_t target;
+        uint64_t generation;
+    };
+
+    struct later_t {
+        bool operator()(const event_t& lhs, const event_t& rhs) const {
+            return lhs.time != rhs.time ? lhs.time > rhs.time : lhs.kind > rhs.kind;
+        }
+    };
+}
+
+namespace calc {
+    Timeline::Timeline(const request_t& request, timeline_config_t config, const enemy_t& enemy) :
+        m_config(std::move(config)),
+        m_enemy(enemy),
+        m_agent(request.agent.ptr),
+        m_stats(details::calc_stats(request)) {
+        if (request.buildup_threshold.has_value())
+            throw RUNTIME_ERROR("anomaly buildup is supported only by eval and eval_detailed");
+
+        const auto& agent = m_agent->details();
+        const auto& rotation = request.rotation->details();
+
+        m_stats.add(StatsGrid::make_defined_relative_stat(StatId::AtkTotal, Tag::Universal));
+        m_stats.add(StatsGrid::make_defined_relative_stat(StatId::ImpactTotal, Tag::Universal));
+
+        std::map<std::pair<std::string, uint64_t>, size_t> kinds;
+
+        m_actions.reserve(rotation.size());
+        for (const auto& cell : rotation.cells()) {
+            const auto& ability = agent.ability(cell.command);
+            auto& action = m_actions.emplace_back();
+
+            if (std::holds_alternative<SkillDetails>(ability))
+                action.ability = &std::get<SkillDetails>(ability);
+            else if (std::holds_alternative<AnomalyDetails>(ability))
+                action.ability = &std::get<AnomalyDetails>(ability);
+            else
+                throw RUNTIME_ERROR("ability is neither skill nor anomaly");
+
+            action.index = cell.index - 1;
+            action.kind = kinds.emplace(std::pair(cell.command, cell.index), kinds.size()).first->second;
+            action.duration = cell.duration > 0.0 ? cell.duration : m_config.default_duration;
+
+            for (size_t i = 0; i < m_config.buffs.size(); i++) {
+                if (m_config.buffs[i].trigger == cell.command)
+                    action.triggers.emplace_back(i);
+            }
+        }
+    }
+
+    timeline_result_t Timeline::run() const {
+        using namespace timeline_details;
+
+        timeline_result_t result;
+        result.dmg_per_ability.reserve(m_actions.size());
+        result.start_times.reserve(m_actions.size());
+
+        std::priority_queue<event_t, std::vector<event_t>, later_t> events;
+        std::vector<size_t> stacks(m_config.buffs.size(), 0);
+        std::vector<uint64_t> generations(m_config.buffs.size(), 0);
+
+        double daze = 0.0, stun_start = 0.0;
+        bool is_stunned = false, is_finished = false;
+
+        // key is [kind, is_stunned, stacks...]
+        std::map<std::vector<size_t>, hit_t> hits;
+        std::vector<size_t> key;
+
+        events.emplace(event_t { .time = 0.0, .kind = event_kind::Action, .target = 0, .generation = 0 });
+        while (!events.empty()) {
+            lib::Deadline::check();
+            auto event = events.top();
+            events.pop();
+
+            if (is_finished && event.time > result.duration)
+                break;
+
+            switch (event.kind) {
+            case event_kind::StunEnd:
+                is_stunned = false;
+                result.stunned_time += event.time - stun_start;
+                break;
+
+            case event_kind::BuffExpiry:
+                // buff was refreshed after this expiry was scheduled
+                if (generations[event.target] == event.generation)
+                    stacks[event.target] = 0;
+                break;
+
+            case event_kind::Action: {
+                const auto& action = m_actions[event.target];
+
+                key.assign({ action.kind, (size_t) is_stunned });
+                key.insert(key.end(), stacks.begin(), stacks.end());
+
+                auto it = hits.find(key);
+                if (it == hits.end())
+                    it = hits.emplace(key, _eval_hit(action, stacks, is_stunned)).first;
+                const auto& hit = it->second;
+
+                result.total_dmg += hit.dmg;
+                result.dmg_per_ability.emplace_back(hit.dmg);
+                result.start_times.emplace_back(event.time);
+
+                if (!is_stunned) {
+                    daze += hit.daze;
+
+                    if (daze >= m_config.daze_threshold) {
+                        daze = 0.0;
+                        is_stunned = true;
+                        stun_start = event.time;
+                        result.stuns++;
+
+                        events.emplace(event_t {
+                            .time = event.time + m_config.stun_duration,
+                            .kind = event_kind::StunEnd,
+                            .target = 0,
+                            .generation = 0
+                        });
+                    }
+                }
+
+                for (size_t i : action.triggers) {
+                    const auto& buff = m_config.buffs[i];
+                    stacks[i] = std::min(stacks[i] + 1, buff.max_stacks);
+
+                    events.emplace(event_t {
+                        .time = event.time + buff.duration,
+                        .kind = event_kind::BuffExpiry,
+                        .target = i,
+                        .generation = ++generations[i]
+                    });
+                }
+
+                double next = event.time + action.duration;
+                if (event.target + 1 < m_actions.size())
+                    events.emplace(event_t {
+                        .time = next,
+                        .kind = event_kind::Action,
+                        .target = event.target + 1,
+                        .generation = 0
+                    });
+                else {
+                    is_finished = true;
+                    result.duration = next;
+                }
+
+                break;
+            }
+            }
+        }
+
+        if (is_stunned)
+            result.stunned_time += result.duration - stun_start;
+
+        return result;
+    }
+
+    Timeline::hit_t Timeline::_eval_hit(const action_t& action, std::span<const size_t> stacks, bool is_stunned) const {
+        StatsGrid stats = m_stats;
+        for (size_t i = 0; i < stacks.size(); i++) {
+            if (stacks[i] == 0)
+                continue;
+
+            const auto& buff = m_config.buffs[i];
+            stats.add(RegularStat::make(buff.id, buff.tag, buff.value * (double) stacks[i]));
+        }
+
+        enemy_t enemy = m_enemy;
+        enemy.is_stunned = is_stunned;
+
+        batch::Columns columns(1);
+        batch::cell_consts_t consts;
+        double daze = 0.0;
+
+        if (std::holds_alternative<const SkillDetails*>(action.ability)) {
+            const auto& skill = *std::get<const SkillDetails*>(action.ability);
+            const auto& scale = skill.scales()[action.index];
+
+            consts = batch::make_regular_consts(skill, action.index, enemy);
+            columns.set_regular(0, stats, skill, action.index);
+
+            stats.add(skill.buffs());
+            daze = scale.daze / 100
+                * stats.get_value({ .id = StatId::ImpactTotal, .tag = Tag::Universal })
+                * (1.0 + details::get_value(stats, StatId::DazeRatio, skill.tags()));
+        } else {
+            const auto& anomaly = *std::get<const AnomalyDetails*>(action.ability);
+
+            consts = batch::make_anomaly_consts(anomaly, enemy);
+            columns.set_anomaly(0, stats, anomaly);
+        }
+
+        return { .dmg = batch::eval_row(consts, columns.row(0)), .daze = daze };
+    }
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+//std
+#include <memory>
+#include <span>
+#include <string>
+#include <variant>
+#include <vector>
+
+//calculator
+#include "calc/batch.hpp"
+#include "calc/calculator.hpp"
+
+namespace calc {
+    // buff which is applied by command for limited time, every trigger adds stack and refreshes duration
+    struct timed_buff_t {
+        std::string trigger;
+        zzz::StatId id;
+        zzz::Tag tag = zzz::Tag::Universal;
+        // per stack
+        double value = 0.0;
+        double duration = 0.0;
+        size_t max_stacks = 1;
+    };
+
+    struct timeline_config_t {
+        // used for rotation cells without "@duration"
+        double default_duration = 1.0;
+        std::vector<timed_buff_t> buffs;
+        // enemy is stunned when daze reaches threshold
+        double daze_threshold = 10'000.0;
+        double stun_duration = 10.0;
+    };
+
+    struct timeline_result_t {
+        double total_dmg = 0.0;
+        std::vector<double> dmg_per_ability;
+        // when every action starts
+        std::vector<double> start_times;
+        double duration = 0.0;
+        size_t stuns = 0;
+        double stunned_time = 0.0;
+    };
+
+    // event-driven simulation of rotation in time.
+    // actions, buff expiries and stun ends are processed in order of time by priority queue.
+    // every hit is evaluated with buffs active at its start and with stun state of enemy,
+    // then it builds up daze and applies buffs triggered by its command.
+    // hits with the same state are evaluated once per run, so run costs a few grid copies
+    // plus O(events * log(events)), without timed buffs and stuns it's identical to Calculator::eval
+    class Timeline {
+    public:
+        Timeline(const request_t& request, timeline_config_t config, const enemy_t& enemy = Calculator::enemy);
+
+        timeline_result_t run() const;
+
+    protected:
+        struct action_t {
+            std::variant<const zzz::SkillDetails*, const zzz::AnomalyDetails*> ability;
+            size_t index;
+            // same for actions with the same ability and index
+            size_t kind;
+            double duration;
+            // indices of buffs triggered by action
+            std::vector<size_t> triggers;
+        };
+
+        // damage and daze of hit in some state
+        struct hit_t {
+            double dmg, daze;
+        };
+
+        timeline_config_t m_config;
+        enemy_t m_enemy;
+        // abilities of actions point into agent
+        std::shared_ptr<zzz::Agent> m_agent;
+        zzz::StatsGrid m_stats;
+        std::vector<action_t> m_actions;
+
+    private:
+        hit_t _eval_hit(const action_t& action, std::span<const size_t> stacks, bool is_stunned) const;
+    };
+}
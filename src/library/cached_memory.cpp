@@ -1,6 +1,7 @@
 #include "library/cached_memory.hpp"
 
 //std
+#include <charconv>
 #include <fstream>
 #include <ranges>
 
@@ -10,6 +11,7 @@
 //lib
 #include "library/format.hpp"
 #include "library/string_funcs.hpp"
+#include "library/trace.hpp"
 
 //crow
 #include "crow/logging.h"
@@ -19,6 +21,25 @@ namespace global {
 }
 
 namespace lib {
+    // ObjectKey
+
+    std::string ObjectKey::to_string() const {
+        std::string result(_folder);
+        for (size_t i = 0; i < _count; i++)
+            result += lib::format("/{}", _ids[i]);
+
+        return result;
+    }
+
+    void ObjectKey::_append(uint64_t id) {
+        // '/' and at most 20 digits
+        std::array<char, 21> buffer;
+        buffer[0] = '/';
+        auto [ptr, ec] = std::to_chars(buffer.data() + 1, buffer.data() + buffer.size(), id);
+
+        _hash = hash_append(_hash, { buffer.data(), ptr });
+    }
+
     // MObject
 
     MObject::MObject(std::string fullname) :
@@ -46,6 +67,10 @@ namespace lib {
             return false;
         }
 
+        file.seekg(0, std::ios::end);
+        _size = file.tellg();
+        file.seekg(0, std::ios::beg);
+
         return load_from_stream(file, mode);
     }
 
@@ -54,22 +79,45 @@ namespace lib {
     std::unordered_map<size_t, std::string> ObjectManager::file_extensions = {};
 
     ObjectManager::ObjectManager(size_t file_extension_id) :
-        m_file_extension_id(file_extension_id) {
+        m_file_extension_id(file_extension_id),
+        m_loads(lib::metrics().counter("zzz_object_loads_total", "", "Objects loaded from disk since start")),
+        m_evictions(lib::metrics().counter("zzz_object_evictions_total", "", "Objects evicted from memory since start")) {
         if (file_extensions.empty())
             init_default_file_extensions();
     }
 
     ObjectManager::~ObjectManager() {
-        m_is_active = false;
-        m_is_ended.wait(false);
+        // eviction thread exists only after launch
+        if (m_is_active.exchange(false))
+            m_is_ended.wait(false);
     }
 
     MObjectPtr ObjectManager::get(const std::string& key) {
-        return _get_logic(key);
+        if (auto result = _get_logic(hash(key)))
+            return result;
+        throw RUNTIME_ERROR(lib::format("{} doesn't exist", key));
+    }
+    MObjectPtr ObjectManager::get(const ObjectKey& key) {
+        if (auto result = _get_logic(key.hash()))
+            return result;
+        throw RUNTIME_ERROR(lib::format("{} doesn't exist", key.to_string()));
     }
     std::future<MObjectPtr> ObjectManager::get_async(std::string key) {
-        return std::async(std::launch::async, [this, key = std::move(key)] {
-            return _get_logic(key);
+        // trace session of caller is carried over to loading thread
+        return std::async(std::launch::async, [this, key = std::move(key), trace = TraceSession::current()] {
+            TraceSession::Binder binder(trace);
+            TraceScope scope("load", key);
+
+            return get(key);
+        });
+    }
+    std::future<MObjectPtr> ObjectManager::get_async(ObjectKey key) {
+        return std::async(std::launch::async, [this, key, trace = TraceSession::current()] {
+            TraceSession::Binder binder(trace);
+            // name is built only for traced requests
+            TraceScope scope("load", trace != nullptr ? key.to_string() : std::string());
+
+            return get(key);
         });
     }
 
@@ -78,12 +126,18 @@ namespace lib {
     }
 
     void ObjectManager::clear() {
+        for (const auto& v : m_content | std::views::values) {
+            std::lock_guard lock(v->_mutex);
+            _unload(*v);
+        }
 	    m_content.clear();
     }
 
     void ObjectManager::free_memory() {
-        for (auto& v : m_content | std::views::values)
-            v->_content = nullptr;
+        for (auto& v : m_content | std::views::values) {
+            std::lock_guard lock(v->_mutex);
+            _unload(*v);
+        }
     }
 
     void ObjectManager::launch() {
@@ -92,19 +146,35 @@ namespace lib {
         thread.detach();
     }
 
-    MObjectPtr ObjectManager::_get_logic(const std::string& key) {
-        auto it = m_content.find(hash(key));
+    ObjectManager::stats_t ObjectManager::stats() const {
+        return {
+            .objects = m_content.size(),
+            .resident = m_resident.load(std::memory_order_relaxed),
+            .resident_bytes = m_resident_bytes.load(std::memory_order_relaxed),
+            .loads = m_loads.value(),
+            .evictions = m_evictions.value()
+        };
+    }
+
+    MObjectPtr ObjectManager::_get_logic(size_t hashed_key) {
+        auto it = m_content.find(hashed_key);
 
         if (it == m_content.end())
-            throw RUNTIME_ERROR(lib::format("{} doesn't exist", key));
+            return nullptr;
 
         auto& object = it->second;
         object->_unused_period = 0;
 
+        // concurrent getters wait for the first one, which loads object and counts it
+        std::lock_guard lock(object->_mutex);
         if (object->is_allocated())
             return object;
 
-        object->load(m_file_extension_id);
+        if (object->load(m_file_extension_id) && object->is_allocated()) {
+            m_loads.inc();
+            m_resident.fetch_add(1, std::memory_order_relaxed);
+            m_resident_bytes.fetch_add(object->_size, std::memory_order_relaxed);
+        }
 
 #ifdef DEBUG_STATUS
         CROW_LOG_INFO << lib::format("{} is loaded", object->_fullname);
@@ -113,6 +183,15 @@ namespace lib {
         return object;
     }
 
+    void ObjectManager::_unload(MObject& object) {
+        if (!object.is_allocated())
+            return;
+
+        m_resident.fetch_sub(1, std::memory_order_relaxed);
+        m_resident_bytes.fetch_sub(object._size, std::memory_order_relaxed);
+        object._content.reset();
+    }
+
     void ObjectManager::_launch_logic() {
         while (m_is_active) {
             // resets object from memory when passed enough time
@@ -124,7 +203,13 @@ namespace lib {
                     obj->_unused_period++;
 
                 if (obj->_unused_period == max_unused_period) {
-                    obj->_content.reset();
+                    std::lock_guard lock(obj->_mutex);
+                    // object may be taken again after the check above
+                    if (obj.use_count() != 1 || obj->_content.use_count() != 1)
+                        continue;
+
+                    _unload(*obj);
+                    m_evictions.inc();
 #ifdef DEBUG_STATUS
                     CROW_LOG_INFO << lib::format("{} is deleted", obj->_fullname);
 #endif
@@ -2,13 +2,62 @@
 
 //std
 #include <any>
+#include <array>
 #include <atomic>
+#include <concepts>
+#include <cstdint>
 #include <future>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 
+//library
+#include "library/metrics.hpp"
+#include "library/string_funcs.hpp"
+
 namespace lib {
+    // folder of objects, name is hashed at compile time
+    struct object_folder_t {
+        std::string_view name;
+        size_t hash;
+
+        consteval object_folder_t(const char* literal) :
+            name(literal),
+            hash(lib::hash(name)) {
+        }
+    };
+
+    // key of object named "{folder}/{id}" or "{folder}/{id}/{id}".
+    // hash is the same as of name, but name is built only by to_string
+    class ObjectKey {
+    public:
+        static constexpr size_t max_ids = 2;
+
+        template<std::integral... Ts>
+            requires(sizeof...(Ts) >= 1 && sizeof...(Ts) <= max_ids)
+        ObjectKey(object_folder_t folder, Ts... ids) :
+            _folder(folder.name),
+            _ids { (uint64_t) ids... },
+            _count(sizeof...(Ts)),
+            _hash(folder.hash) {
+            for (size_t i = 0; i < _count; i++)
+                _append(_ids[i]);
+        }
+
+        size_t hash() const { return _hash; }
+        std::string to_string() const;
+
+    private:
+        std::string_view _folder;
+        std::array<uint64_t, max_ids> _ids;
+        size_t _count;
+        size_t _hash;
+
+        void _append(uint64_t id);
+    };
+
     using MObjectPtr = std::shared_ptr<class MObject>;
     // helper for ObjectManager
     class MObject {
@@ -38,8 +87,12 @@ namespace lib {
 
     private:
         std::shared_ptr<void> _content = nullptr;
+        // guards loading and unloading, so memory stats change only once per transition
+        std::mutex _mutex;
         // TODO: make atomic
         size_t _unused_period = 0;
+        // size of source file, counted in ObjectManager memory stats
+        size_t _size = 0;
         const std::string _fullname;
     };
 
@@ -47,6 +100,15 @@ namespace lib {
     public:
         using ObjectMaker = std::function<MObjectPtr(std::string)>;
 
+        struct stats_t {
+            size_t objects;
+            size_t resident;
+            // sum of source file sizes of resident objects
+            size_t resident_bytes;
+            size_t loads;
+            size_t evictions;
+        };
+
         static std::unordered_map<size_t, std::string> file_extensions;
         static void init_default_file_extensions() {
             file_extensions = {
@@ -66,7 +128,9 @@ namespace lib {
         ~ObjectManager();
 
         MObjectPtr get(const std::string& key);
+        MObjectPtr get(const ObjectKey& key);
         std::future<MObjectPtr> get_async(std::string key);
+        std::future<MObjectPtr> get_async(ObjectKey key);
 
         void add_object(const MObjectPtr& value);
 
@@ -76,6 +140,9 @@ namespace lib {
 
         void launch();
 
+        // lock-free, may be slightly inconsistent while objects are loaded
+        stats_t stats() const;
+
         // deleted members
 
         ObjectManager(const ObjectManager&) = delete;
@@ -88,8 +155,17 @@ namespace lib {
         size_t m_file_extension_id;
         std::unordered_map<size_t, MObjectPtr> m_content;
 
+        // memory stats
+        std::atomic_size_t m_resident = 0, m_resident_bytes = 0;
+        lib::Counter& m_loads;
+        lib::Counter& m_evictions;
+
     private:
-        MObjectPtr _get_logic(const std::string& key);
+        // nullptr if object doesn't exist
+        MObjectPtr _get_logic(size_t hashed_key);
+
+        // unloads object if it's allocated, caller holds its mutex
+        void _unload(MObject& object);
 
         void _launch_logic();
     };
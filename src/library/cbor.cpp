@@ -0,0 +1,153 @@
+#include "library/cbor.hpp"
+
+//std
+#include <cmath>
+#include <vector>
+
+namespace lib::cbor_details {
+    double half_to_double(uint16_t half) {
+        int exponent = (half >> 10) & 0x1f;
+        double mantissa = half & 0x3ff;
+        double result;
+
+        if (exponent == 0)
+            result = std::ldexp(mantissa, -24);
+        else if (exponent != 31)
+            result = std::ldexp(mantissa + 1024, exponent - 25);
+        else
+            result = mantissa == 0 ? INFINITY : NAN;
+
+        return (half & 0x8000) ? -result : result;
+    }
+
+    // handler of read_cbor which builds dom
+    class JsonBuilder {
+    public:
+        utl::Json result;
+
+        void begin_object() { _open() = utl::json::Object(); }
+        void end_object() { _stack.pop_back(); }
+        void begin_array() { _open() = utl::json::Array(); }
+        void end_array() { _stack.pop_back(); }
+
+        void key(std::string_view name) { _key = name; }
+
+        template<typename T>
+        void value(T what) {
+            if constexpr (std::is_same_v<T, std::nullptr_t>)
+                _next() = utl::json::Null();
+            else if constexpr (std::is_same_v<T, std::string_view>)
+                _next() = std::string(what);
+            else
+                _next() = what;
+        }
+
+    private:
+        // containers which are being filled, top is back
+        std::vector<utl::Json*> _stack;
+        std::string _key;
+
+        utl::Json& _next() {
+            if (_stack.empty())
+                return result;
+            if (_stack.back()->is_array())
+                return _stack.back()->as_array().emplace_back();
+            return (*_stack.back())[_key];
+        }
+        utl::Json& _open() {
+            auto& container = _next();
+            _stack.emplace_back(&container);
+            return container;
+        }
+    };
+}
+
+namespace lib {
+    // CborWriter
+
+    CborWriter::CborWriter(size_t reserve) {
+        _buffer.reserve(reserve);
+    }
+
+    CborWriter& CborWriter::begin_object() {
+        _buffer += (char) 0xbf;
+        return *this;
+    }
+    CborWriter& CborWriter::end_object() {
+        _buffer += (char) 0xff;
+        return *this;
+    }
+    CborWriter& CborWriter::begin_array() {
+        _buffer += (char) 0x9f;
+        return *this;
+    }
+    CborWriter& CborWriter::end_array() {
+        _buffer += (char) 0xff;
+        return *this;
+    }
+
+    CborWriter& CborWriter::key(std::string_view name) {
+        return value(name);
+    }
+
+    CborWriter& CborWriter::value(double what) {
+        uint64_t bits = std::bit_cast<uint64_t>(what);
+
+        _buffer += (char) 0xfb;
+        for (int shift = 56; shift >= 0; shift -= 8)
+            _buffer += (char) (bits >> shift);
+
+        return *this;
+    }
+    CborWriter& CborWriter::value(bool what) {
+        _buffer += (char) (what ? 0xf5 : 0xf4);
+        return *this;
+    }
+    CborWriter& CborWriter::value(std::nullptr_t) {
+        _buffer += (char) 0xf6;
+        return *this;
+    }
+    CborWriter& CborWriter::value(std::string_view what) {
+        _head(3, what.size());
+        _buffer += what;
+        return *this;
+    }
+    CborWriter& CborWriter::value(std::span<const double> what) {
+        // size is known, so array has definite length
+        _head(4, what.size());
+        for (double it : what)
+            value(it);
+        return *this;
+    }
+
+    void CborWriter::_head(uint8_t major, uint64_t argument) {
+        major <<= 5;
+
+        size_t size;
+        if (argument < 24) {
+            _buffer += (char) (major | argument);
+            return;
+        } else if (argument <= UINT8_MAX) {
+            _buffer += (char) (major | 24);
+            size = 1;
+        } else if (argument <= UINT16_MAX) {
+            _buffer += (char) (major | 25);
+            size = 2;
+        } else if (argument <= UINT32_MAX) {
+            _buffer += (char) (major | 26);
+            size = 4;
+        } else {
+            _buffer += (char) (major | 27);
+            size = 8;
+        }
+
+        for (size_t i = size; i-- > 0;)
+            _buffer += (char) (argument >> (i * 8));
+    }
+
+    utl::Json cbor_to_json(std::string_view data) {
+        cbor_details::JsonBuilder builder;
+        read_cbor(data, builder);
+        return std::move(builder.result);
+    }
+}
@@ -0,0 +1,216 @@
+#pragma once
+
+//std
+#include <bit>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+
+//utl
+#include "utl/json.hpp"
+
+//library
+#include "library/format.hpp"
+
+namespace lib {
+    constexpr std::string_view cbor_mime = "application/cbor";
+
+    // writes cbor (rfc 8949) with the same calls as JsonWriter, so serializers are shared.
+    // objects and arrays are of indefinite length, so nothing has to be counted beforehand,
+    // doubles are written as raw 8 bytes and integers take the smallest possible head
+    class CborWriter {
+    public:
+        explicit CborWriter(size_t reserve = 256);
+
+        CborWriter& begin_object();
+        CborWriter& end_object();
+        CborWriter& begin_array();
+        CborWriter& end_array();
+
+        CborWriter& key(std::string_view name);
+
+        CborWriter& value(double what);
+        CborWriter& value(bool what);
+        CborWriter& value(std::nullptr_t);
+        CborWriter& value(std::string_view what);
+        CborWriter& value(const char* what) { return value(std::string_view(what)); }
+        template<std::integral T>
+        CborWriter& value(T what) {
+            if constexpr (std::is_signed_v<T>) {
+                if (what < 0) {
+                    // -1 - n is written as n
+                    _head(1, (uint64_t) -((int64_t) what + 1));
+                    return *this;
+                }
+            }
+            _head(0, (uint64_t) what);
+            return *this;
+        }
+        CborWriter& value(std::span<const double> what);
+
+        // key(name).value(what)
+        template<typename T>
+        CborWriter& field(std::string_view name, const T& what) {
+            key(name);
+            return value(what);
+        }
+
+        const std::string& str() const { return _buffer; }
+        std::string take() { return std::move(_buffer); }
+
+    private:
+        std::string _buffer;
+
+        void _head(uint8_t major, uint64_t argument);
+    };
+
+    namespace cbor_details {
+        constexpr size_t max_depth = 64;
+
+        class Reader {
+        public:
+            explicit Reader(std::string_view data) : _data(data) {}
+
+            bool is_end() const { return _offset == _data.size(); }
+
+            uint8_t byte() {
+                if (_offset >= _data.size())
+                    throw RUNTIME_ERROR("cbor is truncated");
+                return (uint8_t) _data[_offset++];
+            }
+            uint8_t peek() const {
+                if (_offset >= _data.size())
+                    throw RUNTIME_ERROR("cbor is truncated");
+                return (uint8_t) _data[_offset];
+            }
+            // big endian
+            uint64_t number(size_t size) {
+                uint64_t result = 0;
+                for (size_t i = 0; i < size; i++)
+                    result = (result << 8) | byte();
+                return result;
+            }
+            std::string_view bytes(uint64_t size) {
+                if (size > _data.size() - _offset)
+                    throw RUNTIME_ERROR("cbor is truncated");
+                auto result = _data.substr(_offset, size);
+                _offset += size;
+                return result;
+            }
+
+        private:
+            std::string_view _data;
+            size_t _offset = 0;
+        };
+
+        // argument of head, additional info 31 (indefinite length) is returned as UINT64_MAX
+        inline uint64_t argument(Reader& reader, uint8_t info) {
+            if (info < 24)
+                return info;
+            if (info <= 27)
+                return reader.number((size_t) 1 << (info - 24));
+            if (info == 31)
+                return UINT64_MAX;
+
+            throw FMT_RUNTIME_ERROR("reserved cbor additional info {}", info);
+        }
+
+        double half_to_double(uint16_t half);
+
+        template<typename Handler>
+        void read_item(Reader& reader, Handler& handler, size_t depth, bool is_key = false) {
+            if (depth > max_depth)
+                throw RUNTIME_ERROR("cbor is nested too deep");
+
+            uint8_t initial = reader.byte();
+            uint8_t major = initial >> 5, info = initial & 0x1f;
+            bool is_indefinite = info == 31;
+
+            if (is_key && major != 3)
+                throw RUNTIME_ERROR("cbor map keys have to be text strings");
+
+            // floats and simple values take their bits as is
+            if (major == 7) {
+                switch (info) {
+                case 20: handler.value(false); return;
+                case 21: handler.value(true); return;
+                case 22: case 23: handler.value(nullptr); return;
+                case 25: handler.value(half_to_double((uint16_t) reader.number(2))); return;
+                case 26: handler.value((double) std::bit_cast<float>((uint32_t) reader.number(4))); return;
+                case 27: handler.value(std::bit_cast<double>(reader.number(8))); return;
+                default: throw FMT_RUNTIME_ERROR("unsupported cbor simple value {}", info);
+                }
+            }
+
+            uint64_t count = argument(reader, info);
+
+            switch (major) {
+            case 0:
+                if (count > INT64_MAX)
+                    throw RUNTIME_ERROR("cbor integer is out of range");
+                handler.value((int64_t) count);
+                break;
+
+            case 1:
+                if (count > INT64_MAX)
+                    throw RUNTIME_ERROR("cbor integer is out of range");
+                handler.value(-1 - (int64_t) count);
+                break;
+
+            case 3:
+                if (is_indefinite)
+                    throw RUNTIME_ERROR("chunked cbor strings aren't supported");
+                if (is_key)
+                    handler.key(reader.bytes(count));
+                else
+                    handler.value(reader.bytes(count));
+                break;
+
+            case 4: case 5:
+                if (major == 4)
+                    handler.begin_array();
+                else
+                    handler.begin_object();
+                for (uint64_t i = 0; is_indefinite ? reader.peek() != 0xff : i < count; i++) {
+                    if (major == 5)
+                        read_item(reader, handler, depth + 1, true);
+                    read_item(reader, handler, depth + 1);
+                }
+                // break
+                if (is_indefinite)
+                    reader.byte();
+                if (major == 4)
+                    handler.end_array();
+                else
+                    handler.end_object();
+                break;
+
+            case 6:
+                // semantic tags don't change request, item goes as is
+                read_item(reader, handler, depth, is_key);
+                break;
+
+            default:
+                throw RUNTIME_ERROR("cbor byte strings aren't supported");
+            }
+        }
+    }
+
+    // sax-style reading, handler gets the same calls as JsonWriter and CborWriter take:
+    // begin_object, end_object, begin_array, end_array, key(string_view) and
+    // value of double, int64_t, bool, nullptr or string_view
+    template<typename Handler>
+    void read_cbor(std::string_view data, Handler& handler) {
+        cbor_details::Reader reader(data);
+        cbor_details::read_item(reader, handler, 0);
+
+        if (!reader.is_end())
+            throw RUNTIME_ERROR("cbor has trailing bytes");
+    }
+
+    // request bodies are consumed as utl::Json by preparers of backend
+    utl::Json cbor_to_json(std::string_view data);
+}
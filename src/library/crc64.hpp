@@ -41,7 +41,10 @@
 
 //std
 #include <array>
+#include <bit>
 #include <cstdint>
+#include <cstring>
+#include <type_traits>
 
 static constexpr std::array<uint64_t, 256> crc64_table = {
     0x0000000000000000, 0x7ad870c830358979, 0xf5b0e190606b12f2, 0x8f689158505e9b8b,
@@ -117,3 +120,37 @@ constexpr uint64_t crc64(uint64_t crc, const char* cstr, uint64_t length) {
     }
     return crc;
 }
+
+// slice-by-8: table k gives crc of byte followed by k zero bytes,
+// so 8 bytes are processed by 8 independent lookups instead of 8 dependent ones
+static constexpr std::array<std::array<uint64_t, 256>, 8> crc64_slice_tables = [] {
+    std::array<std::array<uint64_t, 256>, 8> result = {};
+    result[0] = crc64_table;
+
+    for (size_t k = 1; k < 8; k++) {
+        for (size_t i = 0; i < 256; i++)
+            result[k][i] = crc64_table[(uint8_t) result[k - 1][i]] ^ (result[k - 1][i] >> 8);
+    }
+
+    return result;
+}();
+
+// the same result as crc64, bytewise in constant evaluation and on big endian targets
+constexpr uint64_t crc64_slice8(uint64_t crc, const char* cstr, uint64_t length) {
+    if (std::is_constant_evaluated() || std::endian::native != std::endian::little)
+        return crc64(crc, cstr, length);
+
+    const auto& t = crc64_slice_tables;
+    for (; length >= 8; cstr += 8, length -= 8) {
+        uint64_t word;
+        std::memcpy(&word, cstr, 8);
+        crc ^= word;
+
+        crc = t[7][(uint8_t) crc] ^ t[6][(uint8_t) (crc >> 8)]
+            ^ t[5][(uint8_t) (crc >> 16)] ^ t[4][(uint8_t) (crc >> 24)]
+            ^ t[3][(uint8_t) (crc >> 32)] ^ t[2][(uint8_t) (crc >> 40)]
+            ^ t[1][(uint8_t) (crc >> 48)] ^ t[0][crc >> 56];
+    }
+
+    return crc64(crc, cstr, length);
+}
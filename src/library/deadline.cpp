@@ -0,0 +1,38 @@
+#include "library/deadline.hpp"
+
+namespace lib::deadline_details {
+    thread_local Deadline* current_deadline = nullptr;
+}
+
+namespace lib {
+    Deadline* Deadline::current() { return deadline_details::current_deadline; }
+
+    void Deadline::check() {
+        if (is_current_expired())
+            throw DeadlineExceeded();
+    }
+    bool Deadline::is_current_expired() {
+        auto* deadline = deadline_details::current_deadline;
+        return deadline != nullptr && deadline->is_expired();
+    }
+
+    Deadline::Binder::Binder(Deadline* deadline) :
+        _previous(deadline_details::current_deadline) {
+        deadline_details::current_deadline = deadline;
+    }
+    Deadline::Binder::~Binder() {
+        deadline_details::current_deadline = _previous;
+    }
+
+    Deadline::Deadline(clock::time_point at) :
+        _at(at),
+        _previous(deadline_details::current_deadline) {
+        deadline_details::current_deadline = this;
+    }
+    Deadline::~Deadline() {
+        deadline_details::current_deadline = _previous;
+    }
+
+    Deadline::clock::time_point Deadline::at() const { return _at; }
+    bool Deadline::is_expired() const { return clock::now() >= _at; }
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+//std
+#include <chrono>
+#include <stdexcept>
+
+namespace lib {
+    // thrown by Deadline::check, backend responds to it with 504
+    class DeadlineExceeded : public std::runtime_error {
+    public:
+        DeadlineExceeded() : std::runtime_error("deadline of request is exceeded") {}
+    };
+
+    // cooperative cancellation of request: long loops call Deadline::check at checkpoints.
+    // deadline binds itself to constructing thread, other threads have to use Binder.
+    // when no deadline is bound check costs one thread_local read
+    class Deadline {
+    public:
+        using clock = std::chrono::steady_clock;
+
+        static Deadline* current();
+        // throws DeadlineExceeded when deadline bound to current thread has passed
+        static void check();
+        // the same as check without exception, for threads which mustn't throw
+        static bool is_current_expired();
+
+        // binds deadline to current thread until destruction, nullptr unbinds
+        class Binder {
+        public:
+            explicit Binder(Deadline* deadline);
+            ~Binder();
+
+            Binder(const Binder&) = delete;
+            Binder& operator=(const Binder&) = delete;
+
+        private:
+            Deadline* _previous;
+        };
+
+        explicit Deadline(clock::time_point at);
+        ~Deadline();
+
+        clock::time_point at() const;
+        bool is_expired() const;
+
+        // deleted members
+
+        Deadline(const Deadline&) = delete;
+        Deadline& operator=(const Deadline&) = delete;
+
+    private:
+        clock::time_point _at;
+        Deadline* _previous;
+    };
+}
@@ -0,0 +1,199 @@
+#include "library/json_writer.hpp"
+
+//std
+#include <array>
+#include <charconv>
+#include <cmath>
+
+//library
+#include "library/format.hpp"
+
+namespace lib::json_writer_details {
+    // the same escapes as utl::Json writes
+    constexpr std::array<char, 256> escaped_chars = [] {
+        std::array<char, 256> result = {};
+        result[(uint8_t) '"'] = '"';
+        result[(uint8_t) '\\'] = '\\';
+        result[(uint8_t) '\b'] = 'b';
+        result[(uint8_t) '\f'] = 'f';
+        result[(uint8_t) '\n'] = 'n';
+        result[(uint8_t) '\r'] = 'r';
+        result[(uint8_t) '\t'] = 't';
+        return result;
+    }();
+
+    // fixed notation of 1e308 with max precision fits
+    constexpr size_t number_buffer_size = 384;
+    constexpr int max_precision = 17;
+}
+
+namespace lib {
+    // json_number_format_t
+
+    json_number_format_t json_number_format_t::make(std::string_view rounding, int precision) {
+        json_number_format_t result = { .precision = precision };
+
+        if (rounding == "exact")
+            result.rounding = Exact;
+        else if (rounding == "significant")
+            result.rounding = Significant;
+        else if (rounding == "decimals")
+            result.rounding = Decimals;
+        else
+            throw FMT_RUNTIME_ERROR("unknown rounding \"{}\"", rounding);
+
+        bool is_valid = result.rounding == Exact
+            || (precision >= (result.rounding == Significant ? 1 : 0) && precision <= json_writer_details::max_precision);
+        if (!is_valid)
+            throw FMT_RUNTIME_ERROR("precision {} is out of range for rounding \"{}\"", precision, rounding);
+
+        return result;
+    }
+
+    // JsonWriter
+
+    JsonWriter::JsonWriter(size_t reserve, json_number_format_t format) :
+        _format(format) {
+        _buffer.reserve(reserve);
+    }
+
+    JsonWriter& JsonWriter::begin_object() {
+        _separate();
+        _buffer += '{';
+        _needs_comma = false;
+        return *this;
+    }
+    JsonWriter& JsonWriter::end_object() {
+        _buffer += '}';
+        _needs_comma = true;
+        return *this;
+    }
+    JsonWriter& JsonWriter::begin_array() {
+        _separate();
+        _buffer += '[';
+        _needs_comma = false;
+        return *this;
+    }
+    JsonWriter& JsonWriter::end_array() {
+        _buffer += ']';
+        _needs_comma = true;
+        return *this;
+    }
+
+    JsonWriter& JsonWriter::key(std::string_view name) {
+        value(name);
+        _buffer += ':';
+        _needs_comma = false;
+        return *this;
+    }
+
+    JsonWriter& JsonWriter::value(double what) {
+        _separate();
+
+        std::array<char, json_writer_details::number_buffer_size> buffer;
+        char* first = buffer.data();
+        char* last = buffer.data() + buffer.size();
+        std::to_chars_result result;
+
+        switch (_format.rounding) {
+        case json_number_format_t::Significant:
+            result = std::to_chars(first, last, what, std::chars_format::general, _format.precision);
+            break;
+
+        case json_number_format_t::Decimals:
+            result = std::to_chars(first, last, what, std::chars_format::fixed, _format.precision);
+            break;
+
+        default:
+            result = std::to_chars(first, last, what);
+        }
+
+        if (result.ec != std::errc())
+            throw FMT_RUNTIME_ERROR("can't write number {}", what);
+
+        std::string_view number(first, result.ptr);
+        // fixed notation keeps trailing zeros, they only make payload longer
+        if (_format.rounding == json_number_format_t::Decimals && number.find('.') != std::string_view::npos) {
+            number.remove_suffix(number.size() - number.find_last_not_of('0') - 1);
+            if (number.ends_with('.'))
+                number.remove_suffix(1);
+        }
+
+        // json has no nan and inf, utl::Json writes them as strings
+        if (std::isfinite(what))
+            _buffer += number;
+        else {
+            _buffer += '"';
+            _buffer += number;
+            _buffer += '"';
+        }
+
+        _needs_comma = true;
+        return *this;
+    }
+    JsonWriter& JsonWriter::value(bool what) {
+        _separate();
+        _buffer += what ? "true" : "false";
+        _needs_comma = true;
+        return *this;
+    }
+    JsonWriter& JsonWriter::value(std::nullptr_t) {
+        _separate();
+        _buffer += "null";
+        _needs_comma = true;
+        return *this;
+    }
+    JsonWriter& JsonWriter::value(std::string_view what) {
+        _separate();
+        _buffer += '"';
+
+        // appends segments between escaped characters
+        size_t segment_start = 0;
+        for (size_t i = 0; i < what.size(); i++) {
+            if (char replacement = json_writer_details::escaped_chars[(uint8_t) what[i]]) {
+                _buffer.append(what.data() + segment_start, i - segment_start);
+                _buffer += '\\';
+                _buffer += replacement;
+                segment_start = i + 1;
+            }
+        }
+        _buffer.append(what.data() + segment_start, what.size() - segment_start);
+
+        _buffer += '"';
+        _needs_comma = true;
+        return *this;
+    }
+    JsonWriter& JsonWriter::value(std::span<const double> what) {
+        begin_array();
+        for (double it : what)
+            value(it);
+        return end_array();
+    }
+
+    void JsonWriter::_separate() {
+        if (_needs_comma)
+            _buffer += ',';
+    }
+    JsonWriter& JsonWriter::_integral(int64_t what) {
+        _separate();
+
+        // "-9223372036854775808"
+        std::array<char, 20> buffer;
+        auto [ptr, ec] = std::to_chars(buffer.data(), buffer.data() + buffer.size(), what);
+        _buffer.append(buffer.data(), ptr);
+
+        _needs_comma = true;
+        return *this;
+    }
+    JsonWriter& JsonWriter::_integral(uint64_t what) {
+        _separate();
+
+        // "18446744073709551615"
+        std::array<char, 20> buffer;
+        auto [ptr, ec] = std::to_chars(buffer.data(), buffer.data() + buffer.size(), what);
+        _buffer.append(buffer.data(), ptr);
+
+        _needs_comma = true;
+        return *this;
+    }
+}
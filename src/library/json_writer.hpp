@@ -0,0 +1,77 @@
+#pragma once
+
+//std
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+
+namespace lib {
+    struct json_number_format_t {
+        enum Rounding : uint8_t {
+            // shortest representation which reads back to the same double, as utl::Json writes it
+            Exact,
+            // precision significant digits
+            Significant,
+            // precision digits after point, trailing zeros are dropped
+            Decimals
+        };
+
+        Rounding rounding = Exact;
+        int precision = 0;
+
+        // "exact", "significant" or "decimals", precision is ignored for exact
+        static json_number_format_t make(std::string_view rounding, int precision);
+    };
+
+    // writes minimized json straight into string without DOM, output of the same values
+    // is identical to utl::Json::to_string(MINIMIZED) with Exact format.
+    // caller is responsible for structure and for order of keys, utl::Json sorts them
+    class JsonWriter {
+    public:
+        explicit JsonWriter(size_t reserve = 256, json_number_format_t format = {});
+
+        JsonWriter& begin_object();
+        JsonWriter& end_object();
+        JsonWriter& begin_array();
+        JsonWriter& end_array();
+
+        JsonWriter& key(std::string_view name);
+
+        JsonWriter& value(double what);
+        JsonWriter& value(bool what);
+        JsonWriter& value(std::nullptr_t);
+        JsonWriter& value(std::string_view what);
+        JsonWriter& value(const char* what) { return value(std::string_view(what)); }
+        template<std::integral T>
+        JsonWriter& value(T what) {
+            if constexpr (std::is_signed_v<T>)
+                return _integral((int64_t) what);
+            else
+                return _integral((uint64_t) what);
+        }
+        JsonWriter& value(std::span<const double> what);
+
+        // key(name).value(what)
+        template<typename T>
+        JsonWriter& field(std::string_view name, const T& what) {
+            key(name);
+            return value(what);
+        }
+
+        const std::string& str() const { return _buffer; }
+        std::string take() { return std::move(_buffer); }
+
+    private:
+        std::string _buffer;
+        json_number_format_t _format;
+        // whether next value or key is preceded by comma
+        bool _needs_comma = false;
+
+        void _separate();
+        JsonWriter& _integral(int64_t what);
+        JsonWriter& _integral(uint64_t what);
+    };
+}
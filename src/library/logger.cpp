@@ -1,6 +1,7 @@
 #include "library/logger.hpp"
 
 //std
+#include <algorithm>
 #include <array>
 #include <chrono>
 #include <iostream>
@@ -29,19 +30,143 @@ namespace backend::logger_convert {
 }
 
 namespace backend {
+    Logger::Logger(size_t capacity) :
+        m_queue(capacity),
+        _dropped(lib::metrics().counter("zzz_log_dropped_total", "", "Log messages dropped because queue was full")),
+        _written(lib::metrics().counter("zzz_log_written_total", "", "Log messages written to streams")),
+        _thread(&Logger::_drain_logic, this) {
+    }
+    Logger::~Logger() {
+        stop();
+    }
+
     void Logger::add_log_stream(std::ostream& stream) {
+        std::lock_guard lock(_mutex);
         _ostreams.emplace_back(&stream);
     }
+    void Logger::set_flush_policy(flush_policy_t policy) {
+        std::lock_guard lock(_mutex);
+        _policy = policy;
+    }
 
     void Logger::log(std::string message, crow::LogLevel level) {
+        if (!m_queue.try_push({ std::move(message), level, clock::now() })) {
+            _dropped.inc();
+            return;
+        }
+
+        // pairs with fences of _drain_logic and stop: either they see message in queue or flags are seen here
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (_is_stopped.load())
+            _write_queued();
+        else if (_is_idle.load()) {
+            std::lock_guard lock(_mutex);
+            _wakeup.notify_one();
+        }
+    }
+
+    void Logger::stop() {
+        if (!m_is_active.exchange(false))
+            return;
+
+        {
+            std::lock_guard lock(_mutex);
+            _wakeup.notify_one();
+        }
+        if (_thread.joinable())
+            _thread.join();
+
+        // queue has no consumer anymore, so callers write their messages themselves
+        _is_stopped.store(true);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        _write_queued();
+    }
+
+    uint64_t Logger::dropped() const { return _dropped.value(); }
+    uint64_t Logger::written() const { return _written.value(); }
+
+    void Logger::_drain_logic() {
+        std::string buffer;
+        bool has_unflushed = false;
+        auto last_flush = std::chrono::steady_clock::now();
+
+        while (true) {
+            // read before draining, so everything logged before stop() is written
+            bool is_active = m_is_active.load();
+            auto max_level = crow::LogLevel::Debug;
+            size_t count = _pop_batch(buffer, max_level);
+
+            {
+                std::lock_guard lock(_mutex);
+                auto now = std::chrono::steady_clock::now();
+
+                for (const auto& os : _ostreams)
+                    os->write(buffer.data(), (std::streamsize) buffer.size());
+                has_unflushed = has_unflushed || count != 0;
+
+                bool needs_flush = (count != 0 && max_level >= _policy.level)
+                    || now - last_flush >= _policy.interval
+                    || !is_active;
+                if (has_unflushed && needs_flush) {
+                    for (const auto& os : _ostreams)
+                        os->flush();
+
+                    has_unflushed = false;
+                    last_flush = now;
+                }
+            }
+            _written.inc(count);
+
+            if (count != 0)
+                continue;
+            if (!is_active)
+                break;
+
+            // sleeps until message comes, logger stops or unflushed data is due
+            _is_idle.store(true);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            {
+                std::unique_lock lock(_mutex);
+                auto is_woken = [this] { return !m_queue.is_empty() || !m_is_active.load(); };
+
+                if (has_unflushed)
+                    _wakeup.wait_until(lock, last_flush + _policy.interval, is_woken);
+                else
+                    _wakeup.wait(lock, is_woken);
+            }
+            _is_idle.store(false);
+        }
+    }
+
+    void Logger::_write_queued() {
         std::lock_guard lock(_mutex);
-        auto output = lib::format("({:%F %T})[{:<8}] {}\n",
-            std::chrono::floor<std::chrono::seconds>(std::chrono::system_clock::now()),
-            logger_convert::level_to_string(level),
-            std::move(message)
-        );
+        std::string buffer;
+        auto max_level = crow::LogLevel::Debug;
 
+        while (size_t count = _pop_batch(buffer, max_level)) {
+            for (const auto& os : _ostreams)
+                os->write(buffer.data(), (std::streamsize) buffer.size());
+            _written.inc(count);
+        }
         for (const auto& os : _ostreams)
-            *os << output << std::flush;
+            os->flush();
+    }
+
+    size_t Logger::_pop_batch(std::string& buffer, crow::LogLevel& max_level) {
+        entry_t entry;
+        size_t count = 0;
+
+        buffer.clear();
+        while (count < max_batch_size && m_queue.try_pop(entry)) {
+            buffer += lib::format("({:%F %T})[{:<8}] {}\n",
+                std::chrono::floor<std::chrono::seconds>(entry.time),
+                logger_convert::level_to_string(entry.level),
+                std::move(entry.message)
+            );
+            max_level = std::max(max_level, entry.level);
+            count++;
+        }
+
+        return count;
     }
 }
@@ -1,23 +1,89 @@
 #pragma once
 
 //std
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <list>
 #include <mutex>
 #include <ostream>
 #include <string>
+#include <thread>
 
 //crow
 #include "crow/logging.h"
 
+//library
+#include "library/metrics.hpp"
+#include "library/mpsc_queue.hpp"
+
 namespace backend {
+    // request threads only put message into lock-free queue,
+    // formatting and writing is done by background thread in batches.
+    // when queue is full message is dropped and counted instead of blocking.
+    // background thread sleeps while queue is empty, producers wake it only then
     class Logger : public crow::ILogHandler {
     public:
+        using clock = std::chrono::system_clock;
+
+        static constexpr size_t default_capacity = 8192;
+        static constexpr size_t max_batch_size = 256;
+
+        struct flush_policy_t {
+            // streams are flushed at least this often
+            std::chrono::milliseconds interval = std::chrono::milliseconds(1000);
+            // and right after batch with message of this level or higher
+            crow::LogLevel level = crow::LogLevel::Warning;
+        };
+
+        explicit Logger(size_t capacity = default_capacity);
+        ~Logger() override;
+
         void add_log_stream(std::ostream& stream);
+        void set_flush_policy(flush_policy_t policy);
 
         void log(std::string message, crow::LogLevel level) override;
 
+        // writes everything queued so far and stops background thread, called by destructor.
+        // messages logged afterwards are written by calling thread
+        void stop();
+
+        uint64_t dropped() const;
+        uint64_t written() const;
+
+        // deleted members
+
+        Logger(const Logger&) = delete;
+        Logger& operator=(const Logger&) = delete;
+
+    protected:
+        struct entry_t {
+            std::string message;
+            crow::LogLevel level;
+            clock::time_point time;
+        };
+
+        lib::MpscQueue<entry_t> m_queue;
+        std::atomic_bool m_is_active = true;
+
     private:
+        // guards streams and policy, taken by background thread and setters.
+        // producers take it only to wake idle background thread
         std::mutex _mutex;
+        std::condition_variable _wakeup;
+        std::atomic_bool _is_idle = false, _is_stopped = false;
         std::list<std::ostream*> _ostreams;
+        flush_policy_t _policy;
+
+        lib::Counter& _dropped;
+        lib::Counter& _written;
+
+        std::thread _thread;
+
+        void _drain_logic();
+        // writes and flushes everything queued by calling thread, used after background thread is stopped
+        void _write_queued();
+        // formats up to max_batch_size messages into buffer, returns their amount
+        size_t _pop_batch(std::string& buffer, crow::LogLevel& max_level);
     };
 }
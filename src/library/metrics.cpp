@@ -0,0 +1,212 @@
+#include "library/metrics.hpp"
+
+//std
+#include <algorithm>
+#include <bit>
+
+//library
+#include "library/format.hpp"
+
+namespace lib::metrics_details {
+    // edges of exported buckets are edges of power of 2 blocks, so every bucket lies below one of them
+    constexpr uint64_t first_exported_edge = 1024;
+
+    std::string with_label(const std::string& labels, const std::string& extra) {
+        if (labels.empty())
+            return lib::format("{{{}}}", extra);
+        return lib::format("{{{},{}}}", labels, extra);
+    }
+    std::string wrap_labels(const std::string& labels) {
+        return labels.empty() ? std::string() : lib::format("{{{}}}", labels);
+    }
+}
+
+namespace lib {
+    // Counter
+
+    void Counter::inc(uint64_t value) { _value.fetch_add(value, std::memory_order_relaxed); }
+    uint64_t Counter::value() const { return _value.load(std::memory_order_relaxed); }
+
+    // Gauge
+
+    void Gauge::set(int64_t value) { _value.store(value, std::memory_order_relaxed); }
+    void Gauge::add(int64_t value) { _value.fetch_add(value, std::memory_order_relaxed); }
+    int64_t Gauge::value() const { return _value.load(std::memory_order_relaxed); }
+
+    // Histogram
+
+    void Histogram::record(std::chrono::nanoseconds duration) {
+        record((uint64_t) std::max<int64_t>(duration.count(), 0));
+    }
+    void Histogram::record(uint64_t ns) {
+        _buckets[index_of(ns)].fetch_add(1, std::memory_order_relaxed);
+        _count.fetch_add(1, std::memory_order_relaxed);
+        _sum.fetch_add(ns, std::memory_order_relaxed);
+    }
+
+    uint64_t Histogram::count() const { return _count.load(std::memory_order_relaxed); }
+    uint64_t Histogram::sum() const { return _sum.load(std::memory_order_relaxed); }
+    uint64_t Histogram::bucket(size_t index) const { return _buckets[index].load(std::memory_order_relaxed); }
+
+    double Histogram::quantile(double q) const {
+        std::array<uint64_t, bucket_count> snapshot;
+        uint64_t total = 0;
+
+        // count may be ahead of buckets during concurrent recording, so buckets are summed instead
+        for (size_t i = 0; i < bucket_count; i++) {
+            snapshot[i] = _buckets[i].load(std::memory_order_relaxed);
+            total += snapshot[i];
+        }
+        if (total == 0)
+            return 0.0;
+
+        auto rank = (uint64_t) std::max(1.0, q * (double) total + 0.5);
+        rank = std::min(rank, total);
+
+        uint64_t seen = 0;
+        for (size_t i = 0; i < bucket_count; i++) {
+            seen += snapshot[i];
+            if (seen >= rank)
+                return ((double) lower_bound_of(i) + (double) upper_bound_of(i)) / 2.0;
+        }
+
+        return (double) upper_bound_of(bucket_count - 1);
+    }
+
+    // first 32 buckets hold exact values, then every block of 32 buckets covers one power of 2
+    size_t Histogram::index_of(uint64_t ns) {
+        if (ns < sub_bucket_count)
+            return ns;
+
+        size_t msb = std::bit_width(ns) - 1;
+        size_t shift = msb - sub_bucket_bits;
+        size_t index = ((shift + 1) << sub_bucket_bits) | ((ns >> shift) & (sub_bucket_count - 1));
+
+        return std::min(index, bucket_count - 1);
+    }
+    uint64_t Histogram::lower_bound_of(size_t index) {
+        size_t block = index >> sub_bucket_bits;
+        uint64_t sub = index & (sub_bucket_count - 1);
+
+        return block == 0 ? sub : (sub | sub_bucket_count) << (block - 1);
+    }
+    uint64_t Histogram::upper_bound_of(size_t index) {
+        size_t block = index >> sub_bucket_bits;
+        return lower_bound_of(index) + (block == 0 ? 1 : 1ul << (block - 1));
+    }
+
+    // ScopedTimer
+
+    ScopedTimer::ScopedTimer(Histogram& histogram) :
+        _histogram(histogram),
+        _start(std::chrono::steady_clock::now()) {
+    }
+    ScopedTimer::~ScopedTimer() {
+        stop();
+    }
+
+    void ScopedTimer::stop() {
+        if (_is_stopped)
+            return;
+
+        _histogram.record(std::chrono::steady_clock::now() - _start);
+        _is_stopped = true;
+    }
+
+    // MetricsRegistry
+
+    MetricsRegistry& MetricsRegistry::instance() {
+        static MetricsRegistry registry;
+        return registry;
+    }
+
+    Counter& MetricsRegistry::counter(const std::string& name, const std::string& labels, const std::string& help) {
+        std::lock_guard lock(_mutex);
+        auto& ptr = _family(name, Type::Counter, help).counters[labels];
+        if (!ptr)
+            ptr = std::make_unique<Counter>();
+        return *ptr;
+    }
+    Gauge& MetricsRegistry::gauge(const std::string& name, const std::string& labels, const std::string& help) {
+        std::lock_guard lock(_mutex);
+        auto& ptr = _family(name, Type::Gauge, help).gauges[labels];
+        if (!ptr)
+            ptr = std::make_unique<Gauge>();
+        return *ptr;
+    }
+    Histogram& MetricsRegistry::histogram(const std::string& name, const std::string& labels, const std::string& help) {
+        std::lock_guard lock(_mutex);
+        auto& ptr = _family(name, Type::Histogram, help).histograms[labels];
+        if (!ptr)
+            ptr = std::make_unique<Histogram>();
+        return *ptr;
+    }
+
+    std::string MetricsRegistry::to_prometheus() const {
+        using namespace metrics_details;
+
+        std::lock_guard lock(_mutex);
+        std::string result;
+
+        for (const auto& [name, family] : m_families) {
+            if (!family.help.empty())
+                result += lib::format("# HELP {} {}\n", name, family.help);
+
+            switch (family.type) {
+            case Type::Counter:
+                result += lib::format("# TYPE {} counter\n", name);
+                for (const auto& [labels, value] : family.counters)
+                    result += lib::format("{}{} {}\n", name, wrap_labels(labels), value->value());
+                break;
+            case Type::Gauge:
+                result += lib::format("# TYPE {} gauge\n", name);
+                for (const auto& [labels, value] : family.gauges)
+                    result += lib::format("{}{} {}\n", name, wrap_labels(labels), value->value());
+                break;
+            case Type::Histogram:
+                // values are kept in ns, prometheus expects base units
+                result += lib::format("# TYPE {} histogram\n", name);
+                for (const auto& [labels, value] : family.histograms) {
+                    uint64_t cumulative = 0;
+                    size_t index = 0;
+
+                    for (uint64_t edge = first_exported_edge; edge <= Histogram::upper_bound_of(Histogram::bucket_count - 1); edge <<= 1) {
+                        while (index < Histogram::bucket_count && Histogram::upper_bound_of(index) <= edge)
+                            cumulative += value->bucket(index++);
+                        result += lib::format("{}_bucket{} {}\n",
+                            name, with_label(labels, lib::format("le=\"{}\"", (double) edge / 1e9)), cumulative);
+                    }
+                    while (index < Histogram::bucket_count)
+                        cumulative += value->bucket(index++);
+
+                    // count is taken from buckets, so it's equal to +Inf one during concurrent recording
+                    result += lib::format("{}_bucket{} {}\n", name, with_label(labels, "le=\"+Inf\""), cumulative);
+                    result += lib::format("{}_sum{} {:.9f}\n", name, wrap_labels(labels), (double) value->sum() / 1e9);
+                    result += lib::format("{}_count{} {}\n", name, wrap_labels(labels), cumulative);
+                }
+                break;
+            }
+        }
+
+        return result;
+    }
+
+    MetricsRegistry::family_t& MetricsRegistry::_family(const std::string& name, Type type, const std::string& help) {
+        auto [it, is_inserted] = m_families.try_emplace(name);
+
+        if (is_inserted) {
+            it->second.type = type;
+            it->second.help = help;
+        } else if (it->second.type != type)
+            throw FMT_RUNTIME_ERROR("metric {} is already registered with other type", name);
+
+        return it->second;
+    }
+
+    Histogram& stage_histogram(const std::string& stage) {
+        return metrics().histogram(
+            "zzz_stage_duration_seconds",
+            lib::format("stage=\"{}\"", stage),
+            "Time spent in every stage of request processing");
+    }
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+//std
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace lib {
+    // every metric is updated with relaxed atomics only,
+    // registry lock is taken on registration and on export
+
+    class Counter {
+    public:
+        void inc(uint64_t value = 1);
+        uint64_t value() const;
+
+    private:
+        std::atomic_uint64_t _value = 0;
+    };
+
+    class Gauge {
+    public:
+        void set(int64_t value);
+        void add(int64_t value);
+        int64_t value() const;
+
+    private:
+        std::atomic_int64_t _value = 0;
+    };
+
+    // log-linear histogram in the spirit of HdrHistogram:
+    // every power of 2 is split into 32 linear sub buckets, so relative error is ~3%,
+    // range is 1 ns .. ~18 min, values above it go to the last bucket
+    class Histogram {
+    public:
+        static constexpr size_t sub_bucket_bits = 5;
+        static constexpr size_t sub_bucket_count = 1ul << sub_bucket_bits;
+        static constexpr size_t max_value_bits = 40;
+        static constexpr size_t bucket_count = (max_value_bits - sub_bucket_bits + 1) * sub_bucket_count;
+
+        void record(std::chrono::nanoseconds duration);
+        void record(uint64_t ns);
+
+        uint64_t count() const;
+        // in nanoseconds
+        uint64_t sum() const;
+        uint64_t bucket(size_t index) const;
+        // in nanoseconds, q is in [0, 1]
+        double quantile(double q) const;
+
+        static size_t index_of(uint64_t ns);
+        static uint64_t lower_bound_of(size_t index);
+        static uint64_t upper_bound_of(size_t index);
+
+    private:
+        std::array<std::atomic_uint64_t, bucket_count> _buckets = {};
+        std::atomic_uint64_t _count = 0, _sum = 0;
+    };
+
+    // records time between construction and destruction (or stop)
+    class ScopedTimer {
+    public:
+        explicit ScopedTimer(Histogram& histogram);
+        ~ScopedTimer();
+
+        void stop();
+
+        ScopedTimer(const ScopedTimer&) = delete;
+        ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+    private:
+        Histogram& _histogram;
+        std::chrono::steady_clock::time_point _start;
+        bool _is_stopped = false;
+    };
+
+    // exports everything in prometheus text format (version 0.0.4),
+    // histograms are exported with cumulative buckets at every power of 2 of ns from 1 us
+    class MetricsRegistry {
+    public:
+        static MetricsRegistry& instance();
+
+        // returned references stay valid for whole lifetime of program,
+        // so callers are expected to keep them instead of looking up every time.
+        // labels are written as is: route="POST /damage",code="200"
+        Counter& counter(const std::string& name, const std::string& labels = {}, const std::string& help = {});
+        Gauge& gauge(const std::string& name, const std::string& labels = {}, const std::string& help = {});
+        Histogram& histogram(const std::string& name, const std::string& labels = {}, const std::string& help = {});
+
+        std::string to_prometheus() const;
+
+        // deleted members
+
+        MetricsRegistry(const MetricsRegistry&) = delete;
+        MetricsRegistry& operator=(const MetricsRegistry&) = delete;
+
+    protected:
+        enum class Type : uint8_t { Counter, Gauge, Histogram };
+
+        struct family_t {
+            Type type;
+            std::string help;
+            std::map<std::string, std::unique_ptr<Counter>> counters;
+            std::map<std::string, std::unique_ptr<Gauge>> gauges;
+            std::map<std::string, std::unique_ptr<Histogram>> histograms;
+        };
+
+        std::map<std::string, family_t> m_families;
+
+    private:
+        mutable std::mutex _mutex;
+
+        MetricsRegistry() = default;
+
+        family_t& _family(const std::string& name, Type type, const std::string& help);
+    };
+
+    inline MetricsRegistry& metrics() { return MetricsRegistry::instance(); }
+
+    // request processing stages: parse, compose, stats, eval, serialize
+    Histogram& stage_histogram(const std::string& stage);
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+//std
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <memory>
+#include <new>
+
+namespace lib {
+    // bounded lock-free queue for many producers and one consumer (D. Vyukov's scheme):
+    // every slot keeps sequence number telling whether it is free for position or already filled.
+    // push never blocks, it fails when queue is full
+    template<typename T>
+    class MpscQueue {
+    public:
+        explicit MpscQueue(size_t capacity) :
+            m_capacity(std::bit_ceil(std::max<size_t>(capacity, 2))),
+            m_mask(m_capacity - 1),
+            m_slots(new slot_t[m_capacity]) {
+            for (size_t i = 0; i < m_capacity; i++)
+                m_slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+
+        size_t capacity() const { return m_capacity; }
+
+        // any thread
+        bool try_push(T&& value) {
+            size_t pos = _head.load(std::memory_order_relaxed);
+
+            while (true) {
+                auto& slot = m_slots[pos & m_mask];
+                size_t sequence = slot.sequence.load(std::memory_order_acquire);
+                auto diff = (intptr_t) sequence - (intptr_t) pos;
+
+                if (diff == 0) {
+                    if (_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                        slot.value = std::move(value);
+                        slot.sequence.store(pos + 1, std::memory_order_release);
+                        return true;
+                    }
+                } else if (diff < 0)
+                    return false;
+                else
+                    pos = _head.load(std::memory_order_relaxed);
+            }
+        }
+
+        // consumer thread only
+        bool try_pop(T& value) {
+            auto& slot = m_slots[_tail & m_mask];
+            size_t sequence = slot.sequence.load(std::memory_order_acquire);
+
+            if ((intptr_t) sequence - (intptr_t) (_tail + 1) < 0)
+                return false;
+
+            value = std::move(slot.value);
+            slot.sequence.store(_tail + m_capacity, std::memory_order_release);
+            _tail++;
+
+            return true;
+        }
+
+        // consumer thread only, message which is being pushed right now isn't seen
+        bool is_empty() const {
+            size_t sequence = m_slots[_tail & m_mask].sequence.load(std::memory_order_acquire);
+            return (intptr_t) sequence - (intptr_t) (_tail + 1) < 0;
+        }
+
+        // deleted members
+
+        MpscQueue(const MpscQueue&) = delete;
+        MpscQueue& operator=(const MpscQueue&) = delete;
+
+    protected:
+        struct slot_t {
+            std::atomic_size_t sequence;
+            T value;
+        };
+
+        size_t m_capacity, m_mask;
+        std::unique_ptr<slot_t[]> m_slots;
+
+    private:
+        // producers and consumer touch different cache lines
+        alignas(64) std::atomic_size_t _head = 0;
+        alignas(64) size_t _tail = 0;
+    };
+}
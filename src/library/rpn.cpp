@@ -1,10 +1,12 @@
 #include "library/rpn.hpp"
 
 //std
+#include <algorithm>
+#include <bit>
 #include <charconv>
-#include <stack>
 
 //frozen
+#include "frozen/string.h"
 #include "frozen/unordered_map.h"
 #include "frozen/unordered_set.h"
 
@@ -15,10 +17,10 @@
 using namespace lib::rpn_parser;
 
 namespace lib::rpn_details {
-    constexpr frozen::unordered_set<TokenType, 14> primitive_tokens = {
+    constexpr frozen::unordered_set<TokenType, 17> primitive_tokens = {
         Plus, Minus, Star, Slash, Percent,
         Equal, Less, More, LParen, RParen, And, Or,
-        LessEq, MoreEq
+        LessEq, MoreEq, Comma, Question, Colon
     };
     constexpr frozen::unordered_set<TokenType, 12> math_operators = {
         Plus, Minus, Star, Slash, Percent, Less, More, Equal, And, Or, LessEq, MoreEq
@@ -30,106 +32,291 @@ namespace lib::rpn_details {
         { Less, 4 }, { More, 4 }, { LessEq, 4 }, { MoreEq, 4 },
         { Equal, 5 }
     };
+    constexpr frozen::unordered_map<frozen::string, TokenType, 3> functions = {
+        { "min", Min }, { "max", Max }, { "clamp", Clamp }
+    };
+    constexpr bool is_function(TokenType type) {
+        return type == Min || type == Max || type == Clamp;
+    }
 
-    std::tuple<double, std::string, size_t> parse_number(size_t index, std::string_view src) {
+    const charset_t whitespace = make_charset(" \t\n");
+
+    std::tuple<double, std::string_view, size_t> parse_number(size_t index, std::string_view src) {
         double number;
         auto [ptr, ec] = std::from_chars(src.data() + index, src.data() + src.size(), number);
 
         if (ec != std::errc())
             throw FMT_RUNTIME_ERROR("bad number parse: {}", (size_t) ec);
 
-        return { number, std::string(src.data() + index, ptr), (uintptr_t) ptr - ((uintptr_t) src.data() + index) };
+        size_t length = ptr - (src.data() + index);
+        return { number, src.substr(index, length), length };
     }
-    std::tuple<std::string, size_t> parse_literal(size_t start, std::string_view src) {
+    std::tuple<std::string_view, size_t> parse_literal(size_t start, std::string_view src) {
         // we already know that index is first alpha character
         size_t i = start + 1;
 
         while (i < src.size() && (isalnum(src[i]) || src[i] == '_'))
             i++;
 
-        return { std::string(src.data() + start, src.data() + i), i - start };
+        return { src.substr(start, i - start), i - start };
+    }
+    // first character from index which isn't whitespace, '\0' at the end
+    char peek(size_t index, std::string_view src) {
+        while (index < src.size() && whitespace[(uint8_t) src[index]])
+            index++;
+
+        return index < src.size() ? src[index] : '\0';
     }
 }
 
 namespace lib {
     token_list RpnParser::tokenize(std::string_view what) {
         token_list result;
-        auto copy = remove_chars(what, " \t\n");
+        // every token takes at least one character
+        result.reserve(what.size());
 
         size_t i = 0, di;
-        while (i < copy.size()) {
-            if (copy[i] == '<' && copy[i + 1] == '=') {
-                di = 2;
-                result.emplace_back(LessEq, "<=");
-            } else if (copy[i] == '>' && copy[i + 1] == '=') {
-                di = 2;
-                result.emplace_back(MoreEq, ">=");
-            } else if (rpn_details::primitive_tokens.contains((TokenType) copy[i])) {
+        while (i < what.size()) {
+            if (rpn_details::whitespace[(uint8_t) what[i]]) {
+                i++;
+                continue;
+            }
+
+            if ((what[i] == '<' || what[i] == '>') && rpn_details::peek(i + 1, what) == '=') {
+                // whitespace between '<' and '=' is skipped too
+                di = what.find('=', i) - i + 1;
+                if (what[i] == '<')
+                    result.emplace_back(LessEq, "<=");
+                else
+                    result.emplace_back(MoreEq, ">=");
+            } else if (rpn_details::primitive_tokens.contains((TokenType) what[i])) {
                 di = 1;
-                result.emplace_back((TokenType) copy[i], std::string(1, copy[i]));
-            } else if ((copy[i] >= '0' && copy[i] <= '9') || copy[i] == '-') {
+                result.emplace_back((TokenType) what[i], what.substr(i, 1));
+            } else if ((what[i] >= '0' && what[i] <= '9') || what[i] == '-') {
                 token_t token;
-                std::tie(token.number, token.literal, di) = rpn_details::parse_number(i, copy);
+                std::tie(token.number, token.literal, di) = rpn_details::parse_number(i, what);
                 token.type = Number;
-                result.emplace_back(std::move(token));
-            } else if (isalpha(copy[i])) {
+                result.emplace_back(token);
+            } else if (isalpha(what[i])) {
                 token_t token;
-                std::tie(token.literal, di) = rpn_details::parse_literal(i, copy);
+                std::tie(token.literal, di) = rpn_details::parse_literal(i, what);
                 token.type = Variable;
-                result.emplace_back(std::move(token));
-            }
+
+                // literal followed by '(' is function call
+                if (rpn_details::peek(i + di, what) == '(') {
+                    auto it = rpn_details::functions.find(frozen::string(token.literal.data(), token.literal.size()));
+                    if (it == rpn_details::functions.end())
+                        throw FMT_RUNTIME_ERROR("unknown function {}", token.literal);
+                    token.type = it->second;
+                }
+
+                result.emplace_back(token);
+            } else
+                throw FMT_RUNTIME_ERROR("unexpected character '{}' in formula", what[i]);
 
             i += di;
-            di = 0;
         }
 
         return result;
     }
     tokenized_rpn_t RpnParser::shunting_yard_algorithm(const token_list& infix) {
         tokenized_rpn_t rpn;
-        std::stack<token_t> stack;
+        rpn.reserve(infix.size());
+        // operators waiting for their operands, top is back
+        std::vector<token_t> stack;
+        stack.reserve(infix.size());
 
         auto get_precedence = [](TokenType type) {
             auto it = rpn_details::precedence.find(type);
             return it != rpn_details::precedence.end() ? it->second : 0;
         };
 
-        for (auto token : infix) {
+        // moves operators into rpn until '(' or unfinished '?'
+        auto pop_until_paren = [&]() {
+            while (!stack.empty() && stack.back().type != LParen && stack.back().type != Question) {
+                rpn.emplace_back(stack.back());
+                stack.pop_back();
+            }
+        };
+
+        for (const auto& token : infix) {
             if (token.type == Number || token.type == Variable) {
-                rpn.emplace_back(std::move(token));
-            } else if (token.type == LParen) { // '('
-                stack.emplace(std::move(token));
+                rpn.emplace_back(token);
+            } else if (rpn_details::is_function(token.type) || token.type == LParen) { // '('
+                stack.emplace_back(token);
             } else if (token.type == RParen) { // ')'
-                while (!stack.empty() && stack.top().type != LParen) {
-                    rpn.emplace_back(std::move(stack.top()));
-                    stack.pop();
-                }
+                pop_until_paren();
+                if (stack.empty() || stack.back().type != LParen)
+                    throw RUNTIME_ERROR("bad infix to rpn parse");
                 // pop '('
-                stack.pop();
+                stack.pop_back();
+
+                if (!stack.empty() && rpn_details::is_function(stack.back().type)) {
+                    rpn.emplace_back(stack.back());
+                    stack.pop_back();
+                }
+            } else if (token.type == Comma) {
+                pop_until_paren();
+            } else if (token.type == Question) {
+                // the lowest precedence and right associative, so nested Select stays on stack
+                while (!stack.empty() && stack.back().type != LParen
+                    && stack.back().type != Question && stack.back().type != Select) {
+                    rpn.emplace_back(stack.back());
+                    stack.pop_back();
+                }
+                stack.emplace_back(token);
+            } else if (token.type == Colon) {
+                pop_until_paren();
+                if (stack.empty() || stack.back().type != Question)
+                    throw RUNTIME_ERROR("':' without '?' in formula");
+                stack.back() = { Select, "?:" };
             } else if (rpn_details::math_operators.contains(token.type)) {
                 size_t own_precedence = get_precedence(token.type);
                 while (!stack.empty()) {
-                    auto& top = stack.top();
+                    const auto& top = stack.back();
                     if (top.type == LParen || own_precedence > get_precedence(top.type))
                         break;
 
-                    rpn.emplace_back(std::move(top));
-                    stack.pop();
+                    rpn.emplace_back(top);
+                    stack.pop_back();
                 }
-                stack.push(std::move(token));
+                stack.emplace_back(token);
             } else
                 throw RUNTIME_ERROR("bad infix to rpn parse");
         }
 
         while (!stack.empty()) {
-            if (stack.top().type == LParen)
+            if (stack.back().type == LParen)
                 break;
+            if (stack.back().type == Question)
+                throw RUNTIME_ERROR("'?' without ':' in formula");
 
-            rpn.emplace_back(std::move(stack.top()));
-            stack.pop();
+            rpn.emplace_back(stack.back());
+            stack.pop_back();
         }
 
-        rpn.shrink_to_fit();
         return rpn;
     }
+
+    // RpnCompiler
+
+    RpnCompiler::RpnCompiler(resolver_t resolver) :
+        _resolver(std::move(resolver)) {
+    }
+
+    uint16_t RpnCompiler::add(const tokenized_rpn_t& rpn) {
+        std::vector<uint16_t> stack;
+
+        for (const auto& it : rpn) {
+            if (it.type == Number) {
+                stack.emplace_back(add_number(it.number));
+                continue;
+            }
+            if (it.type == Variable) {
+                stack.emplace_back(add_variable(_resolver(it.literal)));
+                continue;
+            }
+
+            size_t count = rpn_parser::arity(it.type);
+            if (stack.size() < count)
+                throw FMT_RUNTIME_ERROR("operator {} lacks operands", it.literal);
+
+            std::array<uint16_t, 3> args = {};
+            std::copy(stack.end() - count, stack.end(), args.begin());
+            stack.resize(stack.size() - count);
+            stack.emplace_back(add_op(it.type, args[0], args[1], args[2]));
+        }
+
+        if (stack.size() != 1)
+            throw FMT_RUNTIME_ERROR("remaining stack size after rpn compilation is {}", stack.size());
+
+        return stack.back();
+    }
+    uint16_t RpnCompiler::add_number(double number) {
+        return _emplace({ .type = Number, .number = number });
+    }
+    uint16_t RpnCompiler::add_variable(uint32_t variable) {
+        return _emplace({ .type = Variable, .variable = variable });
+    }
+    uint16_t RpnCompiler::add_op(rpn_token_type type, uint16_t first, uint16_t second, uint16_t third) {
+        size_t count = rpn_parser::arity(type);
+        if (count == 0)
+            throw RUNTIME_ERROR("operator is expected");
+
+        // dead branches
+        if (type == Select) {
+            if (_is_number(first))
+                return _nodes[first].number != 0.0 ? second : third;
+            if (second == third)
+                return second;
+        }
+        if ((type == Min || type == Max) && first == second)
+            return first;
+        if (type == And && ((_is_number(first) && _nodes[first].number == 0.0) || (_is_number(second) && _nodes[second].number == 0.0)))
+            return add_number(0.0);
+        if (type == Or && ((_is_number(first) && _nodes[first].number != 0.0) || (_is_number(second) && _nodes[second].number != 0.0)))
+            return add_number(1.0);
+
+        // constant folding
+        bool is_constant = _is_number(first) && _is_number(second) && (count < 3 || _is_number(third));
+        if (is_constant) {
+            double result = count == 3
+                ? switch_math_op(_nodes[first].number, _nodes[second].number, _nodes[third].number, type)
+                : switch_math_op(_nodes[first].number, _nodes[second].number, type);
+            return add_number(result);
+        }
+
+        return _emplace({ .type = type, .args = { first, second, count == 3 ? third : (uint16_t) 0 } });
+    }
+
+    rpn_program_t RpnCompiler::compile(uint16_t root) const {
+        if (root >= _nodes.size())
+            throw RUNTIME_ERROR("node doesn't exist");
+
+        // operands always precede node, so one backward pass marks everything root needs
+        std::vector<bool> is_used(root + 1, false);
+        is_used[root] = true;
+        for (size_t i = root + 1; i-- > 0;) {
+            if (!is_used[i])
+                continue;
+            for (size_t j = 0; j < rpn_parser::arity(_nodes[i].type); j++)
+                is_used[_nodes[i].args[j]] = true;
+        }
+
+        rpn_program_t result;
+        std::vector<uint16_t> registers(root + 1);
+        for (size_t i = 0; i <= root; i++) {
+            if (!is_used[i])
+                continue;
+
+            auto op = _nodes[i];
+            for (size_t j = 0; j < rpn_parser::arity(op.type); j++)
+                op.args[j] = registers[op.args[j]];
+
+            registers[i] = (uint16_t) result.size();
+            result.emplace_back(op);
+        }
+
+        return result;
+    }
+
+    uint16_t RpnCompiler::_emplace(const rpn_op_t& op) {
+        auto key = std::make_tuple((uint8_t) op.type, op.args[0], op.args[1], op.args[2],
+            std::bit_cast<uint64_t>(op.number), op.variable);
+
+        auto it = _known.find(key);
+        if (it != _known.end())
+            return it->second;
+
+        if (_nodes.size() > UINT16_MAX)
+            throw RUNTIME_ERROR("formula is too long");
+
+        auto index = (uint16_t) _nodes.size();
+        _nodes.emplace_back(op);
+        _known.emplace(key, index);
+        return index;
+    }
+    bool RpnCompiler::_is_number(uint16_t node) const {
+        return _nodes[node].type == Number;
+    }
 }
@@ -1,28 +1,55 @@
 #pragma once
 
 //std
+#include <algorithm>
+#include <array>
 #include <cstdint>
-#include <string>
+#include <functional>
+#include <map>
+#include <span>
+#include <string_view>
+#include <tuple>
 #include <vector>
 
+//library
+#include "library/format.hpp"
+#include "library/template_math.hpp"
+
 namespace lib::rpn_parser {
     enum TokenType : uint8_t {
         None   = 0,
         Plus   = '+', Minus  = '-', Star = '*', Slash = '/', Percent = '%',
         Equal  = '=', Less   = '<', More = '>', And   = '&', Or      = '|',
-        LParen = '(', RParen = ')',
+        LParen = '(', RParen = ')', Comma = ',',
+        // "cond ? a : b" becomes Select in rpn
+        Question = '?', Colon = ':',
 
         LessEq = 0x80, MoreEq   = 0x81,
-        Number = 0x82, Variable = 0x83
+        Number = 0x82, Variable = 0x83,
+
+        // functions, min(a, b), max(a, b), clamp(value, low, high)
+        Min = 0x84, Max = 0x85, Clamp = 0x86,
+        // cond, a, b
+        Select = 0x87
     };
 
+    // literal views source of RpnParser::tokenize, so source has to outlive tokens
     struct token_t {
         TokenType type;
-        std::string literal;
+        std::string_view literal;
         double number = 0.0;
     };
 
     using token_list = std::vector<token_t>;
+
+    // amount of operands which operator takes from stack
+    constexpr size_t arity(TokenType type) {
+        switch (type) {
+        case Number: case Variable: return 0;
+        case Clamp: case Select: return 3;
+        default: return 2;
+        }
+    }
 }
 
 namespace lib {
@@ -30,9 +57,159 @@ namespace lib {
     using rpn_token_t = rpn_parser::token_t;
     using tokenized_rpn_t = std::vector<rpn_token_t>;
 
+    // instruction of compiled program. every instruction writes its own register
+    // and reads registers of previous ones, so shared subexpressions are computed once
+    struct rpn_op_t {
+        rpn_token_type type;
+        // registers of operands, first rpn_parser::arity(type) are used
+        std::array<uint16_t, 3> args = {};
+        double number = 0.0;
+        // index given by resolver of RpnCompiler
+        uint32_t variable = 0;
+    };
+    // result is register of last instruction
+    using rpn_program_t = std::vector<rpn_op_t>;
+
     class RpnParser {
     public:
         static rpn_parser::token_list tokenize(std::string_view what);
         static tokenized_rpn_t shunting_yard_algorithm(const rpn_parser::token_list& infix);
     };
+
+    // builds one program out of several rpn expressions.
+    // nodes with constant operands are folded, branches of Select with constant condition
+    // are dropped and equal nodes are added once, even when they come from different expressions
+    class RpnCompiler {
+    public:
+        using resolver_t = std::function<uint32_t(std::string_view)>;
+
+        explicit RpnCompiler(resolver_t resolver);
+
+        // node of whole expression
+        uint16_t add(const tokenized_rpn_t& rpn);
+        uint16_t add_number(double number);
+        uint16_t add_variable(uint32_t variable);
+        uint16_t add_op(rpn_token_type type, uint16_t first, uint16_t second, uint16_t third = 0);
+
+        // instructions which root depends on, in order of adding
+        rpn_program_t compile(uint16_t root) const;
+
+    private:
+        resolver_t _resolver;
+        std::vector<rpn_op_t> _nodes;
+        // type, operands, bits of number, variable
+        std::map<std::tuple<uint8_t, uint16_t, uint16_t, uint16_t, uint64_t, uint32_t>, uint16_t> _known;
+
+        uint16_t _emplace(const rpn_op_t& op);
+        bool _is_number(uint16_t node) const;
+    };
+
+    // variable(index) gives value of variable, registers have to fit whole program
+    template<typename F>
+    double eval_program(const rpn_program_t& program, F&& variable, std::span<double> registers) {
+        using namespace rpn_parser;
+
+        if (program.empty() || registers.size() < program.size())
+            throw RUNTIME_ERROR("program is empty or registers don't fit it");
+
+        for (size_t i = 0; i < program.size(); i++) {
+            const auto& op = program[i];
+            const auto& [a, b, c] = op.args;
+
+            switch (op.type) {
+            case Number:
+                registers[i] = op.number;
+                break;
+            case Variable:
+                registers[i] = variable(op.variable);
+                break;
+            case Clamp: case Select:
+                registers[i] = switch_math_op(registers[a], registers[b], registers[c], op.type);
+                break;
+            default:
+                registers[i] = switch_math_op(registers[a], registers[b], op.type);
+            }
+        }
+
+        return registers[program.size() - 1];
+    }
+    // registers are on stack unless program is long
+    template<typename F>
+    double eval_program(const rpn_program_t& program, F&& variable) {
+        static constexpr size_t inline_registers = 32;
+
+        if (program.size() <= inline_registers) {
+            std::array<double, inline_registers> registers;
+            return eval_program(program, std::forward<F>(variable), registers);
+        }
+
+        std::vector<double> registers(program.size());
+        return eval_program(program, std::forward<F>(variable), registers);
+    }
+
+    namespace rpn_details {
+        // one operator over lanes, code is constant so switch_math_op folds to a single case
+        // and loop is vectorized, results are the same as of eval_program lane by lane
+        template<uint8_t Code>
+        void apply_columns(double* result, const double* a, const double* b, const double* c, size_t lanes) {
+            if constexpr (rpn_parser::arity((rpn_token_type) Code) == 3) {
+                for (size_t i = 0; i < lanes; i++)
+                    result[i] = switch_math_op(a[i], b[i], c[i], Code);
+            } else {
+                for (size_t i = 0; i < lanes; i++)
+                    result[i] = switch_math_op(a[i], b[i], Code);
+            }
+        }
+    }
+
+    // runs program over result.size() independent inputs at once. registers are columns of lanes,
+    // so every instruction is decoded once per block instead of once per input.
+    // gather(variable, first, column) fills column with values of variable for inputs [first, first + column.size())
+    template<typename F>
+    void eval_program_columns(const rpn_program_t& program, F&& gather, std::span<double> result) {
+        using namespace rpn_parser;
+        static constexpr size_t block = 64;
+
+        if (program.empty())
+            throw RUNTIME_ERROR("program is empty");
+
+        std::vector<double> registers(program.size() * block);
+
+        for (size_t first = 0; first < result.size(); first += block) {
+            size_t lanes = std::min(block, result.size() - first);
+
+            for (size_t i = 0; i < program.size(); i++) {
+                const auto& op = program[i];
+                double* column = registers.data() + i * block;
+                const double* a = registers.data() + op.args[0] * block;
+                const double* b = registers.data() + op.args[1] * block;
+                const double* c = registers.data() + op.args[2] * block;
+
+                switch (op.type) {
+                case Number: std::fill_n(column, lanes, op.number); break;
+                case Variable: gather(op.variable, first, std::span<double>(column, lanes)); break;
+                case Plus: rpn_details::apply_columns<Plus>(column, a, b, c, lanes); break;
+                case Minus: rpn_details::apply_columns<Minus>(column, a, b, c, lanes); break;
+                case Star: rpn_details::apply_columns<Star>(column, a, b, c, lanes); break;
+                case Slash: rpn_details::apply_columns<Slash>(column, a, b, c, lanes); break;
+                case Percent: rpn_details::apply_columns<Percent>(column, a, b, c, lanes); break;
+                case Equal: rpn_details::apply_columns<Equal>(column, a, b, c, lanes); break;
+                case Less: rpn_details::apply_columns<Less>(column, a, b, c, lanes); break;
+                case More: rpn_details::apply_columns<More>(column, a, b, c, lanes); break;
+                case LessEq: rpn_details::apply_columns<LessEq>(column, a, b, c, lanes); break;
+                case MoreEq: rpn_details::apply_columns<MoreEq>(column, a, b, c, lanes); break;
+                case And: rpn_details::apply_columns<And>(column, a, b, c, lanes); break;
+                case Or: rpn_details::apply_columns<Or>(column, a, b, c, lanes); break;
+                case Min: rpn_details::apply_columns<Min>(column, a, b, c, lanes); break;
+                case Max: rpn_details::apply_columns<Max>(column, a, b, c, lanes); break;
+                case Clamp: rpn_details::apply_columns<Clamp>(column, a, b, c, lanes); break;
+                case Select: rpn_details::apply_columns<Select>(column, a, b, c, lanes); break;
+                default:
+                    throw RUNTIME_ERROR("this math operator doesn't exist");
+                }
+            }
+
+            std::copy_n(registers.data() + (program.size() - 1) * block, lanes, result.data() + first);
+        }
+    }
 }
@@ -1,17 +1,64 @@
 #pragma once
 
 //std
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <bitset>
 #include <charconv>
 #include <concepts>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
 #include <set>
 #include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
+//library
+#include "library/format.hpp"
+
+// crc64.hpp is included into namespace, so its std headers have to be included above
 namespace lib::ext {
 #include "library/crc64.hpp"
 }
 
 namespace lib {
+    // set of bytes, lookup is one bit test
+    using charset_t = std::bitset<256>;
+
+    inline charset_t make_charset(std::string_view chars) {
+        charset_t result;
+        for (char c : chars)
+            result.set((uint8_t) c);
+        return result;
+    }
+
+    // calls func for every part of source, parts are the same as of split_as_view
+    template<typename F>
+    void for_each_split(std::string_view source, char delim, F&& func) {
+        size_t pos = 0;
+
+        for (size_t i = 0; i < source.size(); i++) {
+            if (source[i] == delim) {
+                func(source.substr(pos, i - pos));
+                pos = i + 1;
+            }
+        }
+        if (pos != source.size())
+            func(source.substr(pos));
+    }
+    // divides on first delim, second part is empty when there's no delim
+    constexpr std::pair<std::string_view, std::string_view> split_once(std::string_view source, char delim) {
+        size_t pos = source.find(delim);
+        if (pos == std::string_view::npos)
+            return { source, {} };
+
+        return { source.substr(0, pos), source.substr(pos + 1) };
+    }
+
     inline std::vector<std::string_view> split_as_view(const std::string_view& source, char delim) {
         std::vector<std::string_view> result;
         size_t pos = 0;
@@ -61,26 +108,82 @@ namespace lib {
     }
 
     inline std::string remove_chars(std::string_view src, std::string_view charset) {
-        size_t size = src.size();
-        std::set on_removal(charset.begin(), charset.end());
+        auto on_removal = make_charset(charset);
 
         // calculating skipping characters to not make realloc during removal process
-        for (char c : src) {
-            if (on_removal.contains(c))
-                size--;
-        }
+        size_t size = std::ranges::count_if(src, [&](char c) { return !on_removal[(uint8_t) c]; });
 
         std::string result;
         result.reserve(size);
 
         for (char c : src) {
-            if (!on_removal.contains(c))
+            if (!on_removal[(uint8_t) c])
                 result.push_back(c);
         }
 
         return result;
     }
 
+    // standard alphabet with padding (rfc 4648)
+    inline std::string to_base64(std::string_view src) {
+        static constexpr std::string_view alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+        std::string result;
+        result.reserve((src.size() + 2) / 3 * 4);
+
+        for (size_t i = 0; i < src.size(); i += 3) {
+            size_t left = std::min<size_t>(src.size() - i, 3);
+            uint32_t chunk = (uint32_t) (uint8_t) src[i] << 16;
+            if (left > 1)
+                chunk |= (uint32_t) (uint8_t) src[i + 1] << 8;
+            if (left > 2)
+                chunk |= (uint8_t) src[i + 2];
+
+            result.push_back(alphabet[(chunk >> 18) & 0x3f]);
+            result.push_back(alphabet[(chunk >> 12) & 0x3f]);
+            result.push_back(left > 1 ? alphabet[(chunk >> 6) & 0x3f] : '=');
+            result.push_back(left > 2 ? alphabet[chunk & 0x3f] : '=');
+        }
+
+        return result;
+    }
+    inline std::string from_base64(std::string_view src) {
+        auto decode = [](char c) -> uint32_t {
+            if (c >= 'A' && c <= 'Z') return c - 'A';
+            if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+            if (c >= '0' && c <= '9') return c - '0' + 52;
+            if (c == '+') return 62;
+            if (c == '/') return 63;
+            throw FMT_RUNTIME_ERROR("'{}' isn't base64 character", c);
+        };
+
+        if (src.size() % 4 != 0)
+            throw FMT_RUNTIME_ERROR("base64 length {} isn't multiple of 4", src.size());
+
+        std::string result;
+        result.reserve(src.size() / 4 * 3);
+
+        for (size_t i = 0; i < src.size(); i += 4) {
+            size_t padding = (src[i + 3] == '=') + (src[i + 2] == '=');
+            if (padding != 0 && i + 4 != src.size())
+                throw RUNTIME_ERROR("base64 padding isn't at the end");
+
+            uint32_t chunk = decode(src[i]) << 18 | decode(src[i + 1]) << 12;
+            if (padding < 2)
+                chunk |= decode(src[i + 2]) << 6;
+            if (padding < 1)
+                chunk |= decode(src[i + 3]);
+
+            result.push_back((char) (chunk >> 16));
+            if (padding < 2)
+                result.push_back((char) (chunk >> 8));
+            if (padding < 1)
+                result.push_back((char) chunk);
+        }
+
+        return result;
+    }
+
     // TODO: error handling
     template<std::integral TResult>
     TResult sv_to(const std::string_view& str) {
@@ -88,14 +191,42 @@ namespace lib {
         auto err = std::from_chars(str.data(), str.data() + str.size(), result);
         return result;
     }
+    template<std::floating_point TResult>
+    TResult sv_to(const std::string_view& str) {
+        TResult result = 0.0;
+        auto err = std::from_chars(str.data(), str.data() + str.size(), result);
+        return result;
+    }
 
-    inline size_t hash(const std::string& what) {
-        return ext::crc64(0, what.data(), what.size());
+    // crc-64-jones, values are stable between runs and platforms
+    constexpr size_t hash(const char* what, size_t length) {
+        return ext::crc64_slice8(0, what, length);
     }
-    inline size_t hash(std::string_view what) {
-        return ext::crc64(0, what.data(), what.size());
+    constexpr size_t hash(std::string_view what) {
+        return hash(what.data(), what.size());
     }
-    constexpr size_t hash(const char* what, size_t length) {
-        return ext::crc64(0, what, length);
+    // continues hash of some prefix, hash_append(hash(a), b) == hash(a + b)
+    constexpr size_t hash_append(size_t prefix, std::string_view what) {
+        return ext::crc64_slice8(prefix, what.data(), what.size());
+    }
+
+    namespace literals {
+        // computed at compile time, "burn"_hash == lib::hash("burn")
+        consteval size_t operator""_hash(const char* what, size_t length) {
+            return hash(what, length);
+        }
+    }
+
+    // view of process-wide copy of string, equal strings share one copy.
+    // copies live until exit, so it's meant for names from data files
+    inline std::string_view intern(std::string_view what) {
+        static std::mutex mutex;
+        static std::set<std::string, std::less<>> pool;
+
+        std::lock_guard lock(mutex);
+        auto it = pool.find(what);
+        if (it == pool.end())
+            it = pool.emplace(what).first;
+        return *it;
     }
 }
@@ -1,7 +1,9 @@
 #pragma once
 
 //std
+#include <algorithm>
 #include <cfloat>
+#include <cmath>
 
 //library
 #include "library/format.hpp"
@@ -45,8 +47,26 @@ namespace lib {
         case '|':
             return (bool) lhs || (bool) rhs;
 
+        case 0x84: // min
+            return std::min(lhs, rhs);
+
+        case 0x85: // max
+            return std::max(lhs, rhs);
+
         default:
             throw RUNTIME_ERROR("this math operator doesn't exist");
         }
     }
+    inline double switch_math_op(double first, double second, double third, uint8_t code) {
+        switch (code) {
+        case 0x86: // clamp(value, low, high), high wins when low > high
+            return std::min(std::max(first, second), third);
+
+        case 0x87: // first ? second : third
+            return first != 0.0 ? second : third;
+
+        default:
+            throw RUNTIME_ERROR("this ternary math operator doesn't exist");
+        }
+    }
 }
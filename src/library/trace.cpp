@@ -0,0 +1,161 @@
+#include "library/trace.hpp"
+
+//std
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <map>
+
+//utl
+#include "utl/json.hpp"
+
+//library
+#include "library/format.hpp"
+
+namespace lib::trace_details {
+    thread_local TraceSession* current_session = nullptr;
+
+    double to_us(std::chrono::steady_clock::duration duration) {
+        return std::chrono::duration<double, std::micro>(duration).count();
+    }
+}
+
+namespace lib {
+    // TraceSession
+
+    std::atomic_size_t TraceSession::_sample_rate = 0;
+    std::atomic_size_t TraceSession::_request_counter = 0;
+    std::atomic_size_t TraceSession::_dump_counter = 0;
+    std::atomic_bool TraceSession::_is_requested_allowed = false;
+
+    void TraceSession::set_sample_rate(size_t every_nth) {
+        _sample_rate.store(every_nth, std::memory_order_relaxed);
+    }
+    void TraceSession::allow_requested(bool is_allowed) {
+        _is_requested_allowed.store(is_allowed, std::memory_order_relaxed);
+    }
+    bool TraceSession::is_requested_allowed() {
+        return _is_requested_allowed.load(std::memory_order_relaxed);
+    }
+    bool TraceSession::is_sampled(bool is_requested) {
+        if (is_requested && is_requested_allowed())
+            return true;
+
+        size_t rate = _sample_rate.load(std::memory_order_relaxed);
+        return rate != 0 && _request_counter.fetch_add(1, std::memory_order_relaxed) % rate == 0;
+    }
+
+    TraceSession* TraceSession::current() { return trace_details::current_session; }
+
+    TraceSession::Binder::Binder(TraceSession* session) :
+        _previous(trace_details::current_session) {
+        trace_details::current_session = session;
+    }
+    TraceSession::Binder::~Binder() {
+        trace_details::current_session = _previous;
+    }
+
+    TraceSession::TraceSession(std::string name) :
+        m_name(std::move(name)),
+        m_start(clock::now()),
+        _previous(trace_details::current_session) {
+        m_spans.reserve(64);
+        trace_details::current_session = this;
+    }
+    TraceSession::~TraceSession() {
+        _unbind();
+    }
+
+    void TraceSession::add_span(const char* name, std::string detail, clock::time_point start, clock::time_point end) {
+        span_t span = {
+            .name = name,
+            .detail = std::move(detail),
+            .start = start,
+            .end = end,
+            .thread = std::this_thread::get_id()
+        };
+
+        std::lock_guard lock(_mutex);
+        if (m_spans.size() < capacity)
+            m_spans.emplace_back(std::move(span));
+        else
+            m_spans[m_recorded % capacity] = std::move(span);
+        m_recorded++;
+    }
+
+    std::string TraceSession::dump(const std::string& folder) {
+        add_span(m_name.c_str(), {}, m_start, clock::now());
+        _unbind();
+
+        std::lock_guard lock(_mutex);
+
+        // spans are recorded on close, so parents go after children
+        std::ranges::sort(m_spans, [](const span_t& lhs, const span_t& rhs) {
+            return lhs.start != rhs.start ? lhs.start < rhs.start : lhs.end > rhs.end;
+        });
+
+        std::map<std::thread::id, int64_t> thread_ids;
+        utl::json::Array events;
+        events.reserve(m_spans.size());
+
+        for (const auto& span : m_spans) {
+            auto [it, _] = thread_ids.try_emplace(span.thread, (int64_t) thread_ids.size() + 1);
+
+            utl::Json event;
+            event["name"] = std::string(span.name);
+            event["cat"] = std::string("zzz");
+            event["ph"] = std::string("X");
+            event["ts"] = trace_details::to_us(span.start - m_start);
+            event["dur"] = trace_details::to_us(span.end - span.start);
+            event["pid"] = (int64_t) 1;
+            event["tid"] = it->second;
+            if (!span.detail.empty())
+                event["args"]["detail"] = span.detail;
+
+            events.emplace_back(std::move(event));
+        }
+
+        utl::Json result;
+        result["traceEvents"] = std::move(events);
+        result["displayTimeUnit"] = std::string("ms");
+        if (m_recorded > capacity)
+            result["otherData"]["dropped_spans"] = (int64_t) (m_recorded - capacity);
+
+        std::filesystem::create_directories(folder);
+        auto filename = lib::format("{}/trace-{}.json", folder, _dump_counter.fetch_add(1) % max_files + 1);
+
+        std::fstream file(filename, std::ios::out | std::ios::trunc);
+        if (!file.is_open())
+            throw FMT_RUNTIME_ERROR("can't open trace file \"{}\"", filename);
+        file << result.to_string(utl::json::Format::MINIMIZED);
+
+        return filename;
+    }
+
+    void TraceSession::_unbind() {
+        if (!_is_bound)
+            return;
+
+        if (trace_details::current_session == this)
+            trace_details::current_session = _previous;
+        _is_bound = false;
+    }
+
+    // TraceScope
+
+    TraceScope::TraceScope(const char* name) :
+        _session(trace_details::current_session),
+        _name(name) {
+        if (_session != nullptr)
+            _start = TraceSession::clock::now();
+    }
+    TraceScope::TraceScope(const char* name, std::string_view detail) :
+        TraceScope(name) {
+        if (_session != nullptr)
+            _detail = detail;
+    }
+    TraceScope::~TraceScope() {
+        if (_session != nullptr)
+            _session->add_span(_name, std::move(_detail), _start, TraceSession::clock::now());
+    }
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+//std
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace lib {
+    // per request span recorder, spans are dumped as chrome trace event json
+    // (chrome://tracing, ui.perfetto.dev).
+    // session binds itself to constructing thread, other threads have to use Binder.
+    // when no session is bound TraceScope costs one thread_local read
+    class TraceSession {
+    public:
+        using clock = std::chrono::steady_clock;
+
+        // spans above it overwrite the oldest ones
+        static constexpr size_t capacity = 4096;
+        // dumps go round trace-1.json ... trace-{max_files}.json, overwriting the oldest ones
+        static constexpr size_t max_files = 64;
+
+        // 0 - only explicitly requested sessions, N - every N-th request
+        static void set_sample_rate(size_t every_nth);
+        // sessions requested by clients are ignored unless server allows them
+        static void allow_requested(bool is_allowed);
+        static bool is_requested_allowed();
+        static bool is_sampled(bool is_requested);
+
+        static TraceSession* current();
+
+        // binds session to current thread until destruction, nullptr unbinds
+        class Binder {
+        public:
+            explicit Binder(TraceSession* session);
+            ~Binder();
+
+            Binder(const Binder&) = delete;
+            Binder& operator=(const Binder&) = delete;
+
+        private:
+            TraceSession* _previous;
+        };
+
+        explicit TraceSession(std::string name);
+        ~TraceSession();
+
+        void add_span(const char* name, std::string detail, clock::time_point start, clock::time_point end);
+
+        // closes root span, unbinds session and writes {folder}/trace-{n}.json, returns path of written file.
+        // n goes from 1 to max_files and starts over
+        std::string dump(const std::string& folder);
+
+        // deleted members
+
+        TraceSession(const TraceSession&) = delete;
+        TraceSession& operator=(const TraceSession&) = delete;
+
+    protected:
+        struct span_t {
+            const char* name;
+            std::string detail;
+            clock::time_point start, end;
+            std::thread::id thread;
+        };
+
+        std::string m_name;
+        clock::time_point m_start;
+        std::vector<span_t> m_spans;
+        size_t m_recorded = 0;
+
+    private:
+        static std::atomic_size_t _sample_rate, _request_counter, _dump_counter;
+        static std::atomic_bool _is_requested_allowed;
+
+        std::mutex _mutex;
+        TraceSession* _previous;
+        bool _is_bound = true;
+
+        void _unbind();
+    };
+
+    // records span from construction to destruction into bound session
+    class TraceScope {
+    public:
+        // name has to outlive session, string literals are expected
+        explicit TraceScope(const char* name);
+        TraceScope(const char* name, std::string_view detail);
+        ~TraceScope();
+
+        TraceScope(const TraceScope&) = delete;
+        TraceScope& operator=(const TraceScope&) = delete;
+
+    private:
+        TraceSession* _session;
+        const char* _name;
+        std::string _detail;
+        TraceSession::clock::time_point _start;
+    };
+}
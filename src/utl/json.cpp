@@ -200,6 +200,7 @@ namespace utl::json {
     const Node::floating_type& Node::as_floating() const { return this->as<floating_type>(); }
     const Node::bool_type& Node::as_bool() const { return this->as<bool_type>(); }
     const Node::null_type& Node::as_null() const { return this->as<null_type>(); }
+    double Node::as_number() const { return this->is_integral() ? (double) this->as_integral() : this->as_floating(); }
 
     bool Node::is_object() const noexcept { return this->is<object_type>(); }
     bool Node::is_array() const noexcept { return this->is<array_type>(); }
@@ -208,6 +209,7 @@ namespace utl::json {
     bool Node::is_floating() const noexcept { return this->is<floating_type>(); }
     bool Node::is_bool() const noexcept { return this->is<bool_type>(); }
     bool Node::is_null() const noexcept { return this->is<null_type>(); }
+    bool Node::is_number() const noexcept { return this->is_integral() || this->is_floating(); }
 
     // -- Object methods ---
     // ---------------------
@@ -293,6 +293,8 @@ namespace utl::json {
         [[nodiscard]] const floating_type& as_floating() const;
         [[nodiscard]] const bool_type& as_bool() const;
         [[nodiscard]] const null_type& as_null() const;
+        // integral or floating node as double
+        [[nodiscard]] double as_number() const;
 
         template<class T>
         [[nodiscard]] bool is() const noexcept {
@@ -306,6 +308,7 @@ namespace utl::json {
         [[nodiscard]] bool is_floating() const noexcept;
         [[nodiscard]] bool is_bool() const noexcept;
         [[nodiscard]] bool is_null() const noexcept;
+        [[nodiscard]] bool is_number() const noexcept;
 
         template<class T>
         [[nodiscard]] T* get_if() noexcept {
@@ -5,6 +5,7 @@
 #include "zzz/details/anomaly.hpp"
 #include "zzz/details/ddp.hpp"
 #include "zzz/details/dds.hpp"
+#include "zzz/details/enemy.hpp"
 #include "zzz/details/rotation.hpp"
 #include "zzz/details/skill.hpp"
 #include "zzz/details/wengine.hpp"
@@ -26,7 +26,20 @@ namespace zzz::details {
     const StatsGrid& Agent::stats() const { return m_stats; }
     const StatsGrid& Agent::team_buffs() const { return m_team_buffs; }
 
-    const Ability& Agent::ability(const std::string& name) const { return m_abilities.at(lib::hash(name)); }
+    const Ability& Agent::ability(std::string_view name) const { return m_abilities[m_ability_indices.at(lib::hash(name))]; }
+    bool Agent::has_ability(std::string_view name) const { return m_ability_indices.contains(lib::hash(name)); }
+
+    const Ability& Agent::ability_at(size_t index) const { return m_abilities.at(index); }
+    size_t Agent::ability_index(std::string_view name) const {
+        auto it = m_ability_indices.find(lib::hash(name));
+        if (it == m_ability_indices.end())
+            throw FMT_RUNTIME_ERROR("agent {} has no ability {}", m_id, name);
+        return it->second;
+    }
+    std::string_view Agent::ability_name(size_t index) const {
+        return std::visit([](const auto& it) -> std::string_view { return it.name(); }, ability_at(index));
+    }
+    size_t Agent::abilities_count() const { return m_abilities.size(); }
 
     // AgentBuilder
 
@@ -62,7 +75,7 @@ namespace zzz::details {
         return *this;
     }
 
-    AgentBuilder& AgentBuilder::add_stat(StatPtr&& value) {
+    AgentBuilder& AgentBuilder::add_stat(Stat value) {
         m_product->m_stats.set(std::move(value));
         return *this;
     }
@@ -71,7 +84,7 @@ namespace zzz::details {
         return *this;
     }
 
-    AgentBuilder& AgentBuilder::add_team_buff(StatPtr&& value) {
+    AgentBuilder& AgentBuilder::add_team_buff(Stat value) {
         m_product->m_team_buffs.set(std::move(value));
         return *this;
     }
@@ -82,13 +95,25 @@ namespace zzz::details {
 
     AgentBuilder& AgentBuilder::add_skill(Skill skill) {
         auto hashed_key = lib::hash(skill.name());
-        m_product->m_abilities.emplace(hashed_key, std::move(skill));
-        return *this;
+        if (m_product->m_ability_indices.contains(hashed_key))
+            return *this;
+
+        // scales are moved into array of agent
+        auto& storage = *m_product->m_scales;
+        auto scales = skill.scales();
+        size_t first = storage.size();
+        storage.insert(storage.end(), scales.begin(), scales.end());
+
+        skill.m_first_scale = (uint32_t) first;
+        skill.m_scales_storage = m_product->m_scales;
+        return _add_ability(hashed_key, std::move(skill));
     }
     AgentBuilder& AgentBuilder::add_anomaly(Anomaly anomaly) {
         auto hashed_key = lib::hash(anomaly.name());
-        m_product->m_abilities.emplace(hashed_key, std::move(anomaly));
-        return *this;
+        if (m_product->m_ability_indices.contains(hashed_key))
+            return *this;
+
+        return _add_ability(hashed_key, std::move(anomaly));
     }
 
     bool AgentBuilder::is_built() const {
@@ -102,8 +127,25 @@ namespace zzz::details {
         if (!is_built())
             throw RUNTIME_ERROR("you have to specify id, name, speciality, element, rarity, faction and stats");
 
+        // any anomaly can be procced by buildup, so agent knows all of them
+        for (size_t i = (size_t) Element::Phys; i < (size_t) Element::Count; i++) {
+            auto name = Anomaly::get_anomaly_by_element(i);
+            if (!m_product->m_ability_indices.contains(lib::hash(name)))
+                add_anomaly(Anomaly::get_standard_anomaly(name));
+        }
+        m_product->m_scales->shrink_to_fit();
+
         return IBuilder::get_product();
     }
+
+    AgentBuilder& AgentBuilder::_add_ability(size_t hashed_key, Ability ability) {
+        if (m_product->m_abilities.size() > UINT16_MAX)
+            throw RUNTIME_ERROR("agent can't have more than 65536 abilities");
+
+        m_product->m_ability_indices.emplace(hashed_key, (uint16_t) m_product->m_abilities.size());
+        m_product->m_abilities.emplace_back(std::move(ability));
+        return *this;
+    }
 }
 
 #include <future>
@@ -135,19 +177,21 @@ namespace zzz {
         return builder.get_product();
     }
 
+    // [motion_value, daze, element?, buildup?]
     SkillDetails::scale make_scale_from(const utl::Json& json, Element default_element) {
         const auto& array = json.as_array();
         SkillDetails::scale result;
 
         result.motion_value = array[0].as_floating();
         result.daze = array[1].as_floating();
+        result.element = default_element;
+        result.buildup = result.daze;
 
-        if (array.size() <= 2) {
-            result.element = default_element;
-            return result;
-        }
-
-        result.element = array[2].as_string();
+        size_t next = 2;
+        if (array.size() > next && array[next].is_string())
+            result.element = array[next++].as_string();
+        if (array.size() > next)
+            result.buildup = array[next].as_number();
 
         return result;
     }
@@ -167,7 +211,7 @@ namespace zzz {
             throw RUNTIME_ERROR("incompatible name or type of tag");
 
         builder.set_name(key);
-        builder.set_tags(tags);
+        builder.set_tags(TagMask(tags));
 
         if (auto it = table.find("scale"); it != table.end()) {
             builder.add_scale(make_scale_from(it->second, default_element));
@@ -212,21 +256,11 @@ namespace zzz {
 
         // anomalies
 
-        bool has_anomaly_redefinition = false;
-        auto own_anomaly_name = AnomalyDetails::get_anomaly_by_element(element);
-
+        // standard ones are added by builder unless they're redefined
         if (auto it = table.find("anomalies"); it != table.end()) {
-            for (const auto& [k, v] : it->second.as_object()) {
-                auto anomaly = make_anomaly_from(k, v, element);
-
-                if (own_anomaly_name == anomaly.name())
-                    has_anomaly_redefinition = true;
-
-                builder.add_anomaly(std::move(anomaly));
-            }
+            for (const auto& [k, v] : it->second.as_object())
+                builder.add_anomaly(make_anomaly_from(k, v, element));
         }
-        if (!has_anomaly_redefinition)
-            builder.add_anomaly(AnomalyDetails::get_standard_anomaly(own_anomaly_name));
 
         // skills
 
@@ -2,9 +2,13 @@
 
 //std
 #include <cstdint>
+#include <memory>
 #include <string>
-#include <unordered_map>
 #include <variant>
+#include <vector>
+
+//boost
+#include "boost/container/flat_map.hpp"
 
 //library
 #include "library/builder.hpp"
@@ -32,7 +36,14 @@ namespace zzz::details {
         const StatsGrid& stats() const;
         const StatsGrid& team_buffs() const;
 
-        const Ability& ability(const std::string& name) const;
+        const Ability& ability(std::string_view name) const;
+        bool has_ability(std::string_view name) const;
+
+        // abilities are numbered in order of adding, index is stable for loaded agent
+        const Ability& ability_at(size_t index) const;
+        size_t ability_index(std::string_view name) const;
+        std::string_view ability_name(size_t index) const;
+        size_t abilities_count() const;
 
     protected:
         uint64_t m_id;
@@ -42,7 +53,11 @@ namespace zzz::details {
         Rarity m_rarity;
         Faction m_faction;
         StatsGrid m_stats, m_team_buffs;
-        std::unordered_map<size_t, Ability> m_abilities;
+        std::vector<Ability> m_abilities;
+        // hash of name to index of ability
+        boost::container::flat_map<size_t, uint16_t> m_ability_indices;
+        // scales of every skill in one array, skills refer to their ranges
+        std::shared_ptr<std::vector<Skill::scale>> m_scales = std::make_shared<std::vector<Skill::scale>>();
     };
 
     class AgentBuilder : public lib::IBuilder<Agent> {
@@ -55,13 +70,14 @@ namespace zzz::details {
         AgentBuilder& set_rarity(Rarity rarity);
         AgentBuilder& set_faction(Faction faction);
 
-        AgentBuilder& add_stat(StatPtr&& value);
+        AgentBuilder& add_stat(Stat value);
         AgentBuilder& set_stats(StatsGrid stats);
 
-        AgentBuilder& add_team_buff(StatPtr&& value);
+        AgentBuilder& add_team_buff(Stat value);
         AgentBuilder& set_team_buffs(StatsGrid stats);
 
         AgentBuilder& add_skill(Skill skill);
+        // standard anomalies which aren't added are added by get_product
         AgentBuilder& add_anomaly(Anomaly anomaly);
 
         bool is_built() const override;
@@ -76,6 +92,8 @@ namespace zzz::details {
             bool rarity     : 1 = false;
             bool faction    : 1 = false;
         } _is_set;
+
+        AgentBuilder& _add_ability(size_t hashed_key, Ability ability);
     };
 }
 
@@ -46,6 +46,34 @@ namespace zzz::details {
         make_as_pair("corruption", 62.5 * 20, Element::Ether)
     };
 
+    // AnomalyBuildup
+
+    AnomalyBuildup::AnomalyBuildup(double threshold) :
+        m_threshold(threshold) {
+        if (threshold <= 0.0)
+            throw FMT_RUNTIME_ERROR("anomaly buildup threshold has to be positive, got {}", threshold);
+    }
+
+    double AnomalyBuildup::calc_buildup(double base, double mastery, double rate, double pen) {
+        return base * mastery / 100 * (1.0 + rate) * (1.0 + pen);
+    }
+
+    Element AnomalyBuildup::add(Element element, double buildup) {
+        auto& level = m_levels[(size_t) element];
+        level += buildup;
+
+        if (element == Element::None || level < m_threshold)
+            return Element::None;
+
+        level = 0.0;
+        m_procs++;
+        return element;
+    }
+
+    double AnomalyBuildup::level(Element element) const { return m_levels[(size_t) element]; }
+    double AnomalyBuildup::threshold() const { return m_threshold; }
+    size_t AnomalyBuildup::procs() const { return m_procs; }
+
     // AnomalyBuilder
 
     AnomalyBuilder& AnomalyBuilder::set_name(std::string name) {
@@ -66,7 +94,7 @@ namespace zzz::details {
         return *this;
     }
 
-    AnomalyBuilder& AnomalyBuilder::add_buff(const StatPtr& value) {
+    AnomalyBuilder& AnomalyBuilder::add_buff(const Stat& value) {
         m_product->m_buffs.add(value);
         return *this;
     }
@@ -55,6 +55,30 @@ namespace zzz::details {
 		Anomaly(std::string name, double scale, Element element, StatsGrid buffs);
 	};
 
+	// incremental anomaly buildup of enemy, every element is accumulated separately.
+	// element which reaches threshold procs its anomaly and its buildup starts over
+	class AnomalyBuildup {
+	public:
+		static constexpr double default_threshold = 1000.0;
+
+		explicit AnomalyBuildup(double threshold = default_threshold);
+
+		// buildup of hit is base * AmTotal / 100 * (1 + AbRate) * (1 + AbPen)
+		static double calc_buildup(double base, double mastery, double rate, double pen);
+
+		// returns element of triggered anomaly or Element::None
+		Element add(Element element, double buildup);
+
+		double level(Element element) const;
+		double threshold() const;
+		size_t procs() const;
+
+	protected:
+		std::array<double, (size_t) Element::Count> m_levels = {};
+		double m_threshold;
+		size_t m_procs = 0;
+	};
+
 	class AnomalyBuilder : public lib::IBuilder<Anomaly> {
 	public:
 		AnomalyBuilder& set_name(std::string name);
@@ -63,7 +87,7 @@ namespace zzz::details {
 
 		AnomalyBuilder& set_element(Element element);
 
-		AnomalyBuilder& add_buff(const StatPtr& value);
+		AnomalyBuilder& add_buff(const Stat& value);
 		AnomalyBuilder& set_buffs(StatsGrid stats);
 
 		AnomalyBuilder& set_crit(bool can_crit);
@@ -83,4 +107,5 @@ namespace zzz::details {
 namespace zzz {
 	using AnomalyDetails = details::Anomaly;
 	using AnomalyDetailsPtr = std::shared_ptr<details::Anomaly>;
+	using AnomalyBuildup = details::AnomalyBuildup;
 }
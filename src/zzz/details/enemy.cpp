@@ -0,0 +1,117 @@
+#include "zzz/details/enemy.hpp"
+
+//utl
+#include "utl/json.hpp"
+
+//crow
+#include "crow/logging.h"
+
+//lib
+#include "library/format.hpp"
+
+namespace zzz::details {
+    // Enemy
+
+    uint64_t Enemy::id() const { return m_id; }
+    const std::string& Enemy::name() const { return m_name; }
+    double Enemy::defense() const { return m_defense; }
+    double Enemy::dmg_reduction() const { return m_dmg_reduction; }
+    double Enemy::stun_mult() const { return m_stun_mult; }
+    double Enemy::res(Element element) const { return m_res[(size_t) element]; }
+
+    // EnemyBuilder
+
+    EnemyBuilder& EnemyBuilder::set_id(uint64_t id) {
+        m_product->m_id = id;
+        _is_set.id = true;
+        return *this;
+    }
+    EnemyBuilder& EnemyBuilder::set_name(std::string name) {
+        m_product->m_name = std::move(name);
+        _is_set.name = true;
+        return *this;
+    }
+
+    EnemyBuilder& EnemyBuilder::set_defense(double defense) {
+        m_product->m_defense = defense;
+        _is_set.defense = true;
+        return *this;
+    }
+    EnemyBuilder& EnemyBuilder::set_dmg_reduction(double dmg_reduction) {
+        m_product->m_dmg_reduction = dmg_reduction;
+        return *this;
+    }
+    EnemyBuilder& EnemyBuilder::set_stun_mult(double stun_mult) {
+        m_product->m_stun_mult = stun_mult;
+        return *this;
+    }
+    EnemyBuilder& EnemyBuilder::set_res(Element element, double res) {
+        if (element == Element::None || element == Element::Count)
+            throw FMT_RUNTIME_ERROR("enemy can't have resistance to {}", (std::string_view) element);
+
+        m_product->m_res[(size_t) element] = res;
+        return *this;
+    }
+
+    bool EnemyBuilder::is_built() const {
+        return _is_set.id
+            && _is_set.name
+            && _is_set.defense;
+    }
+    Enemy&& EnemyBuilder::get_product() {
+        if (!is_built())
+            throw RUNTIME_ERROR("you have to specify id, name and defense");
+
+        return IBuilder::get_product();
+    }
+}
+
+namespace zzz {
+    // Service
+
+    // omitted dmg_reduction, stun_mult and resistances are the same as for default enemy
+    EnemyDetails load_enemy_from_json(const utl::Json& json) {
+        const auto& table = json.as_object();
+        details::EnemyBuilder builder;
+
+        builder.set_id(table.at("id").as_integral());
+        builder.set_name(table.at("name").as_string());
+        builder.set_defense(table.at("defense").as_number());
+
+        if (auto it = table.find("dmg_reduction"); it != table.end())
+            builder.set_dmg_reduction(it->second.as_number());
+        if (auto it = table.find("stun_mult"); it != table.end())
+            builder.set_stun_mult(it->second.as_number());
+
+        if (auto it = table.find("res"); it != table.end()) {
+            for (const auto& [k, v] : it->second.as_object())
+                builder.set_res((Element) k, v.as_number());
+        }
+
+        return builder.get_product();
+    }
+
+    // Enemy
+
+    Enemy::Enemy(const std::string& name) :
+        MObject(lib::format("enemies/{}", name)) {
+    }
+
+    EnemyDetails& Enemy::details() { return as<EnemyDetails>(); }
+    const EnemyDetails& Enemy::details() const { return as<EnemyDetails>(); }
+
+    bool Enemy::load_from_string(const std::string& input, size_t mode) {
+        if (mode == 1) {
+            auto json = utl::json::from_string(input);
+            auto details = load_enemy_from_json(json);
+            set(std::move(details));
+        } else {
+#ifdef DEBUG_STATUS
+            CROW_LOG_ERROR << lib::format("extension_id {} isn't defined", mode);
+#endif
+            return false;
+        }
+
+        return true;
+    }
+}
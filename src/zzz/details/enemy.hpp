@@ -0,0 +1,71 @@
+#pragma once
+
+//std
+#include <array>
+#include <string>
+
+//library
+#include "library/builder.hpp"
+#include "library/cached_memory.hpp"
+
+//zzz
+#include "zzz/enums.hpp"
+
+namespace zzz::details {
+    class Enemy {
+        friend class EnemyBuilder;
+
+    public:
+        uint64_t id() const;
+        const std::string& name() const;
+        double defense() const;
+        double dmg_reduction() const;
+        // additional multiplier while enemy is stunned
+        double stun_mult() const;
+        double res(Element element) const;
+
+    protected:
+        uint64_t m_id;
+        std::string m_name;
+        double m_defense;
+        double m_dmg_reduction = 0.2;
+        double m_stun_mult = 1.5;
+        std::array<double, (size_t) Element::Count> m_res = { 0.0, 0.2, 0.2, 0.2, 0.2, 0.2 };
+    };
+
+    class EnemyBuilder : public lib::IBuilder<Enemy> {
+    public:
+        EnemyBuilder& set_id(uint64_t id);
+        EnemyBuilder& set_name(std::string name);
+
+        EnemyBuilder& set_defense(double defense);
+        EnemyBuilder& set_dmg_reduction(double dmg_reduction);
+        EnemyBuilder& set_stun_mult(double stun_mult);
+        EnemyBuilder& set_res(Element element, double res);
+
+        bool is_built() const override;
+        Enemy&& get_product() override;
+
+    private:
+        struct {
+            bool id      : 1 = false;
+            bool name    : 1 = false;
+            bool defense : 1 = false;
+        } _is_set;
+    };
+}
+
+namespace zzz {
+    using EnemyDetails = details::Enemy;
+
+    class Enemy : public lib::MObject {
+    public:
+        explicit Enemy(const std::string& name);
+
+        EnemyDetails& details();
+        const EnemyDetails& details() const;
+
+        bool load_from_string(const std::string& input, size_t mode) override;
+    };
+    using EnemyPtr = std::shared_ptr<Enemy>;
+}
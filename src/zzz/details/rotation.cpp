@@ -19,6 +19,7 @@ namespace zzz::details {
     // Rotation
 
     std::span<uint64_t> Rotation::teammates() { return { m_teammates.begin(), m_teammates.end() }; }
+    std::span<const uint64_t> Rotation::teammates() const { return { m_teammates.begin(), m_teammates.end() }; }
     std::span<const rotation_cell> Rotation::cells() const { return { m_content.begin(), m_content.end() }; }
 
     const rotation_cell& Rotation::operator[](size_t index) const { return m_content[index]; }
@@ -63,17 +64,25 @@ namespace zzz::details {
 namespace zzz {
     // Service
 
-    details::rotation_cell to_rotation_cell(const std::vector<std::string_view>& splitted) {
-        size_t index = splitted.size() == 1 ? 0 : lib::sv_to<size_t>(splitted[1]);
-        return { .command = std::string(splitted[0]), .index = index };
-    }
     details::rotation_cell to_rotation_cell(const std::string_view& text) {
-        return to_rotation_cell(lib::split_as_view(text, ' '));
+        auto [command, params] = lib::split_once(text, ' ');
+        details::rotation_cell result = { .command = std::string(command), .index = 0 };
+
+        lib::for_each_split(params, ' ', [&result](std::string_view it) {
+            if (it.starts_with('@'))
+                result.duration = lib::sv_to<double>(it.substr(1));
+            else
+                result.index = lib::sv_to<size_t>(it);
+        });
+
+        return result;
     }
 
-    size_t calc_loops(const std::vector<std::string_view>& splitted) {
-        return splitted.size() != 1
-            ? lib::sv_to<size_t>(splitted[1].starts_with('x') ? splitted[1].substr(1) : splitted[1])
+    // params - everything after name of nested rotation, "x3" or "3"
+    size_t calc_loops(std::string_view params) {
+        auto loops = lib::split_once(params, ' ').first;
+        return !params.empty()
+            ? lib::sv_to<size_t>(loops.starts_with('x') ? loops.substr(1) : loops)
             : 1;
     }
 
@@ -108,21 +117,22 @@ namespace zzz {
                 builder.add_teammate(id.as_integral());
         }
 
-        std::unordered_map<std::string, RotationDetails> rotations;
+        // transparent, so nested rotations are found by view of cell
+        std::map<std::string, RotationDetails, std::less<>> rotations;
 
         // priorities are in reversed order
         for (const auto& v : by_priority | std::views::values) {
             details::RotationBuilder local_builder;
 
             for (const auto& it : v->second) {
-                auto splitted = lib::split_as_view(it, ' ');
+                auto [name, params] = lib::split_once(it, ' ');
 
-                if (auto jt = rotations.find(std::string(splitted[0])); jt != rotations.end()) {
-                    for (size_t i = 0; i < calc_loops(splitted); i++)
+                if (auto jt = rotations.find(name); jt != rotations.end()) {
+                    for (size_t i = 0; i < calc_loops(params); i++)
                         for (size_t j = 0; j < jt->second.size(); j++)
                             local_builder.add_cell(jt->second[j]);
                 } else
-                    local_builder.add_cell(to_rotation_cell(splitted));
+                    local_builder.add_cell(to_rotation_cell(it));
             }
 
             rotations.emplace(v->first, local_builder.get_product());
@@ -5,6 +5,7 @@
 #include <list>
 #include <span>
 #include <string>
+#include <string_view>
 #include <vector>
 
 //library
@@ -12,9 +13,12 @@
 #include "library/cached_memory.hpp"
 
 namespace zzz::details {
+    // "command [index] [@duration]"
     struct rotation_cell {
         std::string command;
         uint64_t index;
+        // seconds until next action, 0.0 means default of timeline simulation
+        double duration = 0.0;
     };
 
     class Rotation {
@@ -22,6 +26,7 @@ namespace zzz::details {
 
     public:
         std::span<uint64_t> teammates();
+        std::span<const uint64_t> teammates() const;
         std::span<const rotation_cell> cells() const;
 
         const rotation_cell& operator[](size_t index) const;
@@ -50,6 +55,8 @@ namespace zzz::details {
 namespace zzz {
     using RotationDetails = details::Rotation;
 
+    details::rotation_cell to_rotation_cell(const std::string_view& text);
+
     class Rotation : public lib::MObject {
     public:
         explicit Rotation(const std::string& name);
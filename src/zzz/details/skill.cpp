@@ -2,49 +2,55 @@
 
 //lib
 #include "library/format.hpp"
+#include "library/string_funcs.hpp"
 
 namespace zzz::details {
     // Skill
 
-    const std::string& Skill::name() const { return m_name; }
-    std::span<const Tag> Skill::tags() const { return { m_tags.data(), m_tags.size() }; }
-    std::span<const Skill::scale> Skill::scales() const { return { m_scales.data(), m_scales.size() }; }
+    std::string_view Skill::name() const { return m_name; }
+    TagMask Skill::tags() const { return m_tags; }
+    std::span<const Skill::scale> Skill::scales() const { return { m_scales_storage->data() + m_first_scale, m_scales_count }; }
     const StatsGrid& Skill::buffs() const { return m_buffs; }
 
-    size_t Skill::max_index() const { return m_scales.size(); }
+    size_t Skill::max_index() const { return m_scales_count; }
 
     // SkillBuilder
 
-    SkillBuilder& SkillBuilder::set_name(std::string name) {
-        m_product->m_name = std::move(name);
+    SkillBuilder& SkillBuilder::set_name(std::string_view name) {
+        m_product->m_name = lib::intern(name);
         _is_set.name = true;
         return *this;
     }
 
     SkillBuilder& SkillBuilder::add_tag(Tag tag) {
-	    m_product->m_tags.emplace_back(tag);
+        m_product->m_tags.add(tag);
         _is_set.tag = true;
         return *this;
     }
-    SkillBuilder& SkillBuilder::set_tags(std::vector<Tag> tags) {
-	    m_product->m_tags = std::move(tags);
-	    _is_set.tag = true;
-	    return *this;
+    SkillBuilder& SkillBuilder::set_tags(TagMask tags) {
+        m_product->m_tags = tags;
+        _is_set.tag = true;
+        return *this;
     }
 
     SkillBuilder& SkillBuilder::add_scale(Skill::scale value) {
-        m_product->m_scales.emplace_back(value);
+        m_product->m_scales_storage->emplace_back(value);
+        m_product->m_scales_count++;
         return *this;
     }
     SkillBuilder& SkillBuilder::add_scale(double motion_value, double daze, Element element) {
+        return add_scale(motion_value, daze, element, daze);
+    }
+    SkillBuilder& SkillBuilder::add_scale(double motion_value, double daze, Element element, double buildup) {
         return add_scale({
             .motion_value = motion_value,
             .daze = daze,
-            .element = element
+            .element = element,
+            .buildup = buildup
         });
     }
 
-    SkillBuilder& SkillBuilder::add_buff(const StatPtr& buff) {
+    SkillBuilder& SkillBuilder::add_buff(const Stat& buff) {
         m_product->m_buffs.add(buff);
         return *this;
     }
@@ -1,6 +1,7 @@
 #pragma once
 
 //std
+#include <cstdint>
 #include <memory>
 #include <span>
 #include <string>
@@ -18,39 +19,48 @@ namespace zzz::details {
     // level for abilities is always 12
     class Skill {
         friend class SkillBuilder;
+        friend class AgentBuilder;
 
     public:
         struct scale {
             double motion_value;
             double daze;
             Element element;
+            // anomaly buildup of element, same as daze unless specified
+            double buildup = 0.0;
         };
 
-        const std::string& name() const;
-        std::span<const Tag> tags() const;
+        std::string_view name() const;
+        TagMask tags() const;
         std::span<const scale> scales() const;
         const StatsGrid& buffs() const;
 
         size_t max_index() const;
 
     protected:
-        std::string m_name;
-        std::vector<Tag> m_tags;
-        std::vector<scale> m_scales;
+        // interned
+        std::string_view m_name;
+        TagMask m_tags;
+        // scales of skill are [m_first_scale, m_first_scale + m_scales_count) of storage,
+        // agent moves them into one array which is shared by all its skills
+        uint16_t m_scales_count = 0;
+        uint32_t m_first_scale = 0;
+        std::shared_ptr<std::vector<scale>> m_scales_storage = std::make_shared<std::vector<scale>>();
         StatsGrid m_buffs;
     };
 
     class SkillBuilder : public lib::IBuilder<Skill> {
     public:
-        SkillBuilder& set_name(std::string name);
+        SkillBuilder& set_name(std::string_view name);
 
         SkillBuilder& add_tag(Tag tag);
-        SkillBuilder& set_tags(std::vector<Tag> tags);
+        SkillBuilder& set_tags(TagMask tags);
 
         SkillBuilder& add_scale(Skill::scale value);
         SkillBuilder& add_scale(double motion_value, double daze, Element element);
+        SkillBuilder& add_scale(double motion_value, double daze, Element element, double buildup);
 
-        SkillBuilder& add_buff(const StatPtr& buff);
+        SkillBuilder& add_buff(const Stat& buff);
         SkillBuilder& set_buffs(StatsGrid buffs);
 
         bool is_built() const override;
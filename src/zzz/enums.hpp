@@ -1,8 +1,11 @@
 #pragma once
 
 //std
+#include <bit>
+#include <compare>
 #include <concepts>
 #include <cstdint>
+#include <span>
 #include <string>
 
 //magic_enum
@@ -163,6 +166,87 @@ namespace zzz {
     };
 }
 
+// =============
+// == TagMask ==
+// =============
+
+namespace zzz {
+    // set of tags packed into bits, bit i stands for Tag(i).
+    // tags are iterated in ascending order and every tag is stored once
+    class TagMask {
+    public:
+        class iterator {
+        public:
+            using value_type = Tag;
+            using difference_type = std::ptrdiff_t;
+
+            constexpr iterator() = default;
+            constexpr explicit iterator(uint16_t bits) :
+                _bits(bits) {}
+
+            constexpr Tag operator*() const { return std::countr_zero(_bits); }
+            constexpr iterator& operator++() {
+                _bits &= _bits - 1;
+                return *this;
+            }
+            constexpr iterator operator++(int) {
+                auto result = *this;
+                ++*this;
+                return result;
+            }
+
+            constexpr bool operator==(const iterator& another) const = default;
+
+        private:
+            uint16_t _bits = 0;
+        };
+
+        // ctor
+
+        constexpr TagMask() = default;
+        constexpr TagMask(Tag tag) :
+            _bits(uint16_t(1u << (size_t) tag)) {}
+        constexpr TagMask(Tag::Enum tag) :
+            TagMask(Tag(tag)) {}
+        constexpr explicit TagMask(std::span<const Tag> tags) {
+            for (const auto& it : tags)
+                add(it);
+        }
+
+        static constexpr TagMask from_bits(uint16_t bits) {
+            TagMask result;
+            result._bits = bits;
+            return result;
+        }
+
+        // modifiers
+
+        constexpr TagMask& add(Tag tag) {
+            _bits |= uint16_t(1u << (size_t) tag);
+            return *this;
+        }
+
+        // getters
+
+        constexpr uint16_t bits() const { return _bits; }
+        constexpr bool contains(Tag tag) const { return _bits >> (size_t) tag & 1; }
+        constexpr size_t size() const { return (size_t) std::popcount(_bits); }
+        constexpr bool empty() const { return _bits == 0; }
+
+        constexpr iterator begin() const { return iterator(_bits); }
+        constexpr iterator end() const { return iterator(); }
+
+        // comparison
+
+        constexpr auto operator<=>(const TagMask& another) const = default;
+
+    private:
+        uint16_t _bits = 0;
+    };
+
+    static_assert((size_t) Tag::Count <= 16, "TagMask has only 16 bits");
+}
+
 // ================
 // == Speciality ==
 // ================
@@ -2,12 +2,17 @@
 
 //std
 #include <memory>
+#include <span>
+#include <vector>
+
+//library
+#include "library/rpn.hpp"
 
 //zzz
 #include "zzz/enums.hpp"
 
 namespace zzz {
-    using StatPtr = std::unique_ptr<class IStat>;
+    class StatsGrid;
 
     struct qualifier_t {
         StatId id;
@@ -16,38 +21,52 @@ namespace zzz {
         size_t hash() const { return size_t(id) | size_t(tag) << 8; }
     };
 
-    class IStat {
-        friend class StatsGrid;
+    // "f:func;c:cond;m:max" fused into one program, cond ? min(func, max) : 0
+    struct formulas_t {
+        lib::rpn_program_t program;
+    };
+    // formulas are immutable, so every copy of relative stat shares them
+    using FormulasPtr = std::shared_ptr<const formulas_t>;
 
+    // stat is stored by value, regular one is just a number and relative one adds
+    // value of its formulas which are evaluated against grid containing the stat.
+    // copying regular stat doesn't allocate, copying relative one only shares formulas
+    class Stat {
     public:
-        virtual ~IStat() = default;
-
-        virtual StatPtr copy() const = 0;
+        Stat(StatId id, Tag tag, double base) :
+            m_unique({ .id = id, .tag = tag }),
+            m_base(base) {
+        }
+        Stat(StatId id, Tag tag, double base, FormulasPtr formulas) :
+            m_unique({ .id = id, .tag = tag }),
+            m_base(base),
+            m_formulas(std::move(formulas)) {
+        }
 
         qualifier_t qualifier() const { return m_unique; }
 
         double& base() { return m_base; }
         const double& base() const { return m_base; }
 
-        size_t type() const { return _type; }
+        // 1 is regular stat, 2 is relative one
+        size_t type() const { return m_formulas ? 2 : 1; }
+        // nullptr for regular stat
+        const FormulasPtr& formulas() const { return m_formulas; }
 
-        virtual double value() const = 0;
+        double value(const StatsGrid& lookup_table) const {
+            return m_formulas ? _relative_value(lookup_table) : m_base;
+        }
+        // value against every grid, program of relative stat is run once over all of them
+        void values(std::span<const StatsGrid* const> lookup_tables, std::span<double> result) const;
 
     protected:
         // acts like identifier in grid
-        const qualifier_t m_unique;
+        qualifier_t m_unique;
         double m_base;
-
-        IStat(StatId id, Tag tag, double base, size_t type) :
-            m_unique({ .id = id, .tag = tag }),
-            m_base(base),
-            _type(type) {
-        }
-
-        // assume that this->m_unique == another.m_unique
-        virtual StatPtr add_as_copy(const StatPtr& another) = 0;
+        FormulasPtr m_formulas;
 
     private:
-        size_t _type;
+        // defined with formula evaluation in relative.cpp
+        double _relative_value(const StatsGrid& lookup_table) const;
     };
 }
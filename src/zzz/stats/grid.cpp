@@ -1,9 +1,11 @@
 #include "zzz/stats/grid.hpp"
 
 //std
-#include <functional>
 #include <ranges>
 
+//library
+#include "library/format.hpp"
+
 //frozen
 #include "frozen/string.h"
 #include "frozen/unordered_map.h"
@@ -13,45 +15,45 @@
 #include "zzz/stats/relative.hpp"
 
 using namespace frozen::string_literals;
-namespace ph = std::placeholders;
 
 namespace zzz::details {
-    static constexpr frozen::unordered_map<StatId::Enum, frozen::string, 2> formulas = {
+    static constexpr frozen::unordered_map<StatId::Enum, frozen::string, 3> formulas = {
         { StatId::AtkTotal, "f:(AtkBase * (1 + AtkRatio) + AtkFlat) * (1 + AtkRatioCombat) + AtkFlatCombat"_s },
-        { StatId::AmTotal, "f:(AmBase * (1 + AmRatio) + AmFlat) * (1 + AmRatioCombat) + AmFlatCombat"_s }
+        { StatId::AmTotal, "f:(AmBase * (1 + AmRatio) + AmFlat) * (1 + AmRatioCombat) + AmFlatCombat"_s },
+        { StatId::ImpactTotal, "f:ImpactBase * (1 + ImpactRatio)"_s }
     };
 
-    StatPtr make_relative(const utl::Json& json, Tag tag, const StatsGrid& lookup_table) {
-        auto ptr = RelativeStat::make_from(json, tag);
-
-        // after making relative stat we have to specify lookup table
-        auto relative = dynamic_cast<RelativeStat&>(*ptr);
-        relative.lookup_table(&lookup_table);
+    // compiled at startup, so requests don't even touch formula pool
+    const auto defined_formulas = [] {
+        std::array<FormulasPtr, (size_t) StatId::Count> result;
+        for (const auto& [k, v] : formulas)
+            result[(size_t) k] = RelativeStat::make_formulas({ v.data(), v.size() });
+        return result;
+    }();
 
-        return ptr;
-    }
-    StatPtr make_regular(const utl::Json& json, Tag tag) {
-        return RegularStat::make_from(json, tag);
+    Stat make_stat(const utl::Json& json, Tag tag) {
+        // formula as last element is indicator of relative stat
+        return json.as_array().back().is_string()
+            ? RelativeStat::make_from(json, tag)
+            : RegularStat::make_from(json, tag);
     }
 }
 
 namespace zzz {
     // maker
 
-    StatPtr StatsGrid::make_defined_relative_stat(StatId id, Tag tag) {
-        const auto& formula = details::formulas.at(id);
-        return RelativeStat::make(id, tag, 0.0, { formula.data(), formula.size() });
+    Stat StatsGrid::make_defined_relative_stat(StatId id, Tag tag) {
+        const auto& formulas = details::defined_formulas[id];
+        if (formulas == nullptr)
+            throw FMT_RUNTIME_ERROR("stat {} has no defined formula", (size_t) id);
+        return RelativeStat::make(id, tag, 0.0, formulas);
     }
 
     StatsGrid StatsGrid::make_from(const utl::Json& json, Tag tag) {
         StatsGrid result;
 
-        for (const auto& stat : json.as_array()) {
-            const auto& stat_array = stat.as_array();
-            result.set(stat_array.back().is_string()
-                ? details::make_relative(stat_array, tag, result)
-                : details::make_regular(stat_array, tag));
-        }
+        for (const auto& stat : json.as_array())
+            result.set(details::make_stat(stat, tag));
 
         return result;
     }
@@ -59,50 +61,52 @@ namespace zzz {
         StatsGrid result;
 
         for (const auto& stat : json.as_array()) {
-            const auto& stat_array = stat.as_array();
-            // indicator that this is RelativeStat
-            std::function<StatPtr(const utl::Json&, Tag)> maker;
-            if (stat_array.back().is_string())
-                maker = [&](const utl::Json& json, Tag tag) { return details::make_relative(json, tag, result); };
-            else
-                maker = details::make_regular;
-
             for (const auto& tag : tags)
-                result.set(maker(stat, tag));
+                result.set(details::make_stat(stat, tag));
         }
 
         return result;
     }
 
-    // ctor
+    // getter/setter
 
-    StatsGrid::StatsGrid(const StatsGrid& another) noexcept {
-        _copy_from(another);
-    }
-    StatsGrid& StatsGrid::operator=(const StatsGrid& another) noexcept {
-        m_content.clear();
-        _copy_from(another);
-        return *this;
+    double StatsGrid::get_value(qualifier_t key) const {
+        auto it = m_content.find(key.hash());
+        return it != m_content.end() ? it->second.value(*this) : 0.0;
     }
 
-    StatsGrid::StatsGrid(StatsGrid&& another) noexcept {
-        m_content = std::move(another.m_content);
-    }
-    StatsGrid& StatsGrid::operator=(StatsGrid&& another) noexcept {
-        m_content = std::move(another.m_content);
-        return *this;
+    bool StatsGrid::empty() const {
+        return m_content.empty();
     }
 
-    // getter/setter
+    FoldedStats StatsGrid::fold(TagMask tags) const {
+        FoldedStats result;
 
-    double StatsGrid::get_value(qualifier_t key) const {
-        auto it = m_content.find(key.hash());
-        return it != m_content.end() ? it->second->value() : 0.0;
+        // keys are sorted by tag first, so stats of one tag are contiguous
+        auto with_tag = [this](Tag tag) {
+            return std::ranges::subrange(
+                m_content.lower_bound(size_t(tag) << 8),
+                m_content.lower_bound((size_t(tag) + 1) << 8));
+        };
+
+        for (const auto& [key, stat] : with_tag(Tag::Universal))
+            result.universal[key & 0xff] = stat.value(*this);
+        result.total = result.universal;
+
+        for (const auto& tag : tags) {
+            for (const auto& [key, stat] : with_tag(tag)) {
+                double value = stat.value(*this);
+                result.tagged[key & 0xff] += value;
+                result.total[key & 0xff] += value;
+            }
+        }
+
+        return result;
     }
 
-    void StatsGrid::set(StatPtr&& value) {
-        _set_lookup_table_if_relative(value);
-        m_content[value->qualifier().hash()] = std::move(value);
+    void StatsGrid::set(Stat value) {
+        size_t key = value.qualifier().hash();
+        m_content.insert_or_assign(key, std::move(value));
     }
 
     bool StatsGrid::contains(qualifier_t key) const {
@@ -111,51 +115,37 @@ namespace zzz {
 
     // indexers
 
-    IStat& StatsGrid::at(qualifier_t key) {
-        return *m_content[key.hash()];
+    Stat& StatsGrid::at(qualifier_t key) {
+        auto it = m_content.find(key.hash());
+        if (it == m_content.end())
+            it = m_content.emplace(key.hash(), Stat(key.id, key.tag, 0.0)).first;
+        return it->second;
     }
-    const IStat& StatsGrid::at(qualifier_t key) const {
-        return *m_content.at(key.hash());
+    const Stat& StatsGrid::at(qualifier_t key) const {
+        return m_content.at(key.hash());
     }
 
     // data manipulation
 
-    void StatsGrid::add(const StatPtr& stat) {
-        size_t key = stat->qualifier().hash();
+    void StatsGrid::add(const Stat& stat) {
+        size_t key = stat.qualifier().hash();
         auto it = m_content.find(key);
-        StatPtr* ptr;
-
-        if (it != m_content.end()) {
-            it->second = it->second->add_as_copy(stat);
-            ptr = &it->second;
-        } else {
-            auto [jt, flag] = m_content.emplace(key, stat->copy());
-            ptr = &jt->second;
+
+        if (it == m_content.end()) {
+            m_content.emplace(key, stat);
+            return;
         }
 
-        _set_lookup_table_if_relative(*ptr);
+        auto& current = it->second;
+        if (stat.formulas() != nullptr) {
+            if (current.formulas() != nullptr)
+                throw RUNTIME_ERROR("two relative stats can't be summed");
+            current = RelativeStat::make(stat.qualifier().id, stat.qualifier().tag, current.base() + stat.base(), stat.formulas());
+        } else
+            current.base() += stat.base();
     }
     void StatsGrid::add(const StatsGrid& another) {
         for (const auto& stat : another.m_content | std::views::values)
             add(stat);
     }
-
-    void StatsGrid::_copy_from(const StatsGrid& another) {
-        m_content.reserve(another.m_content.size());
-        for (size_t i = 0; i < another.m_content.size(); i++) {
-            const auto& [k, v] = *another.m_content.nth(i);
-            m_content.emplace_hint(m_content.begin() + i, k, v->copy());
-        }
-
-        for (const auto& [k, v] : another.m_content)
-            m_content.emplace(k, v->copy());
-    }
-
-    void StatsGrid::_set_lookup_table_if_relative(StatPtr& ptr) {
-        if (ptr->type() != 2)
-            return;
-
-        auto& relative = dynamic_cast<RelativeStat&>(*ptr);
-        relative.lookup_table(this);
-    }
 }
@@ -18,51 +18,63 @@ namespace boost {
 }
 
 namespace zzz {
+    // values of grid for one tag set, per cell code reads them by StatId instead of doing lookups
+    struct FoldedStats {
+        struct values_t {
+            std::array<double, (size_t) StatId::Count> data = {};
+
+            double& operator[](StatId id) { return data[id]; }
+            double operator[](StatId id) const { return data[id]; }
+        };
+
+        // only Universal
+        values_t universal;
+        // only tags of set
+        values_t tagged;
+        // Universal plus every tag of set, summed in the same order as calc::details::get_value
+        values_t total;
+    };
+
     class StatsGrid {
     public:
-        static StatPtr make_defined_relative_stat(StatId id, Tag tag);
+        // formulas of defined stats are parsed once and shared
+        static Stat make_defined_relative_stat(StatId id, Tag tag);
 
         static StatsGrid make_from(const utl::Json& json, Tag tag = Tag::Universal);
         static StatsGrid make_from(const utl::Json& json, std::span<Tag> tags);
 
         StatsGrid() = default;
-        ~StatsGrid() = default;
-
-        StatsGrid(const StatsGrid& another) noexcept;
-        StatsGrid& operator=(const StatsGrid& another) noexcept;
-
-        StatsGrid(StatsGrid&& another) noexcept;
-        StatsGrid& operator=(StatsGrid&& another) noexcept;
 
         double get_value(qualifier_t key) const;
+        bool empty() const;
 
-        // replaces ptr of stat if it exists
-        void set(StatPtr&& value);
+        // one pass over stats with Universal and given tags
+        FoldedStats fold(TagMask tags) const;
+
+        // replaces stat if it exists
+        void set(Stat value);
 
         bool contains(qualifier_t key) const;
 
         // emplaces element as regular stat with base 0.0 if it doesn't exist
-        IStat& at(qualifier_t key);
-        const IStat& at(qualifier_t key) const;
+        Stat& at(qualifier_t key);
+        const Stat& at(qualifier_t key) const;
 
         // adds value of stat if it exists
         // otherwise emplaces it
-        void add(const StatPtr& stat);
+        void add(const Stat& stat);
 
         // sums with other stats grid
         void add(const StatsGrid& another);
 
     protected:
         // map, because it's lightweight
-        // and emplaces new elements faster than unordered_map
+        // and emplaces new elements faster than unordered_map.
+        // stats are stored inline, so copy of grid is one allocation
         //std::map<size_t, StatPtr> m_content;
-        boost::flat_map<size_t, StatPtr> m_content;
+        boost::flat_map<size_t, Stat> m_content;
 
     private:
         static constexpr std::array<Tag, 1> default_tags = { Tag::Universal };
-
-        void _copy_from(const StatsGrid& another);
-
-        void _set_lookup_table_if_relative(StatPtr& ptr);
     };
 }
@@ -1,19 +1,13 @@
 #include "zzz/stats/regular.hpp"
 
-//std
-#include <memory>
-
 //library
 #include "library/format.hpp"
 
-//zzz
-#include "zzz/stats/relative.hpp"
-
 namespace zzz {
-    StatPtr RegularStat::make(StatId id, Tag tag, double base) {
-        return std::make_unique<RegularStat>(id, tag, base);
+    Stat RegularStat::make(StatId id, Tag tag, double base) {
+        return { id, tag, base };
     }
-    StatPtr RegularStat::make_from(const utl::Json& json, Tag tag) {
+    Stat RegularStat::make_from(const utl::Json& json, Tag tag) {
         const auto& as_array = json.as_array();
 
         switch (as_array.size()) {
@@ -35,44 +29,4 @@ namespace zzz {
             throw RUNTIME_ERROR("wrong arguments");
         }
     }
-
-    RegularStat::RegularStat(StatId id, Tag tag, double base) :
-        IStat(id, tag, base, 1) {
-    }
-
-    StatPtr RegularStat::copy() const {
-        return std::make_unique<RegularStat>(*this);
-    }
-
-    double RegularStat::value() const { return m_base; }
-
-    StatPtr RegularStat::add_as_copy(const StatPtr& another) {
-        StatPtr result;
-
-        switch (another->type()) {
-        case 1:
-            result = make(
-                m_unique.id,
-                m_unique.tag,
-                m_base + another->base()
-            );
-            break;
-
-        case 2: {
-            auto ptr = dynamic_cast<const RelativeStat&>(*another);
-            result = RelativeStat::make(
-                m_unique.id,
-                m_unique.tag,
-                m_base + ptr.base(),
-                ptr.formulas()
-            );
-            break;
-        }
-
-        default:
-            throw RUNTIME_ERROR("wrong another.type()");
-        }
-
-        return result;
-    }
 }
@@ -2,87 +2,99 @@
 
 //std
 #include <algorithm>
-#include <ranges>
-#include <stack>
+#include <optional>
 
 //library
 #include "library/format.hpp"
 #include "library/string_funcs.hpp"
-#include "library/template_math.hpp"
+
+//zzz
+#include "zzz/stats/grid.hpp"
 
 using enum lib::rpn_parser::TokenType;
 
 namespace zzz {
-    auto make_formulas(std::string_view source) {
-        formulas_t result;
-
-        for (const auto& it : lib::split_as_view(source, ';')) {
-            // divides on 2 parts: name and formula
-            auto splitted = lib::split_as_copy(it, ':');
-
-            // splitted[1] - actual formula
-            auto tokens = lib::RpnParser::tokenize(std::move(splitted[1]));
+    formulas_t make_formulas(std::string_view source) {
+        // variables are compiled as StatId
+        lib::RpnCompiler compiler([](std::string_view literal) { return (uint32_t) (size_t) (StatId) literal; });
+        std::optional<uint16_t> func, cond, max;
+
+        lib::for_each_split(source, ';', [&](std::string_view it) {
+            // divides on 2 parts: name and formula, formula itself can contain ':' of "?:"
+            auto [name, formula] = lib::split_once(it, ':');
+            if (name.empty() || name.size() == it.size())
+                throw FMT_RUNTIME_ERROR("formula \"{}\" has no name in \"{}\"", it, source);
+
+            auto tokens = lib::RpnParser::tokenize(formula);
             auto rpn = lib::RpnParser::shunting_yard_algorithm(tokens);
 
-            // converting strings to StatId
-            stat_rpn_t temp;
-            temp.reserve(rpn.size());
-            for (const auto& [type, literal, number] : rpn) {
-                switch (type) {
-                case Variable:
-                    temp.emplace_back(type, (StatId) literal);
-                    break;
-
-                default:
-                    // for operators and numbers
-                    temp.emplace_back(type, number);
-                }
+            // name[0] - first letter of formula name which can be used as identifier
+            std::optional<uint16_t>* target;
+            switch (name[0]) {
+            case 'f': target = &func; break;
+            case 'c': target = &cond; break;
+            case 'm': target = &max; break;
+            default:
+                throw FMT_RUNTIME_ERROR("unknown formula \"{}\" in \"{}\"", name, source);
             }
 
-            // splitted[0][0] - first letter of formula name which can be used as identifier
-            result.emplace(splitted[0][0], std::move(temp));
-        }
+            if (target->has_value())
+                throw FMT_RUNTIME_ERROR("formula \"{}\" is defined twice in \"{}\"", name, source);
+            *target = compiler.add(rpn);
+        });
 
-        return result;
-    }
+        if (!func.has_value())
+            throw FMT_RUNTIME_ERROR("formula \"{}\" has no f part", source);
 
-    double eval(const stat_rpn_t& rpn, const StatsGrid& variables) {
-        std::stack<double> stack;
+        // cond ? min(func, max) : 0
+        uint16_t root = *func;
+        if (max.has_value())
+            root = compiler.add_op(Min, root, *max);
+        if (cond.has_value())
+            root = compiler.add_op(Select, *cond, root, compiler.add_number(0.0));
 
-        for (const auto& it : rpn) {
-            if (it.type() == Number) {
-                stack.emplace(it.number());
-                continue;
-            }
+        return { .program = compiler.compile(root) };
+    }
+}
 
-            if (it.type() == Variable) {
-                stack.emplace(variables.get_value({ .id = it.variable(), .tag = Tag::Universal }));
-                continue;
-            }
+namespace zzz {
+    // Stat
+
+    double Stat::_relative_value(const StatsGrid& lookup_table) const {
+        return m_base + lib::eval_program(m_formulas->program, [&](uint32_t id) {
+            return lookup_table.get_value({ .id = (StatId) (size_t) id, .tag = Tag::Universal });
+        });
+    }
 
-            double rhs = stack.top();
-            stack.pop();
-            double lhs = stack.top();
-            stack.pop();
+    void Stat::values(std::span<const StatsGrid* const> lookup_tables, std::span<double> result) const {
+        if (lookup_tables.size() != result.size())
+            throw RUNTIME_ERROR("sizes of grids and result don't match");
 
-            stack.emplace(lib::switch_math_op(lhs, rhs, (char) it.type()));
+        if (!m_formulas) {
+            std::ranges::fill(result, m_base);
+            return;
         }
 
-        if (stack.size() > 1)
-            throw FMT_RUNTIME_ERROR("remaining stack size after rpn eval is {}", stack.size());
+        lib::eval_program_columns(m_formulas->program, [&](uint32_t id, size_t first, std::span<double> column) {
+            qualifier_t key = { .id = (StatId) (size_t) id, .tag = Tag::Universal };
+            for (size_t i = 0; i < column.size(); i++)
+                column[i] = lookup_tables[first + i]->get_value(key);
+        }, result);
 
-        return stack.top();
+        // the same order of operations as in _relative_value
+        for (auto& it : result)
+            it = m_base + it;
     }
-}
 
-namespace zzz {
-    StatPtr RelativeStat::make(StatId id, const Tag& tag, double base, formulas_t formulas) {
-        return std::make_unique<RelativeStat>(id, tag, base, std::move(formulas));
+    // RelativeStat
+
+    Stat RelativeStat::make(StatId id, Tag tag, double base, FormulasPtr formulas) {
+        return { id, tag, base, std::move(formulas) };
     }
-    StatPtr RelativeStat::make(StatId id, const Tag& tag, double base, std::string_view formulas) {
+    Stat RelativeStat::make(StatId id, Tag tag, double base, std::string_view formulas) {
         return make(id, tag, base, make_formulas(formulas));
     }
-    StatPtr RelativeStat::make_from(const utl::Json& json, Tag tag) {
+    Stat RelativeStat::make_from(const utl::Json& json, Tag tag) {
         const auto& as_array = json.as_array();
 
         switch (as_array.size()) {
@@ -107,69 +119,42 @@ namespace zzz {
         }
     }
 
-    RelativeStat::RelativeStat(StatId id, const Tag& tag, double base, formulas_t formulas) :
-        IStat(id, tag, base, 2),
-        m_formulas(std::move(formulas)) {
-    }
-    RelativeStat::RelativeStat(StatId id, const Tag& tag, double base, std::string_view formulas) :
-        RelativeStat(id, tag, base, make_formulas(formulas)) {
-    }
-    RelativeStat::RelativeStat(const RelativeStat& another) :
-        IStat(another.m_unique.id, another.m_unique.tag, another.m_base, 2),
-        m_formulas(another.m_formulas),
-        m_lookup_table(another.m_lookup_table) {
-    }
-
-    StatPtr RelativeStat::copy() const {
-        return std::make_unique<RelativeStat>(*this);
+    FormulasPtr RelativeStat::make_formulas(std::string_view source) {
+        return FormulaPool::instance().get(source);
     }
 
-    double RelativeStat::value() const {
-        if (!m_lookup_table)
-            throw RUNTIME_ERROR("you have to specify lookup_table first");
-
-        if (auto cond_rpn = m_formulas.find('c'); cond_rpn != m_formulas.end()
-            && !eval(cond_rpn->second, *m_lookup_table))
-            return m_base;
-
-        const auto& func_rpn = m_formulas.at('f');
-        double calculated = eval(func_rpn, *m_lookup_table);
-
-        if (auto max_rpn = m_formulas.find('m'); max_rpn != m_formulas.end()) {
-            double max = eval(max_rpn->second, *m_lookup_table);
-            calculated = std::min(calculated, max);
-        }
+    // FormulaPool
 
-        return m_base + calculated;
+    FormulaPool& FormulaPool::instance() {
+        static FormulaPool pool;
+        return pool;
     }
 
-    const formulas_t& RelativeStat::formulas() const { return m_formulas; }
+    FormulasPtr FormulaPool::get(std::string_view source) {
+        std::lock_guard lock(_mutex);
 
-    const StatsGrid* RelativeStat::lookup_table() const { return m_lookup_table; }
-    void RelativeStat::lookup_table(const StatsGrid* stats) { m_lookup_table = stats; }
-
-    StatPtr RelativeStat::add_as_copy(const StatPtr& another) {
-        StatPtr result;
-
-        switch (another->type()) {
-        case 1: {
-            result = make(
-                m_unique.id,
-                m_unique.tag,
-                m_base + another->base(),
-                m_formulas
-            );
-
-            break;
+        auto it = _formulas.find(source);
+        if (it != _formulas.end()) {
+            if (auto result = it->second.lock())
+                return result;
         }
 
-        case 2:
-            throw RUNTIME_ERROR("TODO");
-
-        default:
-            throw RUNTIME_ERROR("wrong another.type()");
+        // compilation can throw, so nothing is inserted before it's done
+        FormulasPtr result = std::make_shared<const formulas_t>(make_formulas(source));
+        if (it != _formulas.end())
+            it->second = result;
+        else {
+            if (_formulas.size() >= _sweep_at) {
+                std::erase_if(_formulas, [](const auto& pair) { return pair.second.expired(); });
+                _sweep_at = std::max<size_t>(64, _formulas.size() * 2);
+            }
+            _formulas.emplace(source, result);
         }
 
         return result;
     }
+    size_t FormulaPool::size() const {
+        std::lock_guard lock(_mutex);
+        return _formulas.size();
+    }
 }
@@ -1,65 +1,49 @@
 #pragma once
 
 //std
-#include <map>
-#include <variant>
-#include <vector>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
 
 //utl
 #include "utl/json.hpp"
 
-//library
-#include "library/rpn.hpp"
-
 //zzz
 #include "zzz/stats/basic.hpp"
-#include "zzz/stats/grid.hpp"
 
 namespace zzz {
-    class StatToken {
+    class RelativeStat {
     public:
-        template<typename T>
-            requires(std::is_same_v<T, double> || std::is_same_v<T, StatId>)
-        StatToken(lib::rpn_token_type type, T value) :
-            _type(type),
-            _value(value) {
-        }
-
-        lib::rpn_token_type type() const { return _type; }
+        static Stat make(StatId id, Tag tag, double base, std::string_view formulas);
+        static Stat make(StatId id, Tag tag, double base, FormulasPtr formulas);
+        static Stat make_from(const utl::Json& json, Tag tag);
 
-        double number() const { return std::get<double>(_value); }
-        StatId variable() const { return std::get<StatId>(_value); }
-
-    private:
-        lib::rpn_token_type _type;
-        std::variant<double, StatId> _value;
+        // "f:formula;c:condition;m:max", only f is required. compiled by FormulaPool
+        static FormulasPtr make_formulas(std::string_view source);
     };
-    using stat_rpn_t = std::vector<StatToken>;
-    using formulas_t = std::map<char, stat_rpn_t>;
 
-    class RelativeStat : public IStat {
+    // process-wide pool of compiled formulas keyed by source text, equal sources
+    // of agents, wengines, dds and requests share one program.
+    // pool keeps weak references, so formulas of unloaded objects are freed
+    class FormulaPool {
     public:
-        static StatPtr make(StatId id, const Tag& tag, double base, std::string_view formulas);
-        static StatPtr make(StatId id, const Tag& tag, double base, formulas_t formulas);
-        static StatPtr make_from(const utl::Json& json, Tag tag);
+        static FormulaPool& instance();
 
-        RelativeStat(StatId id, const Tag& tag, double base, std::string_view formulas);
-        RelativeStat(StatId id, const Tag& tag, double base, formulas_t formulas);
-        RelativeStat(const RelativeStat& another);
+        FormulasPtr get(std::string_view source);
+        // including expired ones which aren't swept yet
+        size_t size() const;
 
-        StatPtr copy() const override;
-
-        double value() const override;
-
-        const formulas_t& formulas() const;
-
-        const StatsGrid* lookup_table() const;
-        void lookup_table(const StatsGrid* stats);
+    private:
+        struct hash_t {
+            using is_transparent = void;
+            size_t operator()(std::string_view what) const { return std::hash<std::string_view>()(what); }
+        };
 
-    protected:
-        formulas_t m_formulas;
-        const StatsGrid* m_lookup_table = nullptr;
+        mutable std::mutex _mutex;
+        std::unordered_map<std::string, std::weak_ptr<const formulas_t>, hash_t, std::equal_to<>> _formulas;
+        size_t _sweep_at = 64;
 
-        StatPtr add_as_copy(const StatPtr& another) override;
+        FormulaPool() = default;
     };
 }
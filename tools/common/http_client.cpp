@@ -0,0 +1,162 @@
+#include "common/http_client.hpp"
+
+//std
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <stdexcept>
+
+//library
+#include "library/format.hpp"
+#include "library/string_funcs.hpp"
+
+namespace tools::http_details {
+    constexpr std::string_view header_end = "\r\n\r\n";
+
+    bool iequals(std::string_view lhs, std::string_view rhs) {
+        return std::ranges::equal(lhs, rhs, [](char l, char r) {
+            return std::tolower((unsigned char) l) == std::tolower((unsigned char) r);
+        });
+    }
+
+    std::string_view trim(std::string_view what) {
+        while (!what.empty() && (what.front() == ' ' || what.front() == '\t'))
+            what.remove_prefix(1);
+        while (!what.empty() && (what.back() == ' ' || what.back() == '\t' || what.back() == '\r'))
+            what.remove_suffix(1);
+        return what;
+    }
+
+    struct header_info_t {
+        int code = 0;
+        size_t content_length = 0;
+        bool close_connection = false;
+        std::string content_type;
+    };
+
+    // "HTTP/1.1 200 OK\r\nContent-Length: 12\r\n..."
+    header_info_t parse_header(std::string_view header) {
+        header_info_t result;
+        auto lines = lib::split_as_view(header, '\n');
+
+        if (lines.empty())
+            throw RUNTIME_ERROR("empty http response");
+
+        auto status = lib::split_as_view(lines[0], ' ');
+        if (status.size() < 2)
+            throw FMT_RUNTIME_ERROR("bad status line \"{}\"", lines[0]);
+        result.code = lib::sv_to<int>(status[1]);
+        result.close_connection = status[0] == "HTTP/1.0";
+
+        for (size_t i = 1; i < lines.size(); i++) {
+            auto colon = lines[i].find(':');
+            if (colon == std::string_view::npos)
+                continue;
+
+            auto key = trim(lines[i].substr(0, colon));
+            auto value = trim(lines[i].substr(colon + 1));
+
+            if (iequals(key, "Content-Length"))
+                result.content_length = lib::sv_to<size_t>(value);
+            else if (iequals(key, "Connection"))
+                result.close_connection = iequals(value, "close");
+            else if (iequals(key, "Content-Type"))
+                result.content_type = value;
+        }
+
+        return result;
+    }
+}
+
+namespace tools {
+    HttpClient::HttpClient(std::string host, uint16_t port, bool keep_alive) :
+        m_host(std::move(host)),
+        m_port(port),
+        m_keep_alive(keep_alive),
+        m_socket(m_context) {
+        asio::ip::tcp::resolver resolver(m_context);
+        m_endpoints = resolver.resolve(m_host, std::to_string(m_port));
+    }
+    HttpClient::~HttpClient() {
+        _close();
+    }
+
+    http_response_t HttpClient::request(
+        std::string_view method,
+        std::string_view target,
+        std::string_view body,
+        std::string_view content_type,
+        const http_headers_t& headers) {
+        bool was_open = m_socket.is_open();
+
+        try {
+            return _request_logic(method, target, body, content_type, headers);
+        } catch (const std::exception&) {
+            _close();
+            // server may drop idle keep-alive connection, so one retry on fresh socket is fair
+            if (!was_open)
+                throw;
+        }
+
+        return _request_logic(method, target, body, content_type, headers);
+    }
+
+    bool HttpClient::keep_alive() const { return m_keep_alive; }
+
+    void HttpClient::_connect() {
+        asio::connect(m_socket, m_endpoints);
+        m_socket.set_option(asio::ip::tcp::no_delay(true));
+        _buffer.clear();
+    }
+    void HttpClient::_close() {
+        if (!m_socket.is_open())
+            return;
+
+        asio::error_code ec;
+        m_socket.shutdown(asio::ip::tcp::socket::shutdown_both, ec);
+        m_socket.close(ec);
+    }
+
+    http_response_t HttpClient::_request_logic(
+        std::string_view method,
+        std::string_view target,
+        std::string_view body,
+        std::string_view content_type,
+        const http_headers_t& headers) {
+        if (!m_socket.is_open())
+            _connect();
+
+        auto head = lib::format("{} {} HTTP/1.1\r\nHost: {}:{}\r\nConnection: {}\r\n",
+            method, target, m_host, m_port, m_keep_alive ? "keep-alive" : "close");
+        if (!body.empty())
+            head += lib::format("Content-Type: {}\r\n", content_type);
+        for (const auto& [name, value] : headers)
+            head += lib::format("{}: {}\r\n", name, value);
+        head += lib::format("Content-Length: {}\r\n\r\n", body.size());
+
+        std::array<asio::const_buffer, 2> buffers = {
+            asio::buffer(head),
+            asio::buffer(body.data(), body.size())
+        };
+        asio::write(m_socket, buffers);
+
+        size_t header_size = asio::read_until(m_socket, asio::dynamic_buffer(_buffer), http_details::header_end);
+        auto info = http_details::parse_header({ _buffer.data(), header_size });
+
+        size_t available = _buffer.size() - header_size;
+        if (available < info.content_length)
+            asio::read(m_socket, asio::dynamic_buffer(_buffer),
+                asio::transfer_exactly(info.content_length - available));
+
+        http_response_t result;
+        result.code = info.code;
+        result.content_type = std::move(info.content_type);
+        result.body.assign(_buffer.data() + header_size, info.content_length);
+        _buffer.erase(0, header_size + info.content_length);
+
+        if (!m_keep_alive || info.close_connection)
+            _close();
+
+        return result;
+    }
+}
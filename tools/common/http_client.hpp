@@ -0,0 +1,67 @@
+#pragma once
+
+//std
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+//asio
+#include "asio.hpp"
+
+namespace tools {
+    struct http_response_t {
+        int code = 0;
+        std::string body;
+        std::string content_type;
+    };
+
+    // name and value, written as is after Content-Type
+    using http_headers_t = std::vector<std::pair<std::string, std::string>>;
+
+    // minimal blocking HTTP/1.1 client, enough to talk to the crow backend
+    // one instance per thread, it isn't thread safe
+    class HttpClient {
+    public:
+        HttpClient(std::string host, uint16_t port, bool keep_alive = true);
+        ~HttpClient();
+
+        // reconnects on demand if connection was closed by either side
+        http_response_t request(
+            std::string_view method,
+            std::string_view target,
+            std::string_view body = {},
+            std::string_view content_type = "application/json",
+            const http_headers_t& headers = {});
+
+        bool keep_alive() const;
+
+        // deleted members
+
+        HttpClient(const HttpClient&) = delete;
+        HttpClient& operator=(const HttpClient&) = delete;
+
+    protected:
+        std::string m_host;
+        uint16_t m_port;
+        bool m_keep_alive;
+
+        asio::io_context m_context;
+        asio::ip::tcp::socket m_socket;
+        asio::ip::tcp::resolver::results_type m_endpoints;
+
+    private:
+        std::string _buffer;
+
+        void _connect();
+        void _close();
+
+        http_response_t _request_logic(
+            std::string_view method,
+            std::string_view target,
+            std::string_view body,
+            std::string_view content_type,
+            const http_headers_t& headers);
+    };
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+//std
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <string_view>
+#include <vector>
+
+//library
+#include "library/format.hpp"
+
+namespace tools {
+    // nearest-rank percentile, expects sorted input
+    inline double percentile(const std::vector<double>& sorted, double p) {
+        if (sorted.empty())
+            return 0.0;
+
+        auto rank = (size_t) std::ceil(p * (double) sorted.size());
+        return sorted[std::clamp<size_t>(rank, 1, sorted.size()) - 1];
+    }
+
+    inline void print_latency_header() {
+        std::cout << lib::format("{:<28} {:>9} {:>7} {:>10} {:>9} {:>9} {:>9} {:>9}\n",
+            "route", "requests", "errors", "req/s", "p50 ms", "p99 ms", "p999 ms", "max ms");
+    }
+    // sorts latencies in place
+    inline void print_latency_line(std::string_view label, std::vector<double>& latencies, size_t errors, double seconds) {
+        std::ranges::sort(latencies);
+
+        std::cout << lib::format("{:<28} {:>9} {:>7} {:>10.1f} {:>9.3f} {:>9.3f} {:>9.3f} {:>9.3f}\n",
+            label,
+            latencies.size(),
+            errors,
+            seconds > 0.0 ? (double) latencies.size() / seconds : 0.0,
+            percentile(latencies, 0.5),
+            percentile(latencies, 0.99),
+            percentile(latencies, 0.999),
+            latencies.empty() ? 0.0 : latencies.back());
+    }
+}
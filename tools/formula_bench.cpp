@@ -0,0 +1,538 @@
+// measures parsing of every relative stat formula and rotation cell found in res/data:
+// time and heap allocations per operation of each stage of formula compilation
+// and of splitters used by rotation loading.
+// --check instead compares every optimized evaluation path with its reference bit by bit
+// and exits with 1 if any result differs
+//
+// usage: formula_bench [--res ./res] [--duration 200] (ms per benchmark)
+//        formula_bench --check [--res ./res] [--inputs 5003] [--seed 1]
+
+//std
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+//utl
+#include "utl/json.hpp"
+
+//library
+#include "library/cached_memory.hpp"
+#include "library/format.hpp"
+#include "library/rpn.hpp"
+#include "library/string_funcs.hpp"
+
+//zzz
+#include "zzz/enums.hpp"
+#include "zzz/stats/grid.hpp"
+#include "zzz/stats/regular.hpp"
+#include "zzz/stats/relative.hpp"
+
+//calculator
+#include "calc/batch.hpp"
+#include "calc/calculator.hpp"
+#include "calc/details.hpp"
+
+//backend
+#include "backend/impl/details.hpp"
+
+namespace fs = std::filesystem;
+
+namespace global {
+    std::string PATH;
+}
+
+// every heap allocation of process is counted, benchmarks are single-threaded
+namespace tools::formula_details {
+    std::atomic_size_t allocations = 0;
+}
+
+void* operator new(size_t size) {
+    tools::formula_details::allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* result = std::malloc(size ? size : 1))
+        return result;
+    throw std::bad_alloc();
+}
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { std::free(ptr); }
+
+namespace tools::formula_details {
+    using clock = std::chrono::steady_clock;
+
+    struct config_t {
+        std::string res = "./res";
+        double duration_ms = 200.0;
+        bool is_check = false;
+        // random inputs of every check
+        size_t inputs = 5003;
+        uint64_t seed = 1;
+    };
+
+    struct sources_t {
+        // whole "f:...;c:...;m:..." strings
+        std::vector<std::string> formulas;
+        // formula parts without names
+        std::vector<std::string> parts;
+        std::vector<std::string> cells;
+    };
+
+    config_t parse_args(int argc, char** argv) {
+        config_t result;
+
+        for (int i = 1; i < argc; i++) {
+            std::string_view key = argv[i];
+            auto next = [&] {
+                if (i + 1 >= argc)
+                    throw FMT_RUNTIME_ERROR("{} requires value", key);
+                return std::string_view(argv[++i]);
+            };
+
+            if (key == "--res")
+                result.res = next();
+            else if (key == "--duration")
+                result.duration_ms = std::stod(std::string(next()));
+            else if (key == "--check")
+                result.is_check = true;
+            else if (key == "--inputs")
+                result.inputs = std::stoul(std::string(next()));
+            else if (key == "--seed")
+                result.seed = std::stoull(std::string(next()));
+            else
+                throw FMT_RUNTIME_ERROR("unknown argument \"{}\"", key);
+        }
+
+        return result;
+    }
+
+    // "f:...;c:...;m:..." where every part is named by one of f, c, m
+    bool is_formula(std::string_view what) {
+        bool result = !what.empty();
+        lib::for_each_split(what, ';', [&result](std::string_view part) {
+            auto [name, formula] = lib::split_once(part, ':');
+            result &= name.size() == 1 && (name[0] == 'f' || name[0] == 'c' || name[0] == 'm') && !formula.empty();
+        });
+        return result;
+    }
+
+    void collect(const utl::Json& json, sources_t& sources, bool is_cell) {
+        if (json.is_string()) {
+            const auto& str = json.as_string();
+            if (is_cell)
+                sources.cells.emplace_back(str);
+            else if (is_formula(str)) {
+                sources.formulas.emplace_back(str);
+                lib::for_each_split(str, ';', [&sources](std::string_view part) {
+                    sources.parts.emplace_back(lib::split_once(part, ':').second);
+                });
+            }
+        } else if (json.is_array()) {
+            for (const auto& it : json.as_array())
+                collect(it, sources, is_cell);
+        } else if (json.is_object()) {
+            // strings of rotation "vals" are cells
+            for (const auto& [k, v] : json.as_object())
+                collect(v, sources, is_cell || k == "vals");
+        }
+    }
+
+    sources_t load_sources(const std::string& res) {
+        sources_t result;
+
+        for (const auto& entry : fs::recursive_directory_iterator(fs::path(res) / "data")) {
+            if (entry.is_regular_file() && entry.path().extension() == ".json")
+                collect(utl::json::from_file(entry.path().string()), result, false);
+        }
+
+        return result;
+    }
+
+    // runs func over every input until duration passes
+    template<typename T, typename F>
+    void bench(std::string_view label, const std::vector<T>& inputs, double duration_ms, F&& func) {
+        if (inputs.empty()) {
+            std::cout << lib::format("{:<28} no inputs\n", label);
+            return;
+        }
+
+        size_t operations = 0, sink = 0;
+        size_t allocated = allocations.load();
+        auto start = clock::now();
+        double elapsed_ms = 0.0;
+
+        while (elapsed_ms < duration_ms) {
+            for (const auto& it : inputs)
+                sink += func(it);
+            operations += inputs.size();
+            elapsed_ms = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+        }
+
+        allocated = allocations.load() - allocated;
+        std::cout << lib::format("{:<28} {:>10} {:>10.1f} {:>12.2f} {:>8}\n",
+            label,
+            operations,
+            elapsed_ms * 1e6 / (double) operations,
+            (double) allocated / (double) operations,
+            sink % 10);
+    }
+
+    // checks
+
+    // NaN of both paths is the same result whatever its bits are
+    bool is_same(double lhs, double rhs) {
+        return std::bit_cast<uint64_t>(lhs) == std::bit_cast<uint64_t>(rhs) || (std::isnan(lhs) && std::isnan(rhs));
+    }
+
+    void report(std::string_view label, size_t checked, size_t mismatches) {
+        std::cout << lib::format("{:<36} {:>10} {:>10}\n", label, checked, mismatches);
+    }
+
+    // rpn evaluated on stack as it is, without folding and sharing of RpnCompiler
+    double interpret(const lib::tokenized_rpn_t& rpn, const lib::RpnCompiler::resolver_t& resolver, std::span<const double> variables) {
+        using namespace lib::rpn_parser;
+
+        std::vector<double> stack;
+        for (const auto& token : rpn) {
+            if (token.type == Number) {
+                stack.emplace_back(token.number);
+                continue;
+            }
+            if (token.type == Variable) {
+                stack.emplace_back(variables[resolver(token.literal)]);
+                continue;
+            }
+
+            if (stack.size() < arity(token.type))
+                throw RUNTIME_ERROR("rpn is malformed");
+
+            double second, third = 0.0;
+            if (arity(token.type) == 3) {
+                third = stack.back();
+                stack.pop_back();
+            }
+            second = stack.back();
+            stack.pop_back();
+
+            stack.back() = arity(token.type) == 3
+                ? lib::switch_math_op(stack.back(), second, third, token.type)
+                : lib::switch_math_op(stack.back(), second, token.type);
+        }
+
+        if (stack.size() != 1)
+            throw RUNTIME_ERROR("rpn is malformed");
+        return stack.back();
+    }
+
+    // ratios, whole numbers for comparisons and large values
+    double random_value(std::mt19937_64& rng) {
+        std::uniform_real_distribution<double> distribution(0.0, 300.0);
+
+        switch (rng() % 3) {
+        case 0: return distribution(rng) / 300.0;
+        case 1: return std::round(distribution(rng));
+        default: return distribution(rng);
+        }
+    }
+
+    std::vector<zzz::StatsGrid> random_grids(std::mt19937_64& rng, size_t count) {
+        std::vector<zzz::StatsGrid> result(count);
+
+        for (auto& grid : result) {
+            for (size_t id = 1; id < (size_t) zzz::StatId::Count; id++)
+                grid.set(zzz::RegularStat::make(id, zzz::Tag::Universal, random_value(rng)));
+            // few stats of other tags, so folding has something to sum
+            for (size_t i = 0; i < 16; i++) {
+                zzz::StatId id = 1 + rng() % ((size_t) zzz::StatId::Count - 1);
+                zzz::Tag tag = (zzz::Tag::Enum) (1 + rng() % ((size_t) zzz::Tag::Count - 1));
+                grid.add(zzz::RegularStat::make(id, tag, random_value(rng)));
+            }
+        }
+
+        return result;
+    }
+
+    // RpnCompiler against interpretation of rpn and eval_program_columns against eval_program
+    size_t check_programs(const sources_t& sources, const config_t& config, const lib::RpnCompiler::resolver_t& resolver) {
+        std::mt19937_64 rng(config.seed);
+
+        std::vector<std::vector<double>> inputs(config.inputs, std::vector<double>((size_t) zzz::StatId::Count));
+        for (auto& input : inputs)
+            std::ranges::generate(input, [&rng] { return random_value(rng); });
+
+        size_t checked = 0, compiled_mismatches = 0, columns_mismatches = 0;
+        std::vector<double> columns(config.inputs);
+
+        for (const auto& part : sources.parts) {
+            lib::tokenized_rpn_t rpn;
+            lib::rpn_program_t program;
+            try {
+                rpn = lib::RpnParser::shunting_yard_algorithm(lib::RpnParser::tokenize(part));
+                lib::RpnCompiler compiler(resolver);
+                program = compiler.compile(compiler.add(rpn));
+            } catch (const std::exception&) {
+                continue;
+            }
+
+            lib::eval_program_columns(program, [&inputs](uint32_t variable, size_t first, std::span<double> column) {
+                for (size_t i = 0; i < column.size(); i++)
+                    column[i] = inputs[first + i][variable];
+            }, columns);
+
+            for (size_t i = 0; i < inputs.size(); i++) {
+                double scalar = lib::eval_program(program, [&input = inputs[i]](uint32_t variable) { return input[variable]; });
+
+                compiled_mismatches += !is_same(scalar, interpret(rpn, resolver, inputs[i]));
+                columns_mismatches += !is_same(scalar, columns[i]);
+            }
+            checked += inputs.size();
+        }
+
+        report("compiled vs interpreted rpn", checked, compiled_mismatches);
+        report("eval_program_columns vs eval_program", checked, columns_mismatches);
+        return compiled_mismatches + columns_mismatches;
+    }
+
+    // Stat::values against Stat::value on every grid
+    size_t check_stat_values(const sources_t& sources, const config_t& config) {
+        std::mt19937_64 rng(config.seed);
+        auto grids = random_grids(rng, config.inputs);
+
+        std::vector<const zzz::StatsGrid*> pointers;
+        pointers.reserve(grids.size());
+        for (const auto& it : grids)
+            pointers.emplace_back(&it);
+
+        std::vector<zzz::Stat> stats;
+        for (size_t id = 1; id < (size_t) zzz::StatId::Count; id++) {
+            try {
+                stats.emplace_back(zzz::StatsGrid::make_defined_relative_stat(id, zzz::Tag::Universal));
+            } catch (const std::exception&) {
+                // regular stat
+            }
+        }
+        for (const auto& formula : sources.formulas) {
+            try {
+                stats.emplace_back(zzz::RelativeStat::make(zzz::StatId::AtkFlat, zzz::Tag::Universal, 0.0, formula));
+            } catch (const std::exception&) {
+                // skipped by benchmarks too
+            }
+        }
+
+        size_t checked = 0, mismatches = 0;
+        std::vector<double> values(grids.size());
+
+        for (const auto& stat : stats) {
+            stat.values(pointers, values);
+            for (size_t i = 0; i < grids.size(); i++)
+                mismatches += !is_same(values[i], stat.value(grids[i]));
+            checked += grids.size();
+        }
+
+        report("Stat::values vs Stat::value", checked, mismatches);
+        return mismatches;
+    }
+
+    // StatsGrid::fold against lookups of every stat
+    size_t check_folding(const config_t& config) {
+        std::mt19937_64 rng(config.seed);
+        auto grids = random_grids(rng, config.inputs);
+
+        size_t checked = 0, mismatches = 0;
+        for (auto& grid : grids) {
+            // relative stats are folded with their values
+            for (size_t id = 1; id < (size_t) zzz::StatId::Count; id++) {
+                try {
+                    grid.set(zzz::StatsGrid::make_defined_relative_stat(id, zzz::Tag::Universal));
+                } catch (const std::exception&) {
+                    // regular stat
+                }
+            }
+
+            auto tags = zzz::TagMask::from_bits((uint16_t) ((rng() % (1 << ((size_t) zzz::Tag::Count - 1))) << 1));
+            auto folded = grid.fold(tags);
+
+            for (size_t id = 0; id < (size_t) zzz::StatId::Count; id++) {
+                mismatches += !is_same(folded.universal[id], grid.get_value({ .id = id, .tag = zzz::Tag::Universal }));
+                mismatches += !is_same(folded.total[id], calc::details::get_value(grid, id, tags));
+            }
+            checked += 2 * (size_t) zzz::StatId::Count;
+        }
+
+        report("StatsGrid::fold vs get_value", checked, mismatches);
+        return mismatches;
+    }
+
+    // bodies of POST /damage from res/tests/examples/requests.http
+    std::vector<utl::Json> load_damage_requests(const std::string& res) {
+        std::ifstream file(fs::path(res) / "tests" / "examples" / "requests.http");
+        std::stringstream content;
+        content << file.rdbuf();
+
+        std::vector<utl::Json> result;
+        lib::for_each_split(content.view(), '#', [&result](std::string_view block) {
+            size_t body = block.find('{');
+            if (!block.contains("POST") || !block.contains("/damage") || body == std::string_view::npos)
+                return;
+
+            try {
+                result.emplace_back(utl::json::from_string(std::string(block.substr(body))));
+            } catch (const std::exception&) {
+                // not a json body
+            }
+        });
+
+        return result;
+    }
+
+    // Calculator::eval_batch against Calculator::eval on random builds of example requests
+    // and widest batch kernel against scalar one on random columns
+    size_t check_batch(const config_t& config) {
+        constexpr size_t builds = 257;
+
+        std::mt19937_64 rng(config.seed);
+        global::PATH = config.res;
+        lib::ObjectManager manager;
+        backend::details::prepare_object_manager(manager);
+
+        size_t checked = 0, mismatches = 0;
+        for (auto& source : load_damage_requests(config.res)) {
+            std::vector<calc::request_t> requests(builds);
+            try {
+                for (auto& request : requests) {
+                    for (auto& disc : source["discs"].as_array()) {
+                        auto& levels = disc["levels"].as_array();
+                        for (size_t i = 1; i < levels.size(); i++)
+                            levels[i] = (int64_t) (rng() % 6);
+                    }
+                    backend::details::prepare_request_details(request, source);
+                    backend::details::prepare_request_composed(request, manager);
+                }
+            } catch (const std::exception& e) {
+                std::cout << lib::format("skipped example request: {}\n", e.what());
+                continue;
+            }
+
+            auto batch = calc::Calculator::eval_batch(requests);
+            for (size_t i = 0; i < requests.size(); i++) {
+                const auto& [total_dmg, per_ability] = calc::Calculator::eval(requests[i]);
+                const auto& [batch_total_dmg, batch_per_ability] = batch[i];
+
+                mismatches += !is_same(total_dmg, batch_total_dmg);
+                for (size_t j = 0; j < per_ability.size(); j++)
+                    mismatches += !is_same(per_ability[j], batch_per_ability[j]);
+                checked += 1 + per_ability.size();
+            }
+        }
+        report("Calculator::eval_batch vs eval", checked, mismatches);
+
+        calc::batch::Columns columns(config.inputs);
+        std::uniform_real_distribution<double> distribution(-0.5, 3.0);
+        for (auto* column : { &columns.atk_total, &columns.crit_rate, &columns.crit_dmg, &columns.dmg_ratio,
+                 &columns.dmg_ratio_element, &columns.anomaly_ratio, &columns.anomaly_ratio_element, &columns.vulnerability,
+                 &columns.def_pen_ratio, &columns.def_pen_flat, &columns.res_pen, &columns.res_pen_element }) {
+            double scale = column == &columns.atk_total ? 3000.0 : column == &columns.def_pen_flat ? 1000.0 : 1.0;
+            for (auto& it : *column)
+                it = distribution(rng) * scale;
+        }
+
+        calc::batch::cell_consts_t cell = { .scale = 1.234, .defense = 953.0, .dmg_taken_base = 0.8, .res_base = 0.8, .stun_mult = 1.5 };
+        std::vector<double> widest(config.inputs), scalar(config.inputs);
+        calc::batch::eval(cell, columns, widest);
+        calc::batch::eval_scalar(cell, columns, scalar);
+
+        size_t kernel_mismatches = 0;
+        for (size_t i = 0; i < config.inputs; i++)
+            kernel_mismatches += !is_same(widest[i], scalar[i]);
+        report(lib::format("batch kernel {} vs scalar", calc::batch::selected_isa()), config.inputs, kernel_mismatches);
+
+        return mismatches + kernel_mismatches;
+    }
+}
+
+int main(int argc, char** argv) try {
+    using namespace tools::formula_details;
+
+    auto config = parse_args(argc, argv);
+
+    auto sources = load_sources(config.res);
+    std::cout << lib::format("{} formulas ({} parts) and {} rotation cells from {}/data\n\n",
+        sources.formulas.size(), sources.parts.size(), sources.cells.size(), config.res);
+
+    // the same steps as RelativeStat formulas go through
+    lib::RpnCompiler::resolver_t resolver = [](std::string_view literal) { return (uint32_t) (size_t) (zzz::StatId) literal; };
+
+    if (config.is_check) {
+        std::cout << lib::format("{:<36} {:>10} {:>10}\n", "check", "values", "mismatches");
+
+        size_t mismatches = check_programs(sources, config, resolver)
+            + check_stat_values(sources, config)
+            + check_folding(config)
+            + check_batch(config);
+
+        return mismatches == 0 ? 0 : 1;
+    }
+
+    std::vector<lib::rpn_program_t> programs;
+    std::erase_if(sources.parts, [&](const std::string& it) {
+        try {
+            lib::RpnCompiler compiler(resolver);
+            programs.emplace_back(compiler.compile(compiler.add(lib::RpnParser::shunting_yard_algorithm(lib::RpnParser::tokenize(it)))));
+            return false;
+        } catch (const std::exception& e) {
+            std::cout << lib::format("skipped \"{}\": {}\n", it, e.what());
+            return true;
+        }
+    });
+
+    std::cout << lib::format("{:<28} {:>10} {:>10} {:>12} {:>8}\n", "benchmark", "ops", "ns/op", "allocs/op", "sink");
+
+    bench("tokenize", sources.parts, config.duration_ms, [](const std::string& it) {
+        return lib::RpnParser::tokenize(it).size();
+    });
+    bench("tokenize + shunting yard", sources.parts, config.duration_ms, [](const std::string& it) {
+        return lib::RpnParser::shunting_yard_algorithm(lib::RpnParser::tokenize(it)).size();
+    });
+    bench("compile part", sources.parts, config.duration_ms, [&resolver](const std::string& it) {
+        lib::RpnCompiler compiler(resolver);
+        return compiler.compile(compiler.add(lib::RpnParser::shunting_yard_algorithm(lib::RpnParser::tokenize(it)))).size();
+    });
+    bench("eval program", programs, config.duration_ms, [](const lib::rpn_program_t& it) {
+        return (size_t) lib::eval_program(it, [](uint32_t variable) { return (double) variable; });
+    });
+    bench("split formula (view)", sources.formulas, config.duration_ms, [](const std::string& it) {
+        size_t result = 0;
+        lib::for_each_split(it, ';', [&result](std::string_view part) { result += lib::split_once(part, ':').second.size(); });
+        return result;
+    });
+    bench("split formula (copy)", sources.formulas, config.duration_ms, [](const std::string& it) {
+        size_t result = 0;
+        for (const auto& part : lib::split_as_copy(it, ';'))
+            result += lib::split_as_copy(part, ':').back().size();
+        return result;
+    });
+    bench("split cell (view)", sources.cells, config.duration_ms, [](const std::string& it) {
+        size_t result = 0;
+        lib::for_each_split(it, ' ', [&result](std::string_view part) { result += part.size(); });
+        return result;
+    });
+    bench("split cell (vector)", sources.cells, config.duration_ms, [](const std::string& it) {
+        size_t result = 0;
+        for (const auto& part : lib::split_as_view(it, ' '))
+            result += part.size();
+        return result;
+    });
+
+    return 0;
+} catch (const std::exception& e) {
+    std::cerr << e.what() << '\n';
+    return 1;
+}
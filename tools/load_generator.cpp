@@ -0,0 +1,398 @@
+// closed-loop load generator for backend
+// every worker keeps exactly one request in flight and fires the next one right after response,
+// so measured throughput is what server can sustain at given concurrency
+//
+// usage: load_generator [--host 127.0.0.1] [--port 5102] [--concurrency 8]
+//                       [--duration 10] [--requests 0] [--warmup 1]
+//                       [--mix damage=70,detailed=25,rotation=5,refresh=0]
+//                       [--no-keep-alive] [--res ./res] [--pool 256] [--seed 0]
+//                       [--aid 1091] [--wid 14109] [--rotation 1] [--sets 32500,32800]
+//
+// "rotation" requests PUT /rotation?aid={aid}&id=load_generator, so server keeps
+// data/rotations/{aid}/load_generator.json after run, it has to be removed by hand
+
+//std
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+//utl
+#include "utl/json.hpp"
+
+//library
+#include "library/format.hpp"
+#include "library/string_funcs.hpp"
+
+//tools
+#include "common/http_client.hpp"
+#include "common/stats.hpp"
+
+namespace tools::load_details {
+    using clock = std::chrono::steady_clock;
+
+    enum Route : uint8_t {
+        Damage, DamageDetailed, Rotation, Refresh,
+        RouteCount
+    };
+
+    constexpr std::array<std::string_view, RouteCount> route_names = {
+        "damage", "detailed", "rotation", "refresh"
+    };
+    constexpr std::array<std::string_view, RouteCount> route_labels = {
+        "POST /damage", "POST /damage?type=detailed", "PUT /rotation", "POST /refresh"
+    };
+
+    // mirrors drive_disc_info tables from zzz/details/ddp.cpp
+    const std::array<std::vector<std::string_view>, 6> main_stats_by_slot = { {
+        { "HpFlat" },
+        { "AtkFlat" },
+        { "DefFlat" },
+        { "AtkRatio", "HpRatio", "DefRatio", "Ap", "CritRate", "CritDmg" },
+        { "AtkRatio", "HpRatio", "DefRatio", "DefPenRatio", "PhysRatio", "FireRatio", "IceRatio", "ElectricRatio", "EtherRatio" },
+        { "AtkRatio", "HpRatio", "DefRatio", "AmRatio", "ErRatio", "ImpactRatio" }
+    } };
+    const std::vector<std::string_view> sub_stats = {
+        "AtkFlat", "AtkRatio", "HpFlat", "HpRatio", "DefFlat",
+        "DefRatio", "CritRate", "CritDmg", "DefPenFlat", "Ap"
+    };
+    // S rank disc gets 4 or 5 upgrades spread over its sub stats
+    constexpr size_t min_upgrades = 4, max_upgrades = 5;
+    constexpr size_t main_stat_level = 15;
+
+    struct config_t {
+        std::string host = "127.0.0.1";
+        uint16_t port = 5102;
+        size_t concurrency = 8;
+        double duration = 10.0, warmup = 1.0;
+        size_t requests = 0;
+        std::array<size_t, RouteCount> mix = { 70, 25, 5, 0 };
+        bool keep_alive = true;
+        std::string res = "./res";
+        size_t pool = 256;
+        uint64_t seed = 0;
+        uint64_t aid = 1091, wid = 14109, rotation = 1;
+        std::vector<uint64_t> sets = { 32500, 32800 };
+    };
+
+    struct sample_t {
+        Route route;
+        bool is_error;
+        double ms;
+    };
+
+    struct worker_result_t {
+        std::vector<sample_t> samples;
+        size_t transport_errors = 0;
+    };
+
+    void parse_mix(config_t& config, std::string_view what) {
+        config.mix.fill(0);
+
+        for (auto pair : lib::split_as_view(what, ',')) {
+            auto splitted = lib::split_as_view(pair, '=');
+            if (splitted.size() != 2)
+                throw FMT_RUNTIME_ERROR("bad mix entry \"{}\"", pair);
+
+            auto it = std::ranges::find(route_names, splitted[0]);
+            if (it == route_names.end())
+                throw FMT_RUNTIME_ERROR("unknown route \"{}\" in mix", splitted[0]);
+
+            config.mix[it - route_names.begin()] = lib::sv_to<size_t>(splitted[1]);
+        }
+    }
+
+    config_t parse_args(int argc, char** argv) {
+        config_t result;
+
+        for (int i = 1; i < argc; i++) {
+            std::string_view key = argv[i];
+            auto next = [&] {
+                if (i + 1 >= argc)
+                    throw FMT_RUNTIME_ERROR("{} requires value", key);
+                return std::string_view(argv[++i]);
+            };
+
+            if (key == "--host")
+                result.host = next();
+            else if (key == "--port")
+                result.port = lib::sv_to<uint16_t>(next());
+            else if (key == "--concurrency")
+                result.concurrency = std::max<size_t>(lib::sv_to<size_t>(next()), 1);
+            else if (key == "--duration")
+                result.duration = std::stod(std::string(next()));
+            else if (key == "--warmup")
+                result.warmup = std::stod(std::string(next()));
+            else if (key == "--requests")
+                result.requests = lib::sv_to<size_t>(next());
+            else if (key == "--mix")
+                parse_mix(result, next());
+            else if (key == "--no-keep-alive")
+                result.keep_alive = false;
+            else if (key == "--res")
+                result.res = next();
+            else if (key == "--pool")
+                result.pool = std::max<size_t>(lib::sv_to<size_t>(next()), 1);
+            else if (key == "--seed")
+                result.seed = lib::sv_to<uint64_t>(next());
+            else if (key == "--aid")
+                result.aid = lib::sv_to<uint64_t>(next());
+            else if (key == "--wid")
+                result.wid = lib::sv_to<uint64_t>(next());
+            else if (key == "--rotation")
+                result.rotation = lib::sv_to<uint64_t>(next());
+            else if (key == "--sets") {
+                result.sets.clear();
+                for (auto id : lib::split_as_view(next(), ','))
+                    result.sets.emplace_back(lib::sv_to<uint64_t>(id));
+            } else
+                throw FMT_RUNTIME_ERROR("unknown argument \"{}\"", key);
+        }
+
+        if (result.sets.empty())
+            throw RUNTIME_ERROR("--sets can't be empty");
+
+        return result;
+    }
+}
+
+namespace tools::load_details {
+    // seeds
+
+    utl::Json make_disc(std::mt19937_64& rng, const utl::Json& shape, size_t slot, uint64_t set_id) {
+        auto pick = [&rng](size_t size) {
+            return std::uniform_int_distribution<size_t>(0, size - 1)(rng);
+        };
+
+        utl::Json result = shape;
+        const auto& mains = main_stats_by_slot[slot];
+        auto main_stat = mains[pick(mains.size())];
+
+        std::vector<std::string_view> candidates;
+        for (auto it : sub_stats) {
+            if (it != main_stat)
+                candidates.emplace_back(it);
+        }
+        std::shuffle(candidates.begin(), candidates.end(), rng);
+
+        // level is amount of upgrades, DdpBuilder::add_sub_stat counts first roll as level 0
+        std::array<size_t, 4> sub_levels = { 0, 0, 0, 0 };
+        size_t upgrades = min_upgrades + pick(max_upgrades - min_upgrades + 1);
+        for (size_t i = 0; i < upgrades; i++)
+            sub_levels[pick(sub_levels.size())]++;
+
+        utl::json::Array stats, levels;
+        stats.emplace_back(main_stat);
+        levels.emplace_back((int64_t) main_stat_level);
+        for (size_t i = 0; i < sub_levels.size(); i++) {
+            stats.emplace_back(candidates[i]);
+            levels.emplace_back((int64_t) sub_levels[i]);
+        }
+
+        result["id"] = set_id;
+        // template writes rarity as letter, backend expects number
+        result["rarity"] = (int64_t) 4;
+        result["stats"] = std::move(stats);
+        result["levels"] = std::move(levels);
+
+        return result;
+    }
+
+    // takes template as shape of request and fills it with randomized but valid values
+    std::string make_damage_body(std::mt19937_64& rng, const config_t& config, const utl::Json& tmpl) {
+        utl::Json result = tmpl;
+        const auto& disc_shape = tmpl.at("discs").as_array().front();
+
+        // 4-piece of first set, 2-piece of second one (if any), slots are shuffled
+        std::array<uint64_t, 6> sets = {};
+        for (size_t i = 0; i < sets.size(); i++)
+            sets[i] = i < 4 || config.sets.size() == 1 ? config.sets[0] : config.sets[1];
+        std::shuffle(sets.begin(), sets.end(), rng);
+
+        utl::json::Array discs;
+        for (size_t i = 0; i < sets.size(); i++)
+            discs.emplace_back(make_disc(rng, disc_shape, i, sets[i]));
+
+        result["aid"] = config.aid;
+        result["wid"] = config.wid;
+        result["discs"] = std::move(discs);
+        result["rotation"] = config.rotation;
+
+        return result.to_string(utl::json::Format::MINIMIZED);
+    }
+
+    std::string make_rotation_body(const config_t& config, const utl::Json& tmpl) {
+        utl::Json result = tmpl;
+
+        auto path = lib::format("{}/data/rotations/{}/{}.json", config.res, config.aid, config.rotation);
+        auto source = utl::json::from_file(path);
+
+        result["name"] = "load_generator";
+        result["agent"] = config.aid;
+        result["rotation"] = source.at("rotations").at("final").at("vals");
+
+        return result.to_string(utl::json::Format::MINIMIZED);
+    }
+}
+
+namespace tools::load_details {
+    // statistics
+
+    void report(const config_t& config, std::vector<worker_result_t>& results, double seconds) {
+        std::array<std::vector<double>, RouteCount> by_route;
+        std::array<size_t, RouteCount> errors_by_route = {};
+        std::vector<double> total;
+        size_t total_errors = 0, transport_errors = 0;
+
+        for (auto& result : results) {
+            transport_errors += result.transport_errors;
+
+            for (const auto& [route, is_error, ms] : result.samples) {
+                by_route[route].emplace_back(ms);
+                total.emplace_back(ms);
+
+                if (is_error) {
+                    errors_by_route[route]++;
+                    total_errors++;
+                }
+            }
+        }
+
+        std::cout << lib::format("\n{}:{}, concurrency {}, keep-alive {}, measured {:.2f} s\n\n",
+            config.host, config.port, config.concurrency, config.keep_alive ? "on" : "off", seconds);
+        print_latency_header();
+
+        for (size_t i = 0; i < RouteCount; i++) {
+            if (config.mix[i] != 0)
+                print_latency_line(route_labels[i], by_route[i], errors_by_route[i], seconds);
+        }
+        print_latency_line("total", total, total_errors, seconds);
+
+        if (transport_errors != 0)
+            std::cout << lib::format("\ntransport errors: {}\n", transport_errors);
+    }
+}
+
+namespace tools::load_details {
+    // workers
+
+    struct shared_state_t {
+        const config_t& config;
+        const std::vector<std::string>& damage_bodies;
+        const std::string& rotation_body;
+
+        std::atomic_size_t issued = 0;
+        std::atomic_bool is_stopped = false;
+        clock::time_point measure_from;
+    };
+
+    void worker_logic(shared_state_t& state, size_t index, worker_result_t& result) {
+        const auto& config = state.config;
+        std::mt19937_64 rng(config.seed + index * 0x9e3779b97f4a7c15ull);
+        std::discrete_distribution<size_t> route_picker(config.mix.begin(), config.mix.end());
+        std::uniform_int_distribution<size_t> body_picker(0, state.damage_bodies.size() - 1);
+
+        HttpClient client(config.host, config.port, config.keep_alive);
+        auto rotation_target = lib::format("/rotation?aid={}&id=load_generator", config.aid);
+
+        while (!state.is_stopped) {
+            if (config.requests != 0 && state.issued.fetch_add(1) >= config.requests)
+                break;
+
+            auto route = (Route) route_picker(rng);
+            auto start = clock::now();
+            http_response_t response;
+
+            try {
+                switch (route) {
+                case Damage:
+                    response = client.request("POST", "/damage", state.damage_bodies[body_picker(rng)]);
+                    break;
+                case DamageDetailed:
+                    response = client.request("POST", "/damage?type=detailed", state.damage_bodies[body_picker(rng)]);
+                    break;
+                case Rotation:
+                    response = client.request("PUT", rotation_target, state.rotation_body);
+                    break;
+                case Refresh:
+                    response = client.request("POST", "/refresh");
+                    break;
+                default:
+                    break;
+                }
+            } catch (const std::exception&) {
+                result.transport_errors++;
+                continue;
+            }
+
+            auto end = clock::now();
+            // requests started during warmup are not counted
+            if (start < state.measure_from)
+                continue;
+
+            result.samples.emplace_back(
+                route,
+                response.code < 200 || response.code >= 300,
+                std::chrono::duration<double, std::milli>(end - start).count());
+        }
+    }
+}
+
+int main(int argc, char** argv) try {
+    using namespace tools::load_details;
+
+    auto config = parse_args(argc, argv);
+
+    auto damage_template = utl::json::from_file(lib::format("{}/tests/templates/get_dmg_request.json", config.res));
+    auto rotation_template = utl::json::from_file(lib::format("{}/tests/templates/post_rotation_request.json", config.res));
+
+    // bodies are generated beforehand, so generator cost doesn't pollute latency
+    std::mt19937_64 rng(config.seed);
+    std::vector<std::string> damage_bodies;
+    damage_bodies.reserve(config.pool);
+    for (size_t i = 0; i < config.pool; i++)
+        damage_bodies.emplace_back(make_damage_body(rng, config, damage_template));
+
+    std::string rotation_body = config.mix[Rotation] != 0
+        ? make_rotation_body(config, rotation_template)
+        : "";
+
+    shared_state_t state = {
+        .config = config,
+        .damage_bodies = damage_bodies,
+        .rotation_body = rotation_body
+    };
+    std::vector<worker_result_t> results(config.concurrency);
+    std::vector<std::thread> workers;
+
+    auto started = clock::now();
+    state.measure_from = config.requests != 0
+        ? started
+        : started + std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(config.warmup));
+
+    for (size_t i = 0; i < config.concurrency; i++)
+        workers.emplace_back(worker_logic, std::ref(state), i, std::ref(results[i]));
+
+    if (config.requests == 0) {
+        std::this_thread::sleep_until(state.measure_from
+            + std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(config.duration)));
+        state.is_stopped = true;
+    }
+
+    for (auto& it : workers)
+        it.join();
+
+    auto measured = std::chrono::duration<double>(clock::now() - state.measure_from).count();
+    report(config, results, measured);
+
+    return 0;
+} catch (const std::exception& e) {
+    std::cerr << e.what() << '\n';
+    return 1;
+}
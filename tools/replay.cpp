@@ -0,0 +1,465 @@
+// replays traffic captured by backend (3ZCalculator [path] --capture file.jsonl)
+// either against running server or directly against backend without network,
+// then compares responses with recorded ones
+//
+// usage: replay <capture.jsonl> [--target http|engine] [--host 127.0.0.1] [--port 5102] [--res ./res]
+//               [--pacing original|fast] [--speed 1.0] [--concurrency 1]
+//               [--tolerance 0] [--max-diffs 10] [--dump responses.jsonl]
+// capture file may go before or after options
+
+//std
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+//utl
+#include "utl/json.hpp"
+
+//library
+#include "library/cbor.hpp"
+#include "library/format.hpp"
+#include "library/string_funcs.hpp"
+
+//backend
+#include "backend/backend.hpp"
+
+//tools
+#include "common/http_client.hpp"
+#include "common/stats.hpp"
+
+namespace global {
+    std::string PATH;
+}
+
+namespace tools::replay_details {
+    using clock = std::chrono::steady_clock;
+
+    struct config_t {
+        std::string capture;
+        bool use_engine = false;
+        std::string host = "127.0.0.1";
+        uint16_t port = 5102;
+        std::string res = "./res";
+        bool is_paced = true;
+        double speed = 1.0;
+        size_t concurrency = 1;
+        double tolerance = 0.0;
+        size_t max_diffs = 10;
+        std::string dump;
+    };
+
+    struct record_t {
+        std::string request_id;
+        std::string method, path, query, body;
+        // Content-Type, Accept and X-Deadline-Ms when they were sent
+        http_headers_t headers;
+        int64_t timestamp;
+        int code;
+        std::string response;
+        bool is_binary_request = false;
+        bool is_binary_response = false;
+    };
+
+    struct outcome_t {
+        http_response_t response;
+        double ms = 0.0;
+        bool is_failed = false;
+        std::string diff;
+    };
+
+    config_t parse_args(int argc, char** argv) {
+        config_t result;
+
+        for (int i = 1; i < argc; i++) {
+            std::string_view key = argv[i];
+            auto next = [&] {
+                if (i + 1 >= argc)
+                    throw FMT_RUNTIME_ERROR("{} requires value", key);
+                return std::string_view(argv[++i]);
+            };
+
+            // capture file may go anywhere among options
+            if (!key.starts_with("--")) {
+                if (!result.capture.empty())
+                    throw FMT_RUNTIME_ERROR("unexpected argument \"{}\", capture file is already \"{}\"", key, result.capture);
+                result.capture = key;
+            } else if (key == "--target") {
+                auto target = next();
+                if (target != "http" && target != "engine")
+                    throw FMT_RUNTIME_ERROR("target has to be http or engine, got \"{}\"", target);
+                result.use_engine = target == "engine";
+            }
+            else if (key == "--host")
+                result.host = next();
+            else if (key == "--port")
+                result.port = lib::sv_to<uint16_t>(next());
+            else if (key == "--res")
+                result.res = next();
+            else if (key == "--pacing") {
+                auto pacing = next();
+                if (pacing != "original" && pacing != "fast")
+                    throw FMT_RUNTIME_ERROR("pacing has to be original or fast, got \"{}\"", pacing);
+                result.is_paced = pacing == "original";
+            }
+            else if (key == "--speed")
+                result.speed = std::max(std::stod(std::string(next())), 1e-6);
+            else if (key == "--concurrency")
+                result.concurrency = std::max<size_t>(lib::sv_to<size_t>(next()), 1);
+            else if (key == "--tolerance")
+                result.tolerance = std::stod(std::string(next()));
+            else if (key == "--max-diffs")
+                result.max_diffs = lib::sv_to<size_t>(next());
+            else if (key == "--dump")
+                result.dump = next();
+            else
+                throw FMT_RUNTIME_ERROR("unknown argument \"{}\"", key);
+        }
+
+        if (result.capture.empty())
+            throw RUNTIME_ERROR("capture file isn't specified");
+
+        return result;
+    }
+
+    // binary bodies are base64 encoded "body_base64", json ones are "body"
+    std::string read_body(const utl::Json& node) {
+        const auto& table = node.as_object();
+        if (auto it = table.find("body_base64"); it != table.end())
+            return lib::from_base64(it->second.as_string());
+
+        return table.at("body").as_string();
+    }
+    void write_body(utl::Json& node, const std::string& body, bool is_binary) {
+        if (is_binary)
+            node["body_base64"] = lib::to_base64(body);
+        else
+            node["body"] = body;
+    }
+    bool is_binary(std::string_view content_type) {
+        return content_type.starts_with(lib::cbor_mime);
+    }
+
+    std::vector<record_t> load_records(const std::string& filename) {
+        std::ifstream file(filename);
+        if (!file.is_open())
+            throw FMT_RUNTIME_ERROR("can't open \"{}\"", filename);
+
+        std::vector<record_t> result;
+        std::string line;
+
+        while (std::getline(file, line)) {
+            if (line.empty())
+                continue;
+
+            auto json = utl::json::from_string(line);
+            auto route = lib::split_as_view(json.at("route").as_string(), ' ');
+            const auto& response = json.at("response");
+
+            auto& record = result.emplace_back(record_t {
+                .request_id = json.at("request_id").as_string(),
+                .method = std::string(route[0]),
+                .path = std::string(route[1]),
+                .query = json.at("query").as_string(),
+                .body = read_body(json),
+                .timestamp = json.at("timestamp").as_integral(),
+                .code = (int) response.at("code").as_integral(),
+                .response = read_body(response),
+                .is_binary_request = json.as_object().contains("body_base64"),
+                .is_binary_response = response.as_object().contains("body_base64")
+            });
+
+            // captures of older servers have no headers
+            if (auto it = json.as_object().find("headers"); it != json.as_object().end()) {
+                for (const auto& [name, value] : it->second.as_object())
+                    record.headers.emplace_back(name, value.as_string());
+            }
+        }
+
+        // lines are written on completion, replay has to follow arrival order
+        std::ranges::stable_sort(result, {}, &record_t::timestamp);
+
+        return result;
+    }
+}
+
+namespace tools::replay_details {
+    // diff
+
+    bool numbers_equal(double lhs, double rhs, double tolerance) {
+        if (lhs == rhs)
+            return true;
+        return std::fabs(lhs - rhs) <= tolerance * std::max(std::fabs(lhs), std::fabs(rhs));
+    }
+
+    // returns path of first difference or empty string
+    std::string compare_json(const utl::Json& lhs, const utl::Json& rhs, double tolerance, const std::string& path) {
+        if (lhs.is_number() && rhs.is_number()) {
+            return numbers_equal(lhs.as_number(), rhs.as_number(), tolerance)
+                ? ""
+                : lib::format("{}: {} != {}", path, lhs.as_number(), rhs.as_number());
+        }
+
+        if (lhs.type() != rhs.type())
+            return lib::format("{}: type mismatch", path);
+
+        if (lhs.is_array()) {
+            const auto& l = lhs.as_array();
+            const auto& r = rhs.as_array();
+            if (l.size() != r.size())
+                return lib::format("{}: size {} != {}", path, l.size(), r.size());
+
+            for (size_t i = 0; i < l.size(); i++) {
+                if (auto diff = compare_json(l[i], r[i], tolerance, lib::format("{}[{}]", path, i)); !diff.empty())
+                    return diff;
+            }
+            return "";
+        }
+
+        if (lhs.is_object()) {
+            const auto& l = lhs.as_object();
+            const auto& r = rhs.as_object();
+            if (l.size() != r.size())
+                return lib::format("{}: keys count {} != {}", path, l.size(), r.size());
+
+            for (const auto& [k, v] : l) {
+                auto it = r.find(k);
+                if (it == r.end())
+                    return lib::format("{}.{}: missing", path, k);
+                if (auto diff = compare_json(v, it->second, tolerance, lib::format("{}.{}", path, k)); !diff.empty())
+                    return diff;
+            }
+            return "";
+        }
+
+        return lhs.to_string(utl::json::Format::MINIMIZED) == rhs.to_string(utl::json::Format::MINIMIZED)
+            ? ""
+            : lib::format("{}: value mismatch", path);
+    }
+
+    std::string compare(const record_t& record, const http_response_t& response, double tolerance) {
+        if (record.code != response.code)
+            return lib::format("code {} != {}", record.code, response.code);
+        if (record.response == response.body)
+            return "";
+
+        // cbor is compared as json, so tolerance applies to it too
+        auto parse = [](const std::string& body, bool is_binary) {
+            return is_binary ? lib::cbor_to_json(body) : utl::json::from_string(body);
+        };
+
+        try {
+            return compare_json(
+                parse(record.response, record.is_binary_response),
+                parse(response.body, is_binary(response.content_type)),
+                tolerance,
+                "$");
+        } catch (const std::exception&) {
+            return "body mismatch";
+        }
+    }
+}
+
+namespace tools::replay_details {
+    // targets
+
+    class ITarget {
+    public:
+        virtual ~ITarget() = default;
+        virtual http_response_t send(const record_t& record) = 0;
+    };
+
+    class HttpTarget : public ITarget {
+    public:
+        explicit HttpTarget(const config_t& config) :
+            m_client(config.host, config.port) {
+        }
+
+        http_response_t send(const record_t& record) override {
+            auto target = record.query.empty()
+                ? record.path
+                : lib::format("{}?{}", record.path, record.query);
+
+            std::string_view content_type = "application/json";
+            http_headers_t headers;
+            for (const auto& [name, value] : record.headers) {
+                if (name == "Content-Type")
+                    content_type = value;
+                else
+                    headers.emplace_back(name, value);
+            }
+
+            return m_client.request(record.method, target, record.body, content_type, headers);
+        }
+
+    protected:
+        HttpClient m_client;
+    };
+
+    class EngineTarget : public ITarget {
+    public:
+        explicit EngineTarget(backend::Backend& server) :
+            m_server(server) {
+        }
+
+        http_response_t send(const record_t& record) override {
+            crow::request req;
+
+            req.method = crow::method_from_string(record.method.c_str());
+            req.url = record.path;
+            req.raw_url = record.query.empty()
+                ? record.path
+                : lib::format("{}?{}", record.path, record.query);
+            req.url_params = crow::query_string(req.raw_url);
+            req.body = record.body;
+            for (const auto& [name, value] : record.headers)
+                req.add_header(name, value);
+
+            auto res = m_server.handle(req);
+            return {
+                .code = res.code,
+                .body = std::move(res.body),
+                .content_type = res.get_header_value("Content-Type")
+            };
+        }
+
+    protected:
+        backend::Backend& m_server;
+    };
+}
+
+int main(int argc, char** argv) try {
+    using namespace tools::replay_details;
+
+    auto config = parse_args(argc, argv);
+    auto records = load_records(config.capture);
+    global::PATH = config.res;
+
+    if (records.empty())
+        throw RUNTIME_ERROR("capture is empty");
+
+    std::unique_ptr<backend::Backend> server;
+    if (config.use_engine) {
+        server = std::make_unique<backend::Backend>();
+        server->init();
+        server->manager().launch();
+    }
+
+    std::vector<outcome_t> outcomes(records.size());
+    std::atomic_size_t next = 0;
+
+    auto started = clock::now();
+    auto worker = [&] {
+        std::unique_ptr<ITarget> target;
+        if (config.use_engine)
+            target = std::make_unique<EngineTarget>(*server);
+        else
+            target = std::make_unique<HttpTarget>(config);
+
+        for (size_t i = next++; i < records.size(); i = next++) {
+            const auto& record = records[i];
+            auto& outcome = outcomes[i];
+
+            if (config.is_paced) {
+                auto offset = std::chrono::microseconds(record.timestamp - records.front().timestamp);
+                std::this_thread::sleep_until(started
+                    + std::chrono::duration_cast<clock::duration>(offset / config.speed));
+            }
+
+            auto start = clock::now();
+            try {
+                outcome.response = target->send(record);
+            } catch (const std::exception& e) {
+                outcome.is_failed = true;
+                outcome.diff = e.what();
+                continue;
+            }
+            outcome.ms = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+            outcome.diff = compare(record, outcome.response, config.tolerance);
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < config.concurrency; i++)
+        workers.emplace_back(worker);
+    for (auto& it : workers)
+        it.join();
+
+    auto seconds = std::chrono::duration<double>(clock::now() - started).count();
+
+    // report
+
+    std::map<std::string, std::pair<std::vector<double>, size_t>> by_route;
+    std::vector<double> total;
+    size_t mismatches = 0, failures = 0, printed = 0;
+
+    for (size_t i = 0; i < records.size(); i++) {
+        const auto& record = records[i];
+        const auto& outcome = outcomes[i];
+        auto& [latencies, errors] = by_route[record.method + ' ' + record.path];
+
+        if (outcome.is_failed) {
+            failures++;
+            errors++;
+        } else {
+            latencies.emplace_back(outcome.ms);
+            total.emplace_back(outcome.ms);
+        }
+
+        if (outcome.diff.empty())
+            continue;
+
+        if (!outcome.is_failed) {
+            mismatches++;
+            errors++;
+        }
+        if (printed++ < config.max_diffs)
+            std::cout << lib::format("{} {} {}: {}\n", record.request_id, record.method, record.path, outcome.diff);
+    }
+
+    std::cout << lib::format("\nreplayed {} requests against {} ({} pacing) in {:.2f} s\n\n",
+        records.size(),
+        config.use_engine ? "engine" : lib::format("{}:{}", config.host, config.port),
+        config.is_paced ? "original" : "fast",
+        seconds);
+
+    tools::print_latency_header();
+    for (auto& [route, value] : by_route)
+        tools::print_latency_line(route, value.first, value.second, seconds);
+    tools::print_latency_line("total", total, mismatches + failures, seconds);
+
+    std::cout << lib::format("\nmismatched responses: {}, failed requests: {}\n", mismatches, failures);
+
+    if (!config.dump.empty()) {
+        std::ofstream file(config.dump, std::ios::out | std::ios::trunc);
+
+        for (size_t i = 0; i < records.size(); i++) {
+            utl::Json line;
+            line["request_id"] = records[i].request_id;
+            line["route"] = records[i].method + ' ' + records[i].path;
+            line["query"] = records[i].query;
+            for (const auto& [name, value] : records[i].headers)
+                line["headers"][name] = value;
+            write_body(line, records[i].body, records[i].is_binary_request);
+            line["timestamp"] = records[i].timestamp;
+            line["response"]["code"] = (int64_t) outcomes[i].response.code;
+            write_body(line["response"], outcomes[i].response.body, is_binary(outcomes[i].response.content_type));
+            file << line.to_string(utl::json::Format::MINIMIZED) << '\n';
+        }
+    }
+
+    return mismatches + failures == 0 ? 0 : 2;
+} catch (const std::exception& e) {
+    std::cerr << e.what() << '\n';
+    return 1;
+}